@@ -0,0 +1,561 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ftw.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "embedder_options.h"
+#include "event_loop.h"
+#include "flutter_application.h"
+#include "headless_display.h"
+#include "time_base.h"
+#include "utils.h"
+#include "wayland_connection.h"
+#include "wayland_display.h"
+
+#ifndef FLUTTER_ENGINE_SHA
+#define FLUTTER_ENGINE_SHA "unknown"
+#endif
+
+namespace flutter {
+
+static const size_t kWidth = 800;
+static const size_t kHeight = 600;
+
+// How often the loop checks whether a first frame run is done.
+static const uint64_t kPollIntervalNanos = kNanosPerMilli;
+
+// Synthetic scrolling: a drag from the bottom of the window towards the top,
+// moving a fixed distance per input sample, then a short pause with the
+// pointer up to let the fling settle a little.
+static const uint64_t kInputIntervalNanos = 8 * kNanosPerMilli;
+static const int kDragSamples = 40;
+static const int kDragStep = 10;
+static const int kPauseSamples = 10;
+
+struct BenchOptions {
+  bool wayland = false;
+  size_t warm_runs = 3;
+  uint32_t scroll_seconds = 10;
+  std::string output_path;
+};
+
+// What a single engine run observed, all in the time base of |time_base.h|.
+struct RunResult {
+  uint64_t start_nanos = 0;
+  uint64_t first_frame_nanos = 0;
+  // When the first synthetic input was injected. Zero if there was none.
+  uint64_t scroll_start_nanos = 0;
+  std::vector<uint64_t> present_ends;
+  std::vector<uint64_t> input_latencies;
+};
+
+// Forwards to the display and timestamps presents and injected input. An
+// input is reflected by the end of the first present after it, the same rule
+// the frame stats reporter uses.
+class RecordingDelegate : public FlutterApplication::RenderDelegate {
+ public:
+  explicit RecordingDelegate(FlutterApplication::RenderDelegate& delegate)
+      : delegate_(delegate) {}
+
+  void OnInputInjected() {
+    const uint64_t now = GetCurrentTimeNanos();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_input_ == 0) {
+      pending_input_ = now;
+    }
+    if (result_.scroll_start_nanos == 0) {
+      result_.scroll_start_nanos = now;
+    }
+  }
+
+  size_t GetPresentCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return result_.present_ends.size();
+  }
+
+  RunResult TakeResult() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::move(result_);
+  }
+
+ private:
+  FlutterApplication::RenderDelegate& delegate_;
+  std::mutex mutex_;
+  RunResult result_;
+  uint64_t pending_input_ = 0;
+
+  void RecordPresent() {
+    const uint64_t now = GetCurrentTimeNanos();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    result_.present_ends.push_back(now);
+    if (pending_input_ != 0) {
+      result_.input_latencies.push_back(now - pending_input_);
+      pending_input_ = 0;
+    }
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationContextMakeCurrent() override {
+    return delegate_.OnApplicationContextMakeCurrent();
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationContextClearCurrent() override {
+    return delegate_.OnApplicationContextClearCurrent();
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationResourceContextMakeCurrent() override {
+    return delegate_.OnApplicationResourceContextMakeCurrent();
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresent(const FlutterRect* damage,
+                            size_t damage_count) override {
+    const bool presented =
+        delegate_.OnApplicationPresent(damage, damage_count);
+    RecordPresent();
+    return presented;
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationPopulateExistingDamage(
+      FlutterDamage* existing_damage) override {
+    delegate_.OnApplicationPopulateExistingDamage(existing_damage);
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  uint32_t OnApplicationGetOnscreenFBO(size_t frame_width,
+                                       size_t frame_height) override {
+    return delegate_.OnApplicationGetOnscreenFBO(frame_width, frame_height);
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationRequestVsync(VsyncCallback callback) override {
+    delegate_.OnApplicationRequestVsync(std::move(callback));
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationRotatesFBOs() const override {
+    return delegate_.OnApplicationRotatesFBOs();
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationComposesLayers() const override {
+    return delegate_.OnApplicationComposesLayers();
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCreateBackingStore(
+      const FlutterBackingStoreConfig* config,
+      FlutterBackingStore* backing_store) override {
+    return delegate_.OnApplicationCreateBackingStore(config, backing_store);
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCollectBackingStore(
+      const FlutterBackingStore* backing_store) override {
+    return delegate_.OnApplicationCollectBackingStore(backing_store);
+  }
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresentLayers(const FlutterLayer** layers,
+                                  size_t layers_count) override {
+    const bool presented =
+        delegate_.OnApplicationPresentLayers(layers, layers_count);
+    RecordPresent();
+    return presented;
+  }
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(RecordingDelegate);
+};
+
+// Runs the engine with the same startup sequence as the embedder until the
+// first frame, or for |scroll_seconds| of synthetic scrolling if non-zero.
+template <class Display>
+static bool RunOnce(Display& display,
+                    EventLoop& event_loop,
+                    const std::string& asset_bundle_path,
+                    const std::vector<std::string>& args,
+                    uint32_t scroll_seconds,
+                    RunResult& result) {
+  RecordingDelegate recorder(display);
+  const uint64_t start = GetCurrentTimeNanos();
+
+  bool connected = false;
+  std::thread connect_thread(
+      [&display, &connected]() { connected = display.Connect(); });
+
+  FlutterApplication application(asset_bundle_path, args, recorder,
+                                 event_loop);
+
+  connect_thread.join();
+
+  if (!connected || !display.AttachToEventLoop()) {
+    FLWAY_ERROR << "Display was not valid." << std::endl;
+    return false;
+  }
+
+  if (!application.IsValid() || !application.Run()) {
+    FLWAY_ERROR << "Flutter application was not valid." << std::endl;
+    return false;
+  }
+
+  if (!display.SetApplication(&application)) {
+    FLWAY_ERROR << "Could not update Flutter application size." << std::endl;
+    return false;
+  }
+
+  Timer poll_timer(event_loop, [&]() {
+    if (recorder.GetPresentCount() > 0) {
+      event_loop.Terminate();
+    }
+  });
+
+  int input_sample = 0;
+  int pointer_y = 0;
+  Timer input_timer(event_loop, [&]() {
+    // Wait for the app to show up before scrolling it.
+    if (recorder.GetPresentCount() == 0) {
+      return;
+    }
+
+    const int phase = input_sample++ % (kDragSamples + kPauseSamples);
+    const int x = kWidth / 2;
+
+    if (phase == 0) {
+      pointer_y = kHeight - kDragStep;
+    } else if (phase < kDragSamples) {
+      pointer_y -= kDragStep;
+    } else if (phase > kDragSamples) {
+      return;
+    }
+
+    const int button = phase == kDragSamples ? 0 : 1;
+    recorder.OnInputInjected();
+    application.SendPointerEvent(button, x, std::max(pointer_y, 0));
+  });
+
+  Timer deadline_timer(event_loop, [&]() { event_loop.Terminate(); });
+
+  if (!poll_timer.IsValid() || !input_timer.IsValid() ||
+      !deadline_timer.IsValid()) {
+    FLWAY_ERROR << "Could not create the benchmark timers." << std::endl;
+    return false;
+  }
+
+  if (scroll_seconds == 0) {
+    poll_timer.ArmRepeating(kPollIntervalNanos);
+  } else {
+    input_timer.ArmRepeating(kInputIntervalNanos);
+    deadline_timer.ArmAt(GetCurrentTimeNanos() +
+                         scroll_seconds * kNanosPerSecond);
+  }
+
+  if (!event_loop.Run()) {
+    return false;
+  }
+
+  result = recorder.TakeResult();
+  result.start_nanos = start;
+  if (result.present_ends.empty()) {
+    FLWAY_ERROR << "The application did not present a frame." << std::endl;
+    return false;
+  }
+  result.first_frame_nanos = result.present_ends.front();
+  return true;
+}
+
+static bool RunScenario(const std::string& asset_bundle_path,
+                        const std::vector<std::string>& args,
+                        const EmbedderOptions& options,
+                        const BenchOptions& bench_options,
+                        uint32_t scroll_seconds,
+                        RunResult& result) {
+  EventLoop event_loop;
+
+  if (!event_loop.IsValid()) {
+    FLWAY_ERROR << "Event loop was not valid." << std::endl;
+    return false;
+  }
+
+  if (bench_options.wayland) {
+    WaylandConnection connection(event_loop, options);
+    WaylandDisplay display(connection, kWidth, kHeight, options);
+    return RunOnce(display, event_loop, asset_bundle_path, args,
+                   scroll_seconds, result);
+  }
+
+  HeadlessDisplay display(event_loop, kWidth, kHeight, options);
+  return RunOnce(display, event_loop, asset_bundle_path, args, scroll_seconds,
+                 result);
+}
+
+static int EvictTreeEntry(const char* path,
+                          const struct stat* stat_buffer,
+                          int type,
+                          struct FTW* ftw) {
+  if (type == FTW_F) {
+    EvictFile(path);
+  }
+  return 0;
+}
+
+// Everything the engine reads at startup that is not already mapped by this
+// process. The engine library itself stays resident.
+static void EvictStartupFiles(const std::string& asset_bundle_path) {
+  ::nftw(asset_bundle_path.c_str(), EvictTreeEntry, 16, FTW_PHYS);
+  EvictFile(GetExecutableDirectory() + "icudtl.dat");
+}
+
+static double NanosToMillis(uint64_t nanos) {
+  return nanos / static_cast<double>(kNanosPerMilli);
+}
+
+static uint64_t GetPercentile(std::vector<uint64_t> samples,
+                              double percentile) {
+  if (samples.empty()) {
+    return 0;
+  }
+
+  const size_t index = std::min(
+      samples.size() - 1, static_cast<size_t>(percentile * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+  return samples[index];
+}
+
+static void WriteDistribution(std::ostream& out,
+                              const std::vector<uint64_t>& samples) {
+  out << "{\"count\":" << samples.size()
+      << ",\"p50\":" << NanosToMillis(GetPercentile(samples, 0.5))
+      << ",\"p90\":" << NanosToMillis(GetPercentile(samples, 0.9))
+      << ",\"p99\":" << NanosToMillis(GetPercentile(samples, 0.99))
+      << ",\"max\":" << NanosToMillis(GetPercentile(samples, 1.0)) << "}";
+}
+
+static void WriteResults(std::ostream& out,
+                         const EmbedderOptions& options,
+                         const BenchOptions& bench_options,
+                         const RunResult& cold,
+                         const std::vector<RunResult>& warm,
+                         const RunResult& scroll) {
+  std::vector<uint64_t> warm_first_frames;
+  for (const auto& run : warm) {
+    warm_first_frames.push_back(run.first_frame_nanos - run.start_nanos);
+  }
+
+  // Frame times only count while the app is scrolled. Presents before the
+  // first input are startup and the idle wait for it.
+  const auto first_scroll_present =
+      std::lower_bound(scroll.present_ends.begin(), scroll.present_ends.end(),
+                       scroll.scroll_start_nanos);
+  std::vector<uint64_t> scroll_present_ends(first_scroll_present,
+                                            scroll.present_ends.end());
+
+  std::vector<uint64_t> frame_times;
+  for (size_t i = 1; i < scroll_present_ends.size(); i++) {
+    frame_times.push_back(scroll_present_ends[i] - scroll_present_ends[i - 1]);
+  }
+
+  const uint64_t scroll_nanos =
+      scroll_present_ends.empty()
+          ? 0
+          : scroll_present_ends.back() - scroll_present_ends.front();
+  const double fps = scroll_nanos == 0 ? 0.0
+                                       : frame_times.size() * kNanosPerSecond /
+                                             static_cast<double>(scroll_nanos);
+
+  out << "{\"engine_sha\":\"" << FLUTTER_ENGINE_SHA << "\""
+      << ",\"display\":\"" << (bench_options.wayland ? "wayland" : "headless")
+      << "\",\"width\":" << kWidth << ",\"height\":" << kHeight
+      << ",\"headless_refresh_rate\":" << options.headless_refresh_rate
+      << ",\"time_to_first_frame_ms\":{\"cold\":"
+      << NanosToMillis(cold.first_frame_nanos - cold.start_nanos)
+      << ",\"warm\":";
+  WriteDistribution(out, warm_first_frames);
+  out << "},\"scroll\":{\"seconds\":" << bench_options.scroll_seconds
+      << ",\"frames\":" << scroll_present_ends.size() << ",\"fps\":" << fps
+      << ",\"frame_time_ms\":";
+  WriteDistribution(out, frame_times);
+  out << ",\"input_to_present_ms\":";
+  WriteDistribution(out, scroll.input_latencies);
+  out << "}}" << std::endl;
+}
+
+static bool ParseSwitch(const std::string& arg,
+                        const char* name,
+                        std::string& value) {
+  const std::string prefix = std::string("--") + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+static bool ParseCount(const std::string& value, unsigned long& count) {
+  char* end = nullptr;
+  count = ::strtoul(value.c_str(), &end, 10);
+  return !value.empty() && *end == '\0' && count <= UINT32_MAX;
+}
+
+static bool ParseBenchOptions(std::vector<std::string>& args,
+                              BenchOptions& options) {
+  std::vector<std::string> remaining;
+  bool valid = true;
+
+  for (const auto& arg : args) {
+    std::string value;
+    unsigned long count = 0;
+
+    if (arg == "--wayland") {
+      options.wayland = true;
+      continue;
+    }
+
+    if (ParseSwitch(arg, "warm-runs", value)) {
+      if (!ParseCount(value, count)) {
+        FLWAY_ERROR << "Invalid warm run count: " << value << std::endl;
+        valid = false;
+      } else {
+        options.warm_runs = count;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "scroll-seconds", value)) {
+      if (!ParseCount(value, count) || count == 0) {
+        FLWAY_ERROR << "Invalid scroll duration: " << value << std::endl;
+        valid = false;
+      } else {
+        options.scroll_seconds = count;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "output", value)) {
+      options.output_path = value;
+      continue;
+    }
+
+    remaining.push_back(arg);
+  }
+
+  args = std::move(remaining);
+  return valid;
+}
+
+static void PrintUsage() {
+  std::cerr << "Usage: `" << GetExecutableName()
+            << " <asset_bundle_path> <bench_flags> <embedder_flags> "
+               "<flutter_flags>`"
+            << std::endl;
+  std::cerr << R"~(
+Measures the embedder and writes the results as a single JSON object:
+- time to first frame after the bundle and ICU data were evicted from the page
+  cache (cold) and with them resident (warm).
+- frame rate and frame time distribution while the app is scrolled with
+  synthetic pointer drags. Use a bundle with a long scrollable list.
+- latency from each injected pointer event to the end of the next present.
+
+Runs headless by default, paced by the virtual vsync of --headless-refresh-rate.
+Pass --headless-refresh-rate=0 to measure raw throughput.
+
+      bench_flags: --wayland
+                       Present through the compositor named by
+                       WAYLAND_DISPLAY instead, for example a nested Weston.
+
+                   --warm-runs=<n>
+                       Number of warm starts to measure. Defaults to 3.
+
+                   --scroll-seconds=<seconds>
+                       Duration of the scrolling run. Defaults to 10.
+
+                   --output=<file>
+                       Write the results to this file instead of stdout.
+
+   embedder_flags: As for flutter_wayland. Only the log level applies to
+                   headless runs.
+)~" << std::endl;
+}
+
+static bool Main(std::vector<std::string> args) {
+  EmbedderOptions options;
+  options.log_severity = LogSeverity::kError;
+  BenchOptions bench_options;
+
+  if (!ParseBenchOptions(args, bench_options) ||
+      !ParseEmbedderOptions(args, options)) {
+    PrintUsage();
+    return false;
+  }
+
+  SetMinLogSeverity(options.log_severity);
+
+  if (args.size() == 0 || !FlutterAssetBundleIsValid(args[0])) {
+    PrintUsage();
+    return false;
+  }
+
+  const auto asset_bundle_path = args[0];
+
+  RunResult cold;
+  EvictStartupFiles(asset_bundle_path);
+  if (!RunScenario(asset_bundle_path, args, options, bench_options, 0, cold)) {
+    FLWAY_ERROR << "Cold start run failed." << std::endl;
+    return false;
+  }
+
+  std::vector<RunResult> warm(bench_options.warm_runs);
+  for (auto& run : warm) {
+    if (!RunScenario(asset_bundle_path, args, options, bench_options, 0,
+                     run)) {
+      FLWAY_ERROR << "Warm start run failed." << std::endl;
+      return false;
+    }
+  }
+
+  RunResult scroll;
+  if (!RunScenario(asset_bundle_path, args, options, bench_options,
+                   bench_options.scroll_seconds, scroll)) {
+    FLWAY_ERROR << "Scrolling run failed." << std::endl;
+    return false;
+  }
+
+  if (bench_options.output_path.empty()) {
+    WriteResults(std::cout, options, bench_options, cold, warm, scroll);
+    return true;
+  }
+
+  std::ofstream output(bench_options.output_path);
+  WriteResults(output, options, bench_options, cold, warm, scroll);
+  if (!output) {
+    FLWAY_ERROR << "Could not write " << bench_options.output_path
+                << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace flutter
+
+int main(int argc, char* argv[]) {
+  std::vector<std::string> args;
+  for (int i = 1; i < argc; ++i) {
+    args.push_back(argv[i]);
+  }
+  return flutter::Main(std::move(args)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,133 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "aot_snapshot.h"
+
+#include "utils.h"
+
+namespace flutter {
+
+static const char* kAOTLibraryNames[] = {
+    "app.so",
+    "lib/libapp.so",
+};
+
+static const char* kVMSnapshotDataFileName = "vm_snapshot_data";
+static const char* kVMSnapshotInstructionsFileName = "vm_snapshot_instr";
+static const char* kIsolateSnapshotDataFileName = "isolate_snapshot_data";
+static const char* kIsolateSnapshotInstructionsFileName =
+    "isolate_snapshot_instr";
+
+static std::string GetAOTLibraryPath(const std::string& bundle_path) {
+  for (const char* name : kAOTLibraryNames) {
+    auto path = bundle_path + "/" + name;
+    if (FileExistsAtPath(path)) {
+      return path;
+    }
+  }
+  return "";
+}
+
+static bool HasAOTBlobs(const std::string& bundle_path) {
+  for (const char* name :
+       {kVMSnapshotDataFileName, kVMSnapshotInstructionsFileName,
+        kIsolateSnapshotDataFileName, kIsolateSnapshotInstructionsFileName}) {
+    if (!FileExistsAtPath(bundle_path + "/" + name)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AOTSnapshot::ExistsInBundle(const std::string& bundle_path) {
+  return GetAOTLibraryPath(bundle_path) != "" || HasAOTBlobs(bundle_path);
+}
+
+AOTSnapshot::AOTSnapshot(const std::string& bundle_path) {
+  auto library_path = GetAOTLibraryPath(bundle_path);
+
+  if (library_path != "") {
+    valid_ = LoadLibrary(library_path);
+  } else {
+    valid_ = MapBlobs(bundle_path);
+  }
+}
+
+AOTSnapshot::~AOTSnapshot() {
+  if (aot_data_ != nullptr &&
+      FlutterEngineCollectAOTData(aot_data_) != kSuccess) {
+    FLWAY_ERROR << "Could not collect the AOT data." << std::endl;
+  }
+}
+
+bool AOTSnapshot::IsValid() const {
+  return valid_;
+}
+
+bool AOTSnapshot::LoadLibrary(const std::string& library_path) {
+  PrefetchFile(library_path);
+
+  FlutterEngineAOTDataSource source = {};
+  source.type = kFlutterEngineAOTDataSourceTypeElfPath;
+  source.elf_path = library_path.c_str();
+
+  if (FlutterEngineCreateAOTData(&source, &aot_data_) != kSuccess) {
+    FLWAY_ERROR << "Could not load the AOT library " << library_path
+                << std::endl;
+    aot_data_ = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+bool AOTSnapshot::MapBlobs(const std::string& bundle_path) {
+  vm_snapshot_data_.reset(
+      new FileMapping(bundle_path + "/" + kVMSnapshotDataFileName,
+                      FileMapping::Protection::kRead));
+  vm_snapshot_instructions_.reset(
+      new FileMapping(bundle_path + "/" + kVMSnapshotInstructionsFileName,
+                      FileMapping::Protection::kReadExecute));
+  isolate_snapshot_data_.reset(
+      new FileMapping(bundle_path + "/" + kIsolateSnapshotDataFileName,
+                      FileMapping::Protection::kRead));
+  isolate_snapshot_instructions_.reset(
+      new FileMapping(bundle_path + "/" + kIsolateSnapshotInstructionsFileName,
+                      FileMapping::Protection::kReadExecute));
+
+  if (!vm_snapshot_data_->IsValid() || !vm_snapshot_instructions_->IsValid() ||
+      !isolate_snapshot_data_->IsValid() ||
+      !isolate_snapshot_instructions_->IsValid()) {
+    FLWAY_ERROR << "Could not map the AOT snapshots in " << bundle_path
+                << std::endl;
+    return false;
+  }
+
+  vm_snapshot_data_->Prefetch();
+  vm_snapshot_instructions_->Prefetch();
+  isolate_snapshot_data_->Prefetch();
+  isolate_snapshot_instructions_->Prefetch();
+
+  return true;
+}
+
+void AOTSnapshot::PopulateProjectArgs(FlutterProjectArgs& args) const {
+  if (aot_data_ != nullptr) {
+    args.aot_data = aot_data_;
+    return;
+  }
+
+  args.vm_snapshot_data = vm_snapshot_data_->GetMapping();
+  args.vm_snapshot_data_size = vm_snapshot_data_->GetSize();
+  args.vm_snapshot_instructions = vm_snapshot_instructions_->GetMapping();
+  args.vm_snapshot_instructions_size = vm_snapshot_instructions_->GetSize();
+  args.isolate_snapshot_data = isolate_snapshot_data_->GetMapping();
+  args.isolate_snapshot_data_size = isolate_snapshot_data_->GetSize();
+  args.isolate_snapshot_instructions =
+      isolate_snapshot_instructions_->GetMapping();
+  args.isolate_snapshot_instructions_size =
+      isolate_snapshot_instructions_->GetSize();
+}
+
+}  // namespace flutter
@@ -0,0 +1,53 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <memory>
+#include <string>
+
+#include "file_mapping.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Ahead of time compiled Dart code for engines built in profile or release
+// mode. A bundle carries either an ELF library with all four snapshots,
+// |app.so| (or |libapp.so| as laid out by `flutter build`), or the four
+// snapshot blobs written by `gen_snapshot --snapshot_kind=app-aot-blobs`.
+// The library is loaded by the engine's own ELF loader. The blobs are mapped
+// read-only here. Either way the snapshots are never copied onto the heap.
+class AOTSnapshot {
+ public:
+  // Whether |bundle_path| contains a complete set of AOT artifacts.
+  static bool ExistsInBundle(const std::string& bundle_path);
+
+  explicit AOTSnapshot(const std::string& bundle_path);
+
+  // Must only be destroyed after the engine using it has shut down.
+  ~AOTSnapshot();
+
+  bool IsValid() const;
+
+  // Point |args| at the snapshots. They remain owned by this object.
+  void PopulateProjectArgs(FlutterProjectArgs& args) const;
+
+ private:
+  FlutterEngineAOTData aot_data_ = nullptr;
+  std::unique_ptr<FileMapping> vm_snapshot_data_;
+  std::unique_ptr<FileMapping> vm_snapshot_instructions_;
+  std::unique_ptr<FileMapping> isolate_snapshot_data_;
+  std::unique_ptr<FileMapping> isolate_snapshot_instructions_;
+  bool valid_ = false;
+
+  bool LoadLibrary(const std::string& library_path);
+
+  bool MapBlobs(const std::string& bundle_path);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(AOTSnapshot);
+};
+
+}  // namespace flutter
@@ -0,0 +1,595 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "dmabuf_presenter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <xf86drm.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "egl_utils.h"
+#include "time_base.h"
+#include "tracing.h"
+
+namespace flutter {
+
+// Used when EGL cannot name the device it renders on.
+static const char* kDefaultRenderNode = "/dev/dri/renderD128";
+
+// A compositor that holds on to every buffer this long is stuck, or the
+// engine is shutting down while the platform thread no longer dispatches the
+// releases. Rendering into the oldest buffer then beats blocking forever.
+static const std::chrono::milliseconds kBufferReleaseTimeout(500);
+
+const wl_buffer_listener DmabufPresenter::kBufferListener = {
+    .release = [](void* data, struct wl_buffer* wl_buffer) -> void {
+      auto buffer = reinterpret_cast<Buffer*>(data);
+      buffer->presenter->OnBufferReleased(*buffer, wl_buffer);
+    },
+};
+
+DmabufPresenter::DmabufPresenter(
+    wl_display* display,
+    wl_surface* surface,
+    zwp_linux_dmabuf_v1* linux_dmabuf,
+    wp_linux_drm_syncobj_manager_v1* syncobj_manager,
+    EGLDisplay egl_display,
+    uint32_t format,
+    std::vector<uint64_t> modifiers,
+    size_t buffer_count)
+    : display_(display),
+      surface_(surface),
+      linux_dmabuf_(linux_dmabuf),
+      egl_display_(egl_display),
+      format_(format),
+      modifiers_(std::move(modifiers)),
+      buffer_count_(buffer_count),
+      image_target_renderbuffer_(
+          reinterpret_cast<PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC>(
+              eglGetProcAddress("glEGLImageTargetRenderbufferStorageOES"))) {
+  // The invalid modifier stands for implicit layouts, which is what GBM picks
+  // when it is not given any.
+  modifiers_.erase(
+      std::remove(modifiers_.begin(), modifiers_.end(), kDmabufModifierInvalid),
+      modifiers_.end());
+
+  if (!display_ || !surface_ || !linux_dmabuf_ || buffer_count_ == 0) {
+    return;
+  }
+
+  if (!HasEGLExtension(egl_display_, "EGL_EXT_image_dma_buf_import") ||
+      image_target_renderbuffer_ == nullptr) {
+    FLWAY_ERROR << "EGL cannot import dmabufs." << std::endl;
+    return;
+  }
+
+  if (!OpenRenderNode()) {
+    return;
+  }
+
+  for (size_t i = 0; i < buffer_count_; i++) {
+    std::unique_ptr<Buffer> buffer(new Buffer());
+    buffer->presenter = this;
+    buffers_.push_back(std::move(buffer));
+  }
+
+  if (syncobj_manager && !SetupExplicitSync(syncobj_manager)) {
+    TeardownExplicitSync();
+    FLWAY_LOG << "Falling back to implicit synchronization." << std::endl;
+  }
+
+  valid_ = true;
+}
+
+// The onscreen context is not current here. Its GL objects go away with it.
+DmabufPresenter::~DmabufPresenter() {
+  DestroyBuffers(false);
+  TeardownExplicitSync();
+
+  if (gbm_device_) {
+    gbm_device_destroy(gbm_device_);
+    gbm_device_ = nullptr;
+  }
+
+  if (drm_fd_ != -1) {
+    ::close(drm_fd_);
+    drm_fd_ = -1;
+  }
+}
+
+bool DmabufPresenter::IsValid() const {
+  return valid_;
+}
+
+bool DmabufPresenter::UsesExplicitSync() const {
+  return syncobj_surface_ != nullptr;
+}
+
+// Allocate on the device EGL renders with so imports never cross GPUs.
+bool DmabufPresenter::OpenRenderNode() {
+  std::string path = kDefaultRenderNode;
+
+  auto query_display_attrib = reinterpret_cast<PFNEGLQUERYDISPLAYATTRIBEXTPROC>(
+      eglGetProcAddress("eglQueryDisplayAttribEXT"));
+  auto query_device_string = reinterpret_cast<PFNEGLQUERYDEVICESTRINGEXTPROC>(
+      eglGetProcAddress("eglQueryDeviceStringEXT"));
+
+  EGLAttrib device = 0;
+  if (query_display_attrib && query_device_string &&
+      HasEGLExtension(EGL_NO_DISPLAY, "EGL_EXT_device_query") &&
+      query_display_attrib(egl_display_, EGL_DEVICE_EXT, &device) ==
+          EGL_TRUE) {
+    const char* render_node = query_device_string(
+        reinterpret_cast<EGLDeviceEXT>(device), EGL_DRM_RENDER_NODE_FILE_EXT);
+    if (render_node) {
+      path = render_node;
+    }
+  }
+
+  drm_fd_ = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+  if (drm_fd_ == -1) {
+    FLWAY_ERROR << "Could not open the render node " << path << std::endl;
+    return false;
+  }
+
+  gbm_device_ = gbm_create_device(drm_fd_);
+  if (!gbm_device_) {
+    FLWAY_ERROR << "Could not create a GBM device on " << path << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool DmabufPresenter::SetupExplicitSync(
+    wp_linux_drm_syncobj_manager_v1* syncobj_manager) {
+  if (!HasNativeFenceSync(egl_display_)) {
+    FLWAY_LOG << "EGL cannot export native fences." << std::endl;
+    return false;
+  }
+
+  uint64_t has_timelines = 0;
+  if (drmGetCap(drm_fd_, DRM_CAP_SYNCOBJ_TIMELINE, &has_timelines) != 0 ||
+      !has_timelines) {
+    FLWAY_LOG << "The render node does not support timeline syncobjs."
+              << std::endl;
+    return false;
+  }
+
+  if (!CreateTimeline(syncobj_manager, acquire_timeline_handle_,
+                      acquire_timeline_)) {
+    return false;
+  }
+
+  for (auto& buffer : buffers_) {
+    if (!CreateTimeline(syncobj_manager, buffer->release_timeline_handle,
+                        buffer->release_timeline)) {
+      return false;
+    }
+  }
+
+  syncobj_surface_ =
+      wp_linux_drm_syncobj_manager_v1_get_surface(syncobj_manager, surface_);
+
+  FLWAY_LOG << "Using explicit synchronization." << std::endl;
+  return true;
+}
+
+void DmabufPresenter::TeardownExplicitSync() {
+  if (syncobj_surface_) {
+    wp_linux_drm_syncobj_surface_v1_destroy(syncobj_surface_);
+    syncobj_surface_ = nullptr;
+  }
+
+  DestroyTimeline(acquire_timeline_handle_, acquire_timeline_);
+
+  for (auto& buffer : buffers_) {
+    DestroyTimeline(buffer->release_timeline_handle, buffer->release_timeline);
+  }
+}
+
+bool DmabufPresenter::CreateTimeline(
+    wp_linux_drm_syncobj_manager_v1* syncobj_manager,
+    uint32_t& handle,
+    wp_linux_drm_syncobj_timeline_v1*& timeline) {
+  if (drmSyncobjCreate(drm_fd_, 0, &handle) != 0) {
+    FLWAY_ERROR << "Could not create a timeline syncobj." << std::endl;
+    handle = 0;
+    return false;
+  }
+
+  int timeline_fd = -1;
+  if (drmSyncobjHandleToFD(drm_fd_, handle, &timeline_fd) != 0) {
+    FLWAY_ERROR << "Could not export the timeline syncobj." << std::endl;
+    drmSyncobjDestroy(drm_fd_, handle);
+    handle = 0;
+    return false;
+  }
+
+  timeline = wp_linux_drm_syncobj_manager_v1_import_timeline(syncobj_manager,
+                                                             timeline_fd);
+  ::close(timeline_fd);
+  return true;
+}
+
+void DmabufPresenter::DestroyTimeline(
+    uint32_t& handle,
+    wp_linux_drm_syncobj_timeline_v1*& timeline) {
+  if (timeline) {
+    wp_linux_drm_syncobj_timeline_v1_destroy(timeline);
+    timeline = nullptr;
+  }
+
+  if (handle != 0) {
+    drmSyncobjDestroy(drm_fd_, handle);
+    handle = 0;
+  }
+}
+
+bool DmabufPresenter::SignalAcquirePoint(uint64_t point, int fence_fd) {
+  uint32_t handle = 0;
+  bool signaled = drmSyncobjCreate(drm_fd_, 0, &handle) == 0;
+
+  if (signaled) {
+    signaled = fence_fd >= 0
+                   ? drmSyncobjImportSyncFile(drm_fd_, handle, fence_fd) == 0
+                   : drmSyncobjSignal(drm_fd_, &handle, 1) == 0;
+    signaled = signaled && drmSyncobjTransfer(drm_fd_, acquire_timeline_handle_,
+                                              point, handle, 0, 0) == 0;
+    drmSyncobjDestroy(drm_fd_, handle);
+  }
+
+  if (fence_fd >= 0) {
+    ::close(fence_fd);
+  }
+
+  return signaled;
+}
+
+void DmabufPresenter::WaitForRelease(Buffer& buffer) {
+  if (!syncobj_surface_ || buffer.release_point == 0) {
+    return;
+  }
+
+  FLWAY_TRACE_SCOPE("DmabufPresenter::WaitForRelease");
+
+  // The compositor may release the buffer before it has even submitted the
+  // work that reads it. Wait on the CPU only until the release point has a
+  // fence, and leave waiting for that fence to the GPU.
+  uint64_t point = buffer.release_point;
+  const int64_t deadline =
+      GetCurrentTimeNanos() +
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          kBufferReleaseTimeout)
+          .count();
+  if (drmSyncobjTimelineWait(drm_fd_, &buffer.release_timeline_handle, &point,
+                             1, deadline,
+                             DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT |
+                                 DRM_SYNCOBJ_WAIT_FLAGS_WAIT_AVAILABLE,
+                             nullptr) != 0) {
+    FLWAY_ERROR << "The compositor did not signal the release point of a "
+                   "buffer. Rendering into it anyway."
+                << std::endl;
+    return;
+  }
+
+  uint32_t handle = 0;
+  if (drmSyncobjCreate(drm_fd_, 0, &handle) != 0) {
+    return;
+  }
+
+  int fence_fd = -1;
+  const bool exported =
+      drmSyncobjTransfer(drm_fd_, handle, 0, buffer.release_timeline_handle,
+                         point, 0) == 0 &&
+      drmSyncobjExportSyncFile(drm_fd_, handle, &fence_fd) == 0;
+  drmSyncobjDestroy(drm_fd_, handle);
+
+  if (!exported) {
+    return;
+  }
+
+  WaitForNativeFence(egl_display_, fence_fd);
+}
+
+uint32_t DmabufPresenter::AcquireFramebuffer(int width, int height) {
+  if (!valid_) {
+    return 0;
+  }
+
+  if ((width != buffer_width_ || height != buffer_height_) &&
+      !AllocateBuffers(width, height)) {
+    return 0;
+  }
+
+  FLWAY_TRACE_SCOPE("DmabufPresenter::AcquireFramebuffer");
+
+  // Prefer the free buffer presented longest ago.
+  auto pick_free_buffer = [this]() -> Buffer* {
+    Buffer* oldest = nullptr;
+    for (auto& buffer : buffers_) {
+      if (buffer->busy) {
+        continue;
+      }
+      if (!oldest || buffer->presented_frame < oldest->presented_frame) {
+        oldest = buffer.get();
+      }
+    }
+    return oldest;
+  };
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  Buffer* buffer = nullptr;
+  if (!buffer_released_cv_.wait_for(
+          lock, kBufferReleaseTimeout,
+          [&]() { return (buffer = pick_free_buffer()) != nullptr; })) {
+    FLWAY_ERROR << "The compositor did not release any buffer. Reusing the "
+                   "oldest one."
+                << std::endl;
+    buffer = std::min_element(buffers_.begin(), buffers_.end(),
+                              [](const std::unique_ptr<Buffer>& a,
+                                 const std::unique_ptr<Buffer>& b) {
+                                return a->presented_frame < b->presented_frame;
+                              })
+                 ->get();
+  }
+
+  lock.unlock();
+
+  WaitForRelease(*buffer);
+
+  acquired_buffer_ = buffer;
+  return buffer->framebuffer;
+}
+
+int DmabufPresenter::GetBufferAge() const {
+  if (!acquired_buffer_ || acquired_buffer_->presented_frame == 0) {
+    return 0;
+  }
+
+  return frames_presented_ - acquired_buffer_->presented_frame + 1;
+}
+
+bool DmabufPresenter::Present(const FlutterRect* damage, size_t damage_count) {
+  if (!acquired_buffer_) {
+    FLWAY_ERROR << "Presented without acquiring a buffer." << std::endl;
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("DmabufPresenter::Present");
+
+  Buffer& buffer = *acquired_buffer_;
+  acquired_buffer_ = nullptr;
+
+  if (syncobj_surface_) {
+    const uint64_t acquire_point = ++acquire_point_;
+    const uint64_t release_point = ++buffer.last_release_point;
+
+    if (!SignalAcquirePoint(acquire_point, CreateNativeFence(egl_display_))) {
+      FLWAY_ERROR << "Could not signal the acquire point." << std::endl;
+      return false;
+    }
+
+    wp_linux_drm_syncobj_surface_v1_set_acquire_point(
+        syncobj_surface_, acquire_timeline_, acquire_point >> 32,
+        acquire_point & 0xffffffff);
+    wp_linux_drm_syncobj_surface_v1_set_release_point(
+        syncobj_surface_, buffer.release_timeline, release_point >> 32,
+        release_point & 0xffffffff);
+    buffer.release_point = release_point;
+  } else {
+    // Implicit synchronization makes the compositor wait for the rendering
+    // once the commands are submitted.
+    glFlush();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer.busy = true;
+  }
+
+  frames_presented_++;
+  buffer.presented_frame = frames_presented_;
+
+  wl_surface_attach(surface_, buffer.buffer, 0, 0);
+
+  if (damage == nullptr || damage_count == 0) {
+    wl_surface_damage_buffer(surface_, 0, 0, buffer_width_, buffer_height_);
+  } else {
+    for (size_t i = 0; i < damage_count; i++) {
+      const auto& rect = damage[i];
+      wl_surface_damage_buffer(surface_, rect.left, rect.top,
+                               rect.right - rect.left,
+                               rect.bottom - rect.top);
+    }
+  }
+
+  wl_surface_commit(surface_);
+  wl_display_flush(display_);
+  return true;
+}
+
+bool DmabufPresenter::AllocateBuffers(int width, int height) {
+  FLWAY_TRACE_SCOPE("DmabufPresenter::AllocateBuffers");
+
+  DestroyBuffers(true);
+
+  for (auto& buffer : buffers_) {
+    if (!CreateBuffer(*buffer, width, height)) {
+      DestroyBuffers(true);
+      buffer_width_ = 0;
+      buffer_height_ = 0;
+      return false;
+    }
+  }
+
+  buffer_width_ = width;
+  buffer_height_ = height;
+  frames_presented_ = 0;
+  return true;
+}
+
+bool DmabufPresenter::CreateBuffer(Buffer& buffer, int width, int height) {
+  uint64_t modifier = kDmabufModifierInvalid;
+
+  if (!modifiers_.empty()) {
+    buffer.bo =
+        gbm_bo_create_with_modifiers(gbm_device_, width, height, format_,
+                                     modifiers_.data(), modifiers_.size());
+    if (buffer.bo) {
+      modifier = gbm_bo_get_modifier(buffer.bo);
+    }
+  }
+
+  if (!buffer.bo) {
+    buffer.bo = gbm_bo_create(gbm_device_, width, height, format_,
+                              GBM_BO_USE_RENDERING);
+  }
+
+  if (!buffer.bo) {
+    FLWAY_ERROR << "Could not allocate a " << width << "x" << height
+                << " buffer." << std::endl;
+    return false;
+  }
+
+  const int plane_count = std::min(gbm_bo_get_plane_count(buffer.bo), 4);
+  const int fd = gbm_bo_get_fd(buffer.bo);
+
+  if (fd == -1 || plane_count <= 0) {
+    FLWAY_ERROR << "Could not export the buffer." << std::endl;
+    return false;
+  }
+
+  DmabufPlane planes[4];
+  for (int i = 0; i < plane_count; i++) {
+    planes[i].fd = fd;
+    planes[i].offset = gbm_bo_get_offset(buffer.bo, i);
+    planes[i].stride = gbm_bo_get_stride_for_plane(buffer.bo, i);
+  }
+
+  buffer.image = CreateDmabufImage(egl_display_, width, height, format_,
+                                   modifier, planes, plane_count);
+
+  // The compositor imports the buffer from the same planes.
+  zwp_linux_buffer_params_v1* params =
+      zwp_linux_dmabuf_v1_create_params(linux_dmabuf_);
+  for (int i = 0; i < plane_count; i++) {
+    zwp_linux_buffer_params_v1_add(params, fd, i, planes[i].offset,
+                                   planes[i].stride, modifier >> 32,
+                                   modifier & 0xffffffff);
+  }
+  // GL renders bottom up.
+  wl_buffer* wl_buffer = zwp_linux_buffer_params_v1_create_immed(
+      params, width, height, format_,
+      ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT);
+  zwp_linux_buffer_params_v1_destroy(params);
+
+  // Both the EGLImage and the wl_buffer hold references of their own.
+  ::close(fd);
+
+  if (buffer.image == EGL_NO_IMAGE_KHR || !wl_buffer) {
+    FLWAY_ERROR << "Could not import the buffer." << std::endl;
+    if (wl_buffer) {
+      wl_buffer_destroy(wl_buffer);
+    }
+    return false;
+  }
+
+  wl_buffer_add_listener(wl_buffer, &kBufferListener, &buffer);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffer.buffer = wl_buffer;
+    buffer.busy = false;
+  }
+  buffer.presented_frame = 0;
+  buffer.release_point = 0;
+
+  glGenRenderbuffers(1, &buffer.color_renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, buffer.color_renderbuffer);
+  image_target_renderbuffer_(GL_RENDERBUFFER, buffer.image);
+
+  // Skia needs a stencil buffer for path rendering.
+  glGenRenderbuffers(1, &buffer.stencil_renderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, buffer.stencil_renderbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &buffer.framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, buffer.framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, buffer.color_renderbuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, buffer.stencil_renderbuffer);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    FLWAY_ERROR << "Buffer framebuffer is incomplete: " << status
+                << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// Buffers still attached to the surface may be destroyed. The compositor
+// keeps its own reference to their storage.
+void DmabufPresenter::DestroyBuffer(Buffer& buffer, bool context_current) {
+  if (context_current) {
+    glDeleteFramebuffers(1, &buffer.framebuffer);
+    glDeleteRenderbuffers(1, &buffer.stencil_renderbuffer);
+    glDeleteRenderbuffers(1, &buffer.color_renderbuffer);
+  }
+  buffer.framebuffer = 0;
+  buffer.stencil_renderbuffer = 0;
+  buffer.color_renderbuffer = 0;
+
+  wl_buffer* wl_buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(wl_buffer, buffer.buffer);
+    buffer.busy = false;
+  }
+  if (wl_buffer) {
+    wl_buffer_destroy(wl_buffer);
+  }
+
+  DestroyEGLImage(egl_display_, buffer.image);
+  buffer.image = EGL_NO_IMAGE_KHR;
+
+  if (buffer.bo) {
+    gbm_bo_destroy(buffer.bo);
+    buffer.bo = nullptr;
+  }
+
+  buffer.presented_frame = 0;
+  buffer.release_point = 0;
+}
+
+void DmabufPresenter::DestroyBuffers(bool context_current) {
+  acquired_buffer_ = nullptr;
+  for (auto& buffer : buffers_) {
+    DestroyBuffer(*buffer, context_current);
+  }
+}
+
+// On the platform thread, which dispatches the connection.
+// Releases of buffers destroyed after a resize are ignored.
+void DmabufPresenter::OnBufferReleased(Buffer& buffer, wl_buffer* wl_buffer) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffer.buffer != wl_buffer) {
+      return;
+    }
+    buffer.busy = false;
+  }
+  buffer_released_cv_.notify_one();
+}
+
+}  // namespace flutter
@@ -0,0 +1,171 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <flutter_embedder.h>
+#include <gbm.h>
+#include <wayland-client.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "linux-drm-syncobj-v1-client-protocol.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Presents frames in buffers the embedder allocates itself instead of those
+// of wayland-egl. Buffers come from GBM on the render node of the EGL display,
+// are rendered into through an EGLImage backed framebuffer, and are attached
+// to the surface as zwp_linux_dmabuf_v1 buffers. The number of buffers is
+// fixed, and a buffer is only rendered into again once the compositor
+// released it. Buffers use the format modifiers the compositor advertised, so
+// drivers may pick tiled or compressed layouts.
+//
+// With wp_linux_drm_syncobj_v1 and native fences, synchronization is explicit.
+// Each commit carries a timeline point the compositor waits on for rendering
+// to finish, and one it signals once it is done reading the buffer. Rendering
+// into a released buffer waits on the GPU for the latter, so neither side
+// stalls the CPU on the other. A timeline wait is satisfied by any later
+// point, so acquire points share one timeline only we signal, and every
+// buffer has a release timeline of its own.
+//
+// The presenter of the window's own surface is constructed on the connect
+// thread during startup, those of compositor layers on the raster thread.
+// Either way it is destroyed on the platform thread once the engine no longer
+// renders. Everything else runs on the raster thread with the onscreen context
+// current, except for buffer releases, which arrive on the platform thread.
+class DmabufPresenter {
+ public:
+  // |modifiers| are those the compositor advertised for |format|. Empty if it
+  // only supports implicit modifiers. |syncobj_manager| may be null, in which
+  // case synchronization is implicit.
+  DmabufPresenter(wl_display* display,
+                  wl_surface* surface,
+                  zwp_linux_dmabuf_v1* linux_dmabuf,
+                  wp_linux_drm_syncobj_manager_v1* syncobj_manager,
+                  EGLDisplay egl_display,
+                  uint32_t format,
+                  std::vector<uint64_t> modifiers,
+                  size_t buffer_count);
+
+  ~DmabufPresenter();
+
+  bool IsValid() const;
+
+  bool UsesExplicitSync() const;
+
+  // Picks the buffer for the next frame, waiting for the compositor to release
+  // one if all of them are attached. The buffers are reallocated when the size
+  // changes. Returns the framebuffer to render into, or zero on failure.
+  uint32_t AcquireFramebuffer(int width, int height);
+
+  // The age of the acquired buffer in the sense of EGL_EXT_buffer_age. Zero if
+  // its contents are undefined.
+  int GetBufferAge() const;
+
+  // Attaches the acquired buffer with |damage| in buffer coordinates and
+  // commits the surface.
+  bool Present(const FlutterRect* damage, size_t damage_count);
+
+ private:
+  static const wl_buffer_listener kBufferListener;
+
+  struct Buffer {
+    DmabufPresenter* presenter = nullptr;
+    gbm_bo* bo = nullptr;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    GLuint color_renderbuffer = 0;
+    GLuint stencil_renderbuffer = 0;
+    GLuint framebuffer = 0;
+    // Replaced on the raster thread and compared against in release events
+    // on the platform thread. Both guarded by |mutex_|.
+    wl_buffer* buffer = nullptr;
+    // Attached to the surface and not released yet.
+    bool busy = false;
+    // The value of |frames_presented_| after this buffer was last presented.
+    // Zero if it never was.
+    uint64_t presented_frame = 0;
+    // Explicit synchronization only. The compositor signals the points of
+    // |release_timeline| once it stops reading the buffer.
+    uint32_t release_timeline_handle = 0;
+    wp_linux_drm_syncobj_timeline_v1* release_timeline = nullptr;
+    // The last point set on |release_timeline|. Never reset, so the points of
+    // the timeline only ever increase.
+    uint64_t last_release_point = 0;
+    // The point to wait on before rendering into the buffer again. Zero if
+    // there is nothing to wait for.
+    uint64_t release_point = 0;
+  };
+
+  wl_display* display_;
+  wl_surface* surface_;
+  zwp_linux_dmabuf_v1* linux_dmabuf_;
+  EGLDisplay egl_display_;
+  uint32_t format_;
+  std::vector<uint64_t> modifiers_;
+  const size_t buffer_count_;
+  bool valid_ = false;
+  int drm_fd_ = -1;
+  gbm_device* gbm_device_ = nullptr;
+  PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC image_target_renderbuffer_ =
+      nullptr;
+  // Explicit synchronization. Used on the raster thread only.
+  wp_linux_drm_syncobj_surface_v1* syncobj_surface_ = nullptr;
+  wp_linux_drm_syncobj_timeline_v1* acquire_timeline_ = nullptr;
+  uint32_t acquire_timeline_handle_ = 0;
+  uint64_t acquire_point_ = 0;
+  // Raster thread only, except for the busy flags.
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  int buffer_width_ = 0;
+  int buffer_height_ = 0;
+  Buffer* acquired_buffer_ = nullptr;
+  uint64_t frames_presented_ = 0;
+  std::mutex mutex_;
+  std::condition_variable buffer_released_cv_;
+
+  bool OpenRenderNode();
+
+  bool SetupExplicitSync(wp_linux_drm_syncobj_manager_v1* syncobj_manager);
+
+  void TeardownExplicitSync();
+
+  // Creates a timeline syncobj and imports it into the compositor.
+  bool CreateTimeline(wp_linux_drm_syncobj_manager_v1* syncobj_manager,
+                      uint32_t& handle,
+                      wp_linux_drm_syncobj_timeline_v1*& timeline);
+
+  void DestroyTimeline(uint32_t& handle,
+                       wp_linux_drm_syncobj_timeline_v1*& timeline);
+
+  // Makes acquire |point| signal along with |fence_fd|, which it takes
+  // ownership of. A negative fd signals the point right away.
+  bool SignalAcquirePoint(uint64_t point, int fence_fd);
+
+  // Makes the GL commands issued after this wait for |buffer|'s release point.
+  void WaitForRelease(Buffer& buffer);
+
+  bool AllocateBuffers(int width, int height);
+
+  bool CreateBuffer(Buffer& buffer, int width, int height);
+
+  void DestroyBuffer(Buffer& buffer, bool context_current);
+
+  void DestroyBuffers(bool context_current);
+
+  void OnBufferReleased(Buffer& buffer, wl_buffer* wl_buffer);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(DmabufPresenter);
+};
+
+}  // namespace flutter
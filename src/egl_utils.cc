@@ -0,0 +1,250 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "egl_utils.h"
+
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+namespace flutter {
+
+void LogLastEGLError() {
+  struct EGLNameErrorPair {
+    const char* name;
+    EGLint code;
+  };
+
+#define _EGL_ERROR_DESC(a) \
+  { #a, a }
+
+  const EGLNameErrorPair pairs[] = {
+      _EGL_ERROR_DESC(EGL_SUCCESS),
+      _EGL_ERROR_DESC(EGL_NOT_INITIALIZED),
+      _EGL_ERROR_DESC(EGL_BAD_ACCESS),
+      _EGL_ERROR_DESC(EGL_BAD_ALLOC),
+      _EGL_ERROR_DESC(EGL_BAD_ATTRIBUTE),
+      _EGL_ERROR_DESC(EGL_BAD_CONTEXT),
+      _EGL_ERROR_DESC(EGL_BAD_CONFIG),
+      _EGL_ERROR_DESC(EGL_BAD_CURRENT_SURFACE),
+      _EGL_ERROR_DESC(EGL_BAD_DISPLAY),
+      _EGL_ERROR_DESC(EGL_BAD_SURFACE),
+      _EGL_ERROR_DESC(EGL_BAD_MATCH),
+      _EGL_ERROR_DESC(EGL_BAD_PARAMETER),
+      _EGL_ERROR_DESC(EGL_BAD_NATIVE_PIXMAP),
+      _EGL_ERROR_DESC(EGL_BAD_NATIVE_WINDOW),
+      _EGL_ERROR_DESC(EGL_CONTEXT_LOST),
+  };
+
+#undef _EGL_ERROR_DESC
+
+  const auto count = sizeof(pairs) / sizeof(EGLNameErrorPair);
+
+  EGLint last_error = eglGetError();
+
+  for (size_t i = 0; i < count; i++) {
+    if (last_error == pairs[i].code) {
+      FLWAY_ERROR << "EGL Error: " << pairs[i].name << " (" << pairs[i].code
+                  << ")" << std::endl;
+      return;
+    }
+  }
+
+  FLWAY_ERROR << "Unknown EGL Error" << std::endl;
+}
+
+bool HasEGLExtension(EGLDisplay display, const char* name) {
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (extensions == nullptr) {
+    return false;
+  }
+
+  const size_t length = strlen(name);
+  for (const char* found = strstr(extensions, name); found != nullptr;
+       found = strstr(found + length, name)) {
+    if ((found == extensions || found[-1] == ' ') &&
+        (found[length] == ' ' || found[length] == '\0')) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+struct NativeFenceProcs {
+  PFNEGLCREATESYNCKHRPROC create_sync = nullptr;
+  PFNEGLDESTROYSYNCKHRPROC destroy_sync = nullptr;
+  PFNEGLWAITSYNCKHRPROC wait_sync = nullptr;
+  PFNEGLDUPNATIVEFENCEFDANDROIDPROC dup_native_fence_fd = nullptr;
+};
+
+static const NativeFenceProcs& GetNativeFenceProcs() {
+  static const NativeFenceProcs procs = []() {
+    NativeFenceProcs procs;
+    procs.create_sync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(
+        eglGetProcAddress("eglCreateSyncKHR"));
+    procs.destroy_sync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(
+        eglGetProcAddress("eglDestroySyncKHR"));
+    procs.wait_sync = reinterpret_cast<PFNEGLWAITSYNCKHRPROC>(
+        eglGetProcAddress("eglWaitSyncKHR"));
+    procs.dup_native_fence_fd =
+        reinterpret_cast<PFNEGLDUPNATIVEFENCEFDANDROIDPROC>(
+            eglGetProcAddress("eglDupNativeFenceFDANDROID"));
+    return procs;
+  }();
+  return procs;
+}
+
+bool HasNativeFenceSync(EGLDisplay display) {
+  const auto& procs = GetNativeFenceProcs();
+  return procs.create_sync != nullptr && procs.destroy_sync != nullptr &&
+         procs.wait_sync != nullptr && procs.dup_native_fence_fd != nullptr &&
+         HasEGLExtension(display, "EGL_ANDROID_native_fence_sync") &&
+         HasEGLExtension(display, "EGL_KHR_wait_sync");
+}
+
+void WaitForNativeFence(EGLDisplay display, int fence_fd) {
+  if (fence_fd < 0) {
+    return;
+  }
+
+  if (HasNativeFenceSync(display)) {
+    const auto& procs = GetNativeFenceProcs();
+    const EGLint attribs[] = {EGL_SYNC_NATIVE_FENCE_FD_ANDROID, fence_fd,
+                              EGL_NONE};
+    EGLSyncKHR sync =
+        procs.create_sync(display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+    // On success, the sync object owns the fd.
+    if (sync != EGL_NO_SYNC_KHR) {
+      procs.wait_sync(display, sync, 0);
+      procs.destroy_sync(display, sync);
+      return;
+    }
+    LogLastEGLError();
+  }
+
+  struct pollfd poll_fd = {};
+  poll_fd.fd = fence_fd;
+  poll_fd.events = POLLIN;
+  while (::poll(&poll_fd, 1, -1) == -1 && errno == EINTR) {
+  }
+  ::close(fence_fd);
+}
+
+int CreateNativeFence(EGLDisplay display) {
+  if (HasNativeFenceSync(display)) {
+    const auto& procs = GetNativeFenceProcs();
+    const EGLint attribs[] = {EGL_SYNC_NATIVE_FENCE_FD_ANDROID,
+                              EGL_NO_NATIVE_FENCE_FD_ANDROID, EGL_NONE};
+    EGLSyncKHR sync =
+        procs.create_sync(display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+    if (sync != EGL_NO_SYNC_KHR) {
+      // The fence only gets an fd once it is submitted.
+      glFlush();
+      const int fence_fd = procs.dup_native_fence_fd(display, sync);
+      procs.destroy_sync(display, sync);
+      if (fence_fd >= 0) {
+        return fence_fd;
+      }
+    }
+    LogLastEGLError();
+  }
+
+  glFinish();
+  return -1;
+}
+
+static const EGLint kPlaneAttributes[4][5] = {
+    {EGL_DMA_BUF_PLANE0_FD_EXT, EGL_DMA_BUF_PLANE0_OFFSET_EXT,
+     EGL_DMA_BUF_PLANE0_PITCH_EXT, EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT,
+     EGL_DMA_BUF_PLANE0_MODIFIER_HI_EXT},
+    {EGL_DMA_BUF_PLANE1_FD_EXT, EGL_DMA_BUF_PLANE1_OFFSET_EXT,
+     EGL_DMA_BUF_PLANE1_PITCH_EXT, EGL_DMA_BUF_PLANE1_MODIFIER_LO_EXT,
+     EGL_DMA_BUF_PLANE1_MODIFIER_HI_EXT},
+    {EGL_DMA_BUF_PLANE2_FD_EXT, EGL_DMA_BUF_PLANE2_OFFSET_EXT,
+     EGL_DMA_BUF_PLANE2_PITCH_EXT, EGL_DMA_BUF_PLANE2_MODIFIER_LO_EXT,
+     EGL_DMA_BUF_PLANE2_MODIFIER_HI_EXT},
+    {EGL_DMA_BUF_PLANE3_FD_EXT, EGL_DMA_BUF_PLANE3_OFFSET_EXT,
+     EGL_DMA_BUF_PLANE3_PITCH_EXT, EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT,
+     EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT},
+};
+
+EGLImageKHR CreateDmabufImage(EGLDisplay display,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t fourcc,
+                              uint64_t modifier,
+                              const DmabufPlane* planes,
+                              size_t plane_count) {
+  static const auto create_image = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+      eglGetProcAddress("eglCreateImageKHR"));
+
+  if (display == EGL_NO_DISPLAY || create_image == nullptr ||
+      !HasEGLExtension(display, "EGL_EXT_image_dma_buf_import")) {
+    FLWAY_ERROR << "dmabuf import is not supported." << std::endl;
+    return EGL_NO_IMAGE_KHR;
+  }
+
+  const bool has_modifier = modifier != kDmabufModifierInvalid;
+
+  if (plane_count == 0 || plane_count > 4 ||
+      ((has_modifier || plane_count > 3) &&
+       !HasEGLExtension(display, "EGL_EXT_image_dma_buf_import_modifiers"))) {
+    FLWAY_ERROR << "Unsupported dmabuf layout." << std::endl;
+    return EGL_NO_IMAGE_KHR;
+  }
+
+  std::vector<EGLint> attribs = {
+      EGL_WIDTH,
+      static_cast<EGLint>(width),
+      EGL_HEIGHT,
+      static_cast<EGLint>(height),
+      EGL_LINUX_DRM_FOURCC_EXT,
+      static_cast<EGLint>(fourcc),
+  };
+
+  for (size_t i = 0; i < plane_count; i++) {
+    const auto& plane = planes[i];
+    attribs.insert(attribs.end(),
+                   {kPlaneAttributes[i][0], plane.fd, kPlaneAttributes[i][1],
+                    static_cast<EGLint>(plane.offset), kPlaneAttributes[i][2],
+                    static_cast<EGLint>(plane.stride)});
+    if (has_modifier) {
+      attribs.insert(attribs.end(),
+                     {kPlaneAttributes[i][3],
+                      static_cast<EGLint>(modifier & 0xffffffff),
+                      kPlaneAttributes[i][4],
+                      static_cast<EGLint>(modifier >> 32)});
+    }
+  }
+
+  attribs.push_back(EGL_NONE);
+
+  EGLImageKHR image = create_image(display, EGL_NO_CONTEXT,
+                                   EGL_LINUX_DMA_BUF_EXT, nullptr,
+                                   attribs.data());
+  if (image == EGL_NO_IMAGE_KHR) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not import the dmabuf." << std::endl;
+  }
+
+  return image;
+}
+
+void DestroyEGLImage(EGLDisplay display, EGLImageKHR image) {
+  static const auto destroy_image =
+      reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+          eglGetProcAddress("eglDestroyImageKHR"));
+
+  if (image != EGL_NO_IMAGE_KHR && destroy_image != nullptr) {
+    destroy_image(display, image);
+  }
+}
+
+}  // namespace flutter
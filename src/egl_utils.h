@@ -0,0 +1,59 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// DRM_FORMAT_MOD_INVALID. The buffer layout is implied by the allocation.
+static const uint64_t kDmabufModifierInvalid = 0x00ffffffffffffffULL;
+
+struct DmabufPlane {
+  int fd = -1;
+  uint32_t offset = 0;
+  uint32_t stride = 0;
+};
+
+void LogLastEGLError();
+
+// Whether |name| is in the display's extension string. Pass EGL_NO_DISPLAY
+// for client extensions.
+bool HasEGLExtension(EGLDisplay display, const char* name);
+
+// Fence file descriptors from EGL_ANDROID_native_fence_sync. A context on
+// |display| must be current on the calling thread.
+bool HasNativeFenceSync(EGLDisplay display);
+
+// Make the GL commands issued after this wait on the GPU for |fence_fd| to
+// signal. Waits on the CPU when native fences are not supported. Takes
+// ownership of |fence_fd|. A negative fd means there is nothing to wait for.
+void WaitForNativeFence(EGLDisplay display, int fence_fd);
+
+// Returns a fence fd that signals once the GL commands issued so far have
+// completed. Without native fences, waits for them with glFinish and returns
+// -1.
+int CreateNativeFence(EGLDisplay display);
+
+// Wraps the dmabuf planes in an EGLImage without copying them. Needs
+// EGL_EXT_image_dma_buf_import, and EGL_EXT_image_dma_buf_import_modifiers
+// for explicit modifiers or more than three planes. The planes only need to
+// stay open until this returns. Returns EGL_NO_IMAGE_KHR on failure.
+EGLImageKHR CreateDmabufImage(EGLDisplay display,
+                              uint32_t width,
+                              uint32_t height,
+                              uint32_t fourcc,
+                              uint64_t modifier,
+                              const DmabufPlane* planes,
+                              size_t plane_count);
+
+void DestroyEGLImage(EGLDisplay display, EGLImageKHR image);
+
+}  // namespace flutter
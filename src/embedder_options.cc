@@ -0,0 +1,209 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "embedder_options.h"
+
+#include <stdlib.h>
+
+namespace flutter {
+
+static bool ParseSwitch(const std::string& arg,
+                        const std::string& name,
+                        std::string& value) {
+  const auto prefix = "--" + name + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+bool ParseEmbedderOptions(std::vector<std::string>& args,
+                          EmbedderOptions& options) {
+  std::vector<std::string> remaining;
+  bool valid = true;
+
+  for (const auto& arg : args) {
+    std::string value;
+
+    if (ParseSwitch(arg, "vsync-source", value)) {
+      if (value == "frame-callback") {
+        options.use_presentation_feedback = false;
+      } else if (value == "presentation") {
+        options.use_presentation_feedback = true;
+      } else {
+        FLWAY_ERROR << "Unknown vsync source: " << value << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "present-mode", value)) {
+      if (value == "driver") {
+        options.present_mode = EmbedderOptions::PresentMode::kDriver;
+      } else if (value == "throttled") {
+        options.present_mode = EmbedderOptions::PresentMode::kThrottled;
+      } else {
+        FLWAY_ERROR << "Unknown present mode: " << value << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "presenter", value)) {
+      if (value == "wayland-egl") {
+        options.presenter = EmbedderOptions::Presenter::kWaylandEGL;
+      } else if (value == "dmabuf") {
+        options.presenter = EmbedderOptions::Presenter::kDmabuf;
+      } else {
+        FLWAY_ERROR << "Unknown presenter: " << value << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "buffer-count", value)) {
+      char* end = nullptr;
+      const unsigned long count = ::strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || count < 2 || count > 4) {
+        FLWAY_ERROR << "Invalid buffer count: " << value << std::endl;
+        valid = false;
+      } else {
+        options.buffer_count = count;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "sync", value)) {
+      if (value == "implicit") {
+        options.explicit_sync = false;
+      } else if (value == "explicit") {
+        options.explicit_sync = true;
+      } else {
+        FLWAY_ERROR << "Unknown synchronization mode: " << value << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "pointer-coalescing", value)) {
+      if (value == "off") {
+        options.pointer_coalescing = EmbedderOptions::PointerCoalescing::kOff;
+      } else if (value == "merge") {
+        options.pointer_coalescing = EmbedderOptions::PointerCoalescing::kMerge;
+      } else if (value == "predict") {
+        options.pointer_coalescing =
+            EmbedderOptions::PointerCoalescing::kPredict;
+      } else {
+        FLWAY_ERROR << "Unknown pointer coalescing mode: " << value
+                    << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "stats-interval", value)) {
+      char* end = nullptr;
+      const unsigned long seconds = ::strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || seconds > UINT32_MAX) {
+        FLWAY_ERROR << "Invalid stats interval: " << value << std::endl;
+        valid = false;
+      } else {
+        options.stats_interval_seconds = seconds;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "resource-cache-frames", value)) {
+      char* end = nullptr;
+      const unsigned long frames = ::strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || frames > 64) {
+        FLWAY_ERROR << "Invalid resource cache frame count: " << value
+                    << std::endl;
+        valid = false;
+      } else {
+        options.resource_cache_frames = frames;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "trace-to", value)) {
+      if (value.empty()) {
+        FLWAY_ERROR << "Missing trace file path." << std::endl;
+        valid = false;
+      } else {
+        options.trace_path = value;
+      }
+      continue;
+    }
+
+    if (ParseSwitch(arg, "log-level", value)) {
+      if (value == "info") {
+        options.log_severity = LogSeverity::kInfo;
+      } else if (value == "error") {
+        options.log_severity = LogSeverity::kError;
+      } else if (value == "none") {
+        options.log_severity = LogSeverity::kNone;
+      } else {
+        FLWAY_ERROR << "Unknown log level: " << value << std::endl;
+        valid = false;
+      }
+      continue;
+    }
+
+    if (arg == "--subsurfaces") {
+      options.subsurfaces = true;
+      continue;
+    }
+
+    if (arg == "--fullscreen") {
+      options.fullscreen = true;
+      continue;
+    }
+
+    if (ParseSwitch(arg, "window", value)) {
+      if (value.empty()) {
+        FLWAY_ERROR << "Missing window asset bundle path." << std::endl;
+        valid = false;
+      } else {
+        options.window_bundle_paths.push_back(value);
+      }
+      continue;
+    }
+
+    if (arg == "--memory-pressure") {
+      options.memory_pressure = true;
+      continue;
+    }
+
+    if (arg == "--power-saving") {
+      options.power_saving = true;
+      continue;
+    }
+
+    if (arg == "--headless") {
+      options.headless = true;
+      continue;
+    }
+
+    if (ParseSwitch(arg, "headless-refresh-rate", value)) {
+      char* end = nullptr;
+      const double rate = ::strtod(value.c_str(), &end);
+      if (value.empty() || *end != '\0' || !(rate >= 0.0)) {
+        FLWAY_ERROR << "Invalid headless refresh rate: " << value << std::endl;
+        valid = false;
+      } else {
+        options.headless_refresh_rate = rate;
+      }
+      continue;
+    }
+
+    remaining.push_back(arg);
+  }
+
+  args = std::move(remaining);
+  return valid;
+}
+
+}  // namespace flutter
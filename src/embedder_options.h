@@ -0,0 +1,109 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Switches understood by the embedder itself. These are removed from the
+// command line before the remaining arguments are handed to the engine.
+struct EmbedderOptions {
+  enum class PresentMode {
+    // Leave the swap interval at the driver default. The driver throttles
+    // eglSwapBuffers on its own frame callbacks.
+    kDriver,
+    // Use a swap interval of zero so presents never block in the driver and
+    // rely on the embedder's frame callback bookkeeping for throttling.
+    kThrottled,
+  };
+
+  enum class Presenter {
+    // The driver allocates and recycles the buffers through wayland-egl.
+    kWaylandEGL,
+    // The embedder allocates its own buffers with GBM and attaches them with
+    // zwp_linux_dmabuf_v1.
+    kDmabuf,
+  };
+
+  enum class PointerCoalescing {
+    // Every pointer sample is sent to the engine as it arrives.
+    kOff,
+    // Consecutive moves of a pointer are merged until the next vsync.
+    kMerge,
+    // Like |kMerge|, and merged moves are extrapolated to the frame target
+    // time.
+    kPredict,
+  };
+
+  PresentMode present_mode = PresentMode::kDriver;
+
+  Presenter presenter = Presenter::kWaylandEGL;
+
+  // Buffers the dmabuf presenter cycles through. Two for the lowest latency,
+  // three to let the engine render ahead of the compositor.
+  uint32_t buffer_count = 2;
+
+  // Hand the dmabuf presenter's fences to the compositor with
+  // wp_linux_drm_syncobj_v1 when both sides support it, instead of relying on
+  // the driver's implicit synchronization.
+  bool explicit_sync = true;
+
+  // Present the layers of each frame as subsurfaces for the compositor to
+  // blend, instead of flattening them on the GPU. Needs the dmabuf presenter.
+  bool subsurfaces = false;
+
+  // Log messages below this severity are dropped.
+  LogSeverity log_severity = LogSeverity::kInfo;
+
+  PointerCoalescing pointer_coalescing = PointerCoalescing::kOff;
+
+  // Cover the whole output with an opaque surface so the compositor can scan
+  // it out directly instead of compositing it.
+  bool fullscreen = false;
+
+  // Pause the engine's frame production and tell the app it is paused while
+  // its window cannot be seen.
+  bool power_saving = false;
+
+  // Tell the engines when the system runs short of memory.
+  bool memory_pressure = false;
+
+  // Limit the GPU resource cache of each engine to this many frames of its
+  // window's size. Zero leaves the limit to the engine.
+  uint32_t resource_cache_frames = 0;
+
+  // Log frame timing statistics this often. Zero disables instrumentation.
+  uint32_t stats_interval_seconds = 0;
+
+  // Record embedder spans and write them to this file on exit. Empty disables
+  // tracing.
+  std::string trace_path;
+
+  // Refine frame timing with wp_presentation feedback when the compositor
+  // supports it. Otherwise, only wl_surface.frame callbacks are used.
+  bool use_presentation_feedback = false;
+
+  // The asset bundles of the engines run in windows of their own next to the
+  // main one, sharing its connection and EGL display.
+  std::vector<std::string> window_bundle_paths;
+
+  // Render into an offscreen framebuffer instead of a Wayland surface.
+  bool headless = false;
+
+  // The rate of the virtual vsync in headless mode. Zero hands out frames as
+  // fast as the engine asks for them.
+  double headless_refresh_rate = 60.0;
+};
+
+// Extracts embedder switches from |args|. Returns false if a switch was
+// recognized but its value was not.
+bool ParseEmbedderOptions(std::vector<std::string>& args,
+                          EmbedderOptions& options);
+
+}  // namespace flutter
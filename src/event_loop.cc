@@ -0,0 +1,217 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "event_loop.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "time_base.h"
+
+namespace flutter {
+
+static const size_t kMaxEventsPerWait = 16;
+
+EventLoop::EventLoop() {
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+
+  if (epoll_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the epoll instance: "
+                << ::strerror(errno) << std::endl;
+    return;
+  }
+}
+
+EventLoop::~EventLoop() {
+  if (epoll_fd_ != -1) {
+    ::close(epoll_fd_);
+    epoll_fd_ = -1;
+  }
+}
+
+bool EventLoop::IsValid() const {
+  return epoll_fd_ != -1;
+}
+
+bool EventLoop::AddFileDescriptor(int fd,
+                                  uint32_t events,
+                                  FileDescriptorCallback callback) {
+  if (!IsValid() || fd < 0 || !callback) {
+    return false;
+  }
+
+  struct epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+    FLWAY_ERROR << "Could not add file descriptor to the event loop: "
+                << ::strerror(errno) << std::endl;
+    return false;
+  }
+
+  callbacks_[fd] = std::move(callback);
+  return true;
+}
+
+bool EventLoop::RemoveFileDescriptor(int fd) {
+  if (callbacks_.erase(fd) == 0) {
+    return false;
+  }
+
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+    FLWAY_ERROR << "Could not remove file descriptor from the event loop: "
+                << ::strerror(errno) << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+void EventLoop::SetBeforeWaitCallback(Callback callback) {
+  before_wait_callback_ = std::move(callback);
+}
+
+void EventLoop::SetAfterWaitCallback(Callback callback) {
+  after_wait_callback_ = std::move(callback);
+}
+
+bool EventLoop::Run() {
+  if (!IsValid()) {
+    FLWAY_ERROR << "Could not run an invalid event loop." << std::endl;
+    return false;
+  }
+
+  running_ = true;
+
+  struct epoll_event events[kMaxEventsPerWait];
+
+  while (running_) {
+    if (before_wait_callback_) {
+      before_wait_callback_();
+    }
+
+    // All deadlines are expressed as timer file descriptors so the loop never
+    // needs a timeout of its own.
+    const int count = ::epoll_wait(epoll_fd_, events, kMaxEventsPerWait, -1);
+
+    if (count == -1 && errno != EINTR) {
+      FLWAY_ERROR << "Error while waiting on the event loop: "
+                  << ::strerror(errno) << std::endl;
+      return false;
+    }
+
+    for (int i = 0; i < count && running_; i++) {
+      auto found = callbacks_.find(events[i].data.fd);
+      if (found == callbacks_.end()) {
+        // Removed by a callback earlier in this iteration.
+        continue;
+      }
+      // The callback may remove itself from the loop.
+      auto callback = found->second;
+      callback(events[i].events);
+    }
+
+    if (after_wait_callback_) {
+      after_wait_callback_();
+    }
+  }
+
+  return true;
+}
+
+void EventLoop::Terminate() {
+  running_ = false;
+}
+
+Timer::Timer(EventLoop& loop, EventLoop::Callback callback)
+    : loop_(loop), callback_(std::move(callback)) {
+  timer_fd_ = ::timerfd_create(kTimeBaseClock, TFD_NONBLOCK | TFD_CLOEXEC);
+
+  if (timer_fd_ == -1) {
+    FLWAY_ERROR << "Could not create timer: " << ::strerror(errno)
+                << std::endl;
+    return;
+  }
+
+  if (!loop_.AddFileDescriptor(timer_fd_, EPOLLIN,
+                               [this](uint32_t) { OnTimerFired(); })) {
+    ::close(timer_fd_);
+    timer_fd_ = -1;
+    return;
+  }
+}
+
+Timer::~Timer() {
+  if (timer_fd_ != -1) {
+    loop_.RemoveFileDescriptor(timer_fd_);
+    ::close(timer_fd_);
+    timer_fd_ = -1;
+  }
+}
+
+bool Timer::IsValid() const {
+  return timer_fd_ != -1;
+}
+
+static struct timespec TimespecFromNanos(uint64_t nanos) {
+  struct timespec spec = {};
+  spec.tv_sec = nanos / kNanosPerSecond;
+  spec.tv_nsec = nanos % kNanosPerSecond;
+  return spec;
+}
+
+bool Timer::ArmAt(uint64_t target_time_nanos) {
+  if (!IsValid()) {
+    return false;
+  }
+
+  struct itimerspec spec = {};
+  // An all zero value disarms the timer. Clamp so that deadlines at the epoch
+  // still fire.
+  spec.it_value =
+      TimespecFromNanos(target_time_nanos == 0 ? 1 : target_time_nanos);
+
+  return ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+bool Timer::ArmRepeating(uint64_t interval_nanos) {
+  if (!IsValid() || interval_nanos == 0) {
+    return false;
+  }
+
+  struct itimerspec spec = {};
+  spec.it_value = TimespecFromNanos(interval_nanos);
+  spec.it_interval = TimespecFromNanos(interval_nanos);
+
+  return ::timerfd_settime(timer_fd_, 0, &spec, nullptr) == 0;
+}
+
+bool Timer::Disarm() {
+  if (!IsValid()) {
+    return false;
+  }
+
+  struct itimerspec spec = {};
+  return ::timerfd_settime(timer_fd_, 0, &spec, nullptr) == 0;
+}
+
+void Timer::OnTimerFired() {
+  uint64_t expirations = 0;
+  if (::read(timer_fd_, &expirations, sizeof(expirations)) !=
+      sizeof(expirations)) {
+    // Spurious wakeup or the timer was re-armed before we got to it.
+    return;
+  }
+
+  if (callback_) {
+    callback_();
+  }
+}
+
+}  // namespace flutter
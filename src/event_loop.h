@@ -0,0 +1,89 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A single threaded event loop built on epoll. File descriptors (the Wayland
+// connection, timers, wakeup event fds) are registered with the loop and their
+// callbacks are invoked on the thread that calls |Run|.
+class EventLoop {
+ public:
+  using Callback = std::function<void()>;
+  using FileDescriptorCallback = std::function<void(uint32_t events)>;
+
+  EventLoop();
+
+  ~EventLoop();
+
+  bool IsValid() const;
+
+  // Watch |fd| for |events| (EPOLLIN, EPOLLOUT, etc.). The loop does not take
+  // ownership of the file descriptor.
+  bool AddFileDescriptor(int fd,
+                         uint32_t events,
+                         FileDescriptorCallback callback);
+
+  bool RemoveFileDescriptor(int fd);
+
+  // Invoked on every iteration just before the loop blocks and after the file
+  // descriptor callbacks for that wakeup have been serviced. Used by clients
+  // that need to participate in the wait, like the Wayland
+  // prepare_read/read_events protocol.
+  void SetBeforeWaitCallback(Callback callback);
+
+  void SetAfterWaitCallback(Callback callback);
+
+  bool Run();
+
+  void Terminate();
+
+ private:
+  int epoll_fd_ = -1;
+  bool running_ = false;
+  std::map<int, FileDescriptorCallback> callbacks_;
+  Callback before_wait_callback_;
+  Callback after_wait_callback_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(EventLoop);
+};
+
+// A timer backed by a timerfd that fires on the event loop thread. All times
+// are in the time base of |time_base.h|.
+class Timer {
+ public:
+  Timer(EventLoop& loop, EventLoop::Callback callback);
+
+  ~Timer();
+
+  bool IsValid() const;
+
+  // Fire once at the absolute time |target_time_nanos|. Times in the past fire
+  // as soon as possible.
+  bool ArmAt(uint64_t target_time_nanos);
+
+  // Fire every |interval_nanos| starting one interval from now.
+  bool ArmRepeating(uint64_t interval_nanos);
+
+  bool Disarm();
+
+ private:
+  EventLoop& loop_;
+  EventLoop::Callback callback_;
+  int timer_fd_ = -1;
+
+  void OnTimerFired();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(Timer);
+};
+
+}  // namespace flutter
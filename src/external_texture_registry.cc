@@ -0,0 +1,258 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "external_texture_registry.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "tracing.h"
+
+namespace flutter {
+
+// GL_RGBA8_OES. External textures are sampled as RGBA whatever the dmabuf
+// format is.
+static const uint32_t kExternalTextureFormat = 0x8058;
+
+ExternalTextureRegistry::ExternalTextureRegistry()
+    : image_target_texture_(
+          reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(
+              eglGetProcAddress("glEGLImageTargetTexture2DOES"))) {}
+
+// The engine is shut down by now, so every frame it held has been retired.
+ExternalTextureRegistry::~ExternalTextureRegistry() {
+  std::vector<std::shared_ptr<ImportedFrame>> current;
+
+  for (auto& texture : textures_) {
+    if (texture.second.pending) {
+      ReleaseFrame(*texture.second.pending, -1);
+    }
+    current.push_back(std::move(texture.second.current));
+  }
+  current.clear();
+
+  for (auto& retired : retired_frames_) {
+    ReleaseImportedFrame(*retired, false);
+  }
+}
+
+int64_t ExternalTextureRegistry::AddTexture() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const int64_t texture_id = ++last_texture_id_;
+  textures_[texture_id] = {};
+  return texture_id;
+}
+
+void ExternalTextureRegistry::RemoveTexture(int64_t texture_id) {
+  Texture removed;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = textures_.find(texture_id);
+    if (found == textures_.end()) {
+      return;
+    }
+    removed = std::move(found->second);
+    textures_.erase(found);
+  }
+
+  if (removed.pending) {
+    ReleaseFrame(*removed.pending, -1);
+  }
+}
+
+bool ExternalTextureRegistry::PushFrame(int64_t texture_id,
+                                        DmabufFrame frame) {
+  std::unique_ptr<DmabufFrame> replaced(new DmabufFrame(std::move(frame)));
+  bool known = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = textures_.find(texture_id);
+    if (found != textures_.end()) {
+      std::swap(found->second.pending, replaced);
+      known = true;
+    }
+  }
+
+  // Either the frame the engine never got to, or the new frame itself if the
+  // texture is unknown. Callbacks are never invoked with the lock held.
+  if (replaced) {
+    ReleaseFrame(*replaced, -1);
+  }
+
+  if (!known) {
+    FLWAY_ERROR << "Frame pushed to unknown texture " << texture_id
+                << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool ExternalTextureRegistry::PopulateTexture(int64_t texture_id,
+                                              FlutterOpenGLTexture* texture) {
+  CollectRetiredFrames();
+
+  std::unique_ptr<DmabufFrame> frame;
+  std::shared_ptr<ImportedFrame> current;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = textures_.find(texture_id);
+    if (found == textures_.end()) {
+      return false;
+    }
+    frame = std::move(found->second.pending);
+    current = found->second.current;
+  }
+
+  if (frame) {
+    FLWAY_TRACE_SCOPE("ExternalTextureRegistry::PopulateTexture");
+
+    std::unique_ptr<ImportedFrame> imported(new ImportedFrame());
+    imported->display = eglGetCurrentDisplay();
+    imported->context = eglGetCurrentContext();
+
+    if (ImportFrame(imported->display, *frame, *imported)) {
+      imported->width = frame->width;
+      imported->height = frame->height;
+      imported->release = std::move(frame->release);
+      current.reset(imported.release(), [this](ImportedFrame* retired) {
+        RetireImportedFrame(retired);
+      });
+
+      std::shared_ptr<ImportedFrame> replaced;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = textures_.find(texture_id);
+        if (found != textures_.end()) {
+          replaced = std::move(found->second.current);
+          found->second.current = current;
+        }
+      }
+      // Dropped outside the lock, since it may be released right here.
+      replaced.reset();
+    } else {
+      // The previous frame is shown instead.
+      ReleaseFrame(*frame, -1);
+    }
+  }
+
+  if (!current) {
+    return false;
+  }
+
+  texture->target = GL_TEXTURE_EXTERNAL_OES;
+  texture->name = current->texture;
+  texture->format = kExternalTextureFormat;
+  texture->width = current->width;
+  texture->height = current->height;
+  // The engine destroys every texture it is handed separately.
+  texture->user_data = new std::shared_ptr<ImportedFrame>(std::move(current));
+  texture->destruction_callback = [](void* user_data) {
+    delete reinterpret_cast<std::shared_ptr<ImportedFrame>*>(user_data);
+  };
+
+  return true;
+}
+
+bool ExternalTextureRegistry::ImportFrame(EGLDisplay display,
+                                          DmabufFrame& frame,
+                                          ImportedFrame& imported) const {
+  if (image_target_texture_ == nullptr) {
+    FLWAY_ERROR << "EGLImage textures are not supported." << std::endl;
+    return false;
+  }
+
+  imported.image = CreateDmabufImage(
+      display, frame.width, frame.height, frame.fourcc, frame.modifier,
+      frame.planes.data(), std::min(frame.plane_count, frame.planes.size()));
+  if (imported.image == EGL_NO_IMAGE_KHR) {
+    return false;
+  }
+
+  // Commands sampling the texture wait on the GPU for the producer.
+  WaitForNativeFence(display, frame.acquire_fence_fd);
+  frame.acquire_fence_fd = -1;
+
+  glGenTextures(1, &imported.texture);
+  glBindTexture(GL_TEXTURE_EXTERNAL_OES, imported.texture);
+  glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S,
+                  GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T,
+                  GL_CLAMP_TO_EDGE);
+  image_target_texture_(GL_TEXTURE_EXTERNAL_OES, imported.image);
+  glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+
+  return true;
+}
+
+// The engine usually lets go of a texture on the raster thread, once the
+// commands drawing it have been issued.
+void ExternalTextureRegistry::RetireImportedFrame(ImportedFrame* imported) {
+  std::unique_ptr<ImportedFrame> owned(imported);
+
+  if (eglGetCurrentContext() == imported->context) {
+    ReleaseImportedFrame(*imported, true);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_frames_.push_back(std::move(owned));
+}
+
+// Only called with the onscreen context current, which every frame is
+// imported in.
+void ExternalTextureRegistry::CollectRetiredFrames() {
+  std::vector<std::unique_ptr<ImportedFrame>> retired;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (retired_frames_.empty()) {
+      return;
+    }
+    std::swap(retired, retired_frames_);
+  }
+
+  for (auto& frame : retired) {
+    ReleaseImportedFrame(*frame, true);
+  }
+}
+
+void ExternalTextureRegistry::ReleaseImportedFrame(ImportedFrame& imported,
+                                                   bool current_context) {
+  int release_fence_fd = -1;
+
+  if (current_context) {
+    // Covers the commands drawing the frame.
+    release_fence_fd = CreateNativeFence(imported.display);
+    glDeleteTextures(1, &imported.texture);
+  }
+  DestroyEGLImage(imported.display, imported.image);
+
+  if (imported.release) {
+    imported.release(release_fence_fd);
+  } else if (release_fence_fd >= 0) {
+    ::close(release_fence_fd);
+  }
+}
+
+void ExternalTextureRegistry::ReleaseFrame(DmabufFrame& frame,
+                                           int release_fence_fd) {
+  if (frame.acquire_fence_fd >= 0) {
+    ::close(frame.acquire_fence_fd);
+    frame.acquire_fence_fd = -1;
+  }
+
+  if (frame.release) {
+    frame.release(release_fence_fd);
+    frame.release = nullptr;
+  }
+}
+
+}  // namespace flutter
@@ -0,0 +1,131 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <flutter_embedder.h>
+#include <stdint.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "egl_utils.h"
+#include "macros.h"
+
+namespace flutter {
+
+// A frame produced into dmabufs, by a camera or video decoder for example.
+// The plane fds stay owned by the producer. They must stay valid until
+// |release| is invoked.
+struct DmabufFrame {
+  using Plane = DmabufPlane;
+
+  // Invoked once the engine no longer reads the buffers, on the raster thread
+  // or on the thread that replaced, dropped or shut down the frame.
+  // |release_fence_fd| signals when the GPU is done with them and is owned by
+  // the callee. It is -1 if the buffers may be reused right away.
+  using ReleaseCallback = std::function<void(int release_fence_fd)>;
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // A DRM_FORMAT_* fourcc. YUV formats are converted by the sampler.
+  uint32_t fourcc = 0;
+  uint64_t modifier = kDmabufModifierInvalid;
+  std::array<Plane, 4> planes;
+  size_t plane_count = 0;
+  // Signals when the producer has finished writing the buffers. Owned by the
+  // registry once pushed. -1 if the buffers are ready.
+  int acquire_fence_fd = -1;
+  ReleaseCallback release;
+};
+
+// Textures the engine composites from dmabufs without copying them. Each
+// frame is imported as an EGLImage and bound to a GL_TEXTURE_EXTERNAL_OES
+// texture on the raster thread, where the GPU also waits for the producer's
+// acquire fence. The newest frame stays imported, and is handed to the engine
+// again until another one replaces it. Frames that are replaced before the
+// engine picked them up are released right away.
+//
+// Imported frames are only released with the context they were imported in
+// current, so the release fence covers the commands drawing them. Frames the
+// engine lets go of elsewhere wait for the next |PopulateTexture|.
+class ExternalTextureRegistry {
+ public:
+  ExternalTextureRegistry();
+
+  ~ExternalTextureRegistry();
+
+  // Returns the identifier to register with the engine and to use in the
+  // framework's Texture widget. Safe to call from any thread.
+  int64_t AddTexture();
+
+  // Releases the frame waiting to be picked up, if any. Frames the engine is
+  // still drawing are released when the engine lets go of them.
+  void RemoveTexture(int64_t texture_id);
+
+  // Make |frame| the next one the engine draws for |texture_id|. Safe to call
+  // from any thread. Returns false and releases the frame if the texture is
+  // unknown.
+  bool PushFrame(int64_t texture_id, DmabufFrame frame);
+
+  // Invoked by the engine on the raster thread with the onscreen context
+  // current. Imports the frame pushed since the last call, if any, and hands
+  // out the newest imported frame. The engine draws nothing for the texture
+  // when this returns false, which only happens before its first frame could
+  // be imported.
+  bool PopulateTexture(int64_t texture_id, FlutterOpenGLTexture* texture);
+
+ private:
+  // Shared by the registry, while it is the newest frame of its texture, and
+  // by every copy the engine holds.
+  struct ImportedFrame {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    GLuint texture = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    DmabufFrame::ReleaseCallback release;
+  };
+
+  struct Texture {
+    std::unique_ptr<DmabufFrame> pending;
+    std::shared_ptr<ImportedFrame> current;
+  };
+
+  PFNGLEGLIMAGETARGETTEXTURE2DOESPROC image_target_texture_ = nullptr;
+  std::mutex mutex_;
+  int64_t last_texture_id_ = 0;
+  std::unordered_map<int64_t, Texture> textures_;
+  // Let go of without their context current.
+  std::vector<std::unique_ptr<ImportedFrame>> retired_frames_;
+
+  bool ImportFrame(EGLDisplay display,
+                   DmabufFrame& frame,
+                   ImportedFrame& imported) const;
+
+  // Invoked once the last reference to |imported| is gone, on any thread.
+  void RetireImportedFrame(ImportedFrame* imported);
+
+  void CollectRetiredFrames();
+
+  // GL objects are only deleted if |current_context| is true. Otherwise the
+  // context is gone or about to be, and takes them along.
+  static void ReleaseImportedFrame(ImportedFrame& imported,
+                                   bool current_context);
+
+  static void ReleaseFrame(DmabufFrame& frame, int release_fence_fd);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ExternalTextureRegistry);
+};
+
+}  // namespace flutter
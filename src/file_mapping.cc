@@ -0,0 +1,72 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_mapping.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flutter {
+
+FileMapping::FileMapping(const std::string& path, Protection protection) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if (fd == -1) {
+    FLWAY_ERROR << "Could not open " << path << std::endl;
+    return;
+  }
+
+  struct stat stat_buffer = {};
+
+  if (::fstat(fd, &stat_buffer) != 0 || stat_buffer.st_size <= 0) {
+    FLWAY_ERROR << "Could not determine the size of " << path << std::endl;
+    ::close(fd);
+    return;
+  }
+
+  const int prot = protection == Protection::kReadExecute
+                       ? PROT_READ | PROT_EXEC
+                       : PROT_READ;
+  void* mapping =
+      ::mmap(nullptr, stat_buffer.st_size, prot, MAP_SHARED, fd, 0);
+
+  // The mapping keeps its own reference to the file.
+  ::close(fd);
+
+  if (mapping == MAP_FAILED) {
+    FLWAY_ERROR << "Could not map " << path << std::endl;
+    return;
+  }
+
+  mapping_ = static_cast<uint8_t*>(mapping);
+  size_ = stat_buffer.st_size;
+}
+
+FileMapping::~FileMapping() {
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, size_);
+  }
+}
+
+bool FileMapping::IsValid() const {
+  return mapping_ != nullptr;
+}
+
+const uint8_t* FileMapping::GetMapping() const {
+  return mapping_;
+}
+
+size_t FileMapping::GetSize() const {
+  return size_;
+}
+
+void FileMapping::Prefetch() const {
+  if (mapping_ != nullptr) {
+    ::madvise(mapping_, size_, MADV_WILLNEED);
+  }
+}
+
+}  // namespace flutter
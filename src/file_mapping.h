@@ -0,0 +1,47 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A read-only shared mapping of a whole file. The pages are the page cache
+// pages of the file, so every process mapping the same file shares them.
+class FileMapping {
+ public:
+  enum class Protection {
+    kRead,
+    // For snapshot instructions.
+    kReadExecute,
+  };
+
+  FileMapping(const std::string& path, Protection protection);
+
+  ~FileMapping();
+
+  bool IsValid() const;
+
+  const uint8_t* GetMapping() const;
+
+  size_t GetSize() const;
+
+  // Ask the kernel to start reading the whole file in the background so the
+  // first accesses do not fault on disk I/O.
+  void Prefetch() const;
+
+ private:
+  uint8_t* mapping_ = nullptr;
+  size_t size_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FileMapping);
+};
+
+}  // namespace flutter
@@ -4,13 +4,17 @@
 
 #include "flutter_application.h"
 
-#include <EGL/egl.h>
 #include <sys/types.h>
 
-#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <sstream>
 #include <vector>
 
+#include "instrumentation.h"
+#include "time_base.h"
+#include "tracing.h"
 #include "utils.h"
 
 namespace flutter {
@@ -40,10 +44,16 @@ static std::string GetICUDataPath() {
 FlutterApplication::FlutterApplication(
     std::string bundle_path,
     const std::vector<std::string>& command_line_args,
-    RenderDelegate& render_delegate)
-    : render_delegate_(render_delegate) {
-  if (!FlutterAssetBundleIsValid(bundle_path)) {
-    FLWAY_ERROR << "Flutter asset bundle was not valid." << std::endl;
+    RenderDelegate& render_delegate,
+    EventLoop& event_loop)
+    : render_delegate_(render_delegate),
+      platform_task_runner_(event_loop, [this](const FlutterTask& task) {
+        if (FlutterEngineRunTask(engine_, &task) != kSuccess) {
+          FLWAY_ERROR << "Could not run an engine task." << std::endl;
+        }
+      }) {
+  if (!platform_task_runner_.IsValid()) {
+    FLWAY_ERROR << "Could not create the platform task runner." << std::endl;
     return;
   }
 
@@ -58,24 +68,71 @@ FlutterApplication::FlutterApplication(
     return reinterpret_cast<FlutterApplication*>(userdata)
         ->render_delegate_.OnApplicationContextClearCurrent();
   };
-  config.open_gl.present = [](void* userdata) -> bool {
+  config.open_gl.make_resource_current = [](void* userdata) -> bool {
     return reinterpret_cast<FlutterApplication*>(userdata)
-        ->render_delegate_.OnApplicationPresent();
+        ->render_delegate_.OnApplicationResourceContextMakeCurrent();
   };
-  config.open_gl.fbo_callback = [](void* userdata) -> uint32_t {
+  config.open_gl.present_with_info =
+      [](void* userdata, const FlutterPresentInfo* info) -> bool {
     return reinterpret_cast<FlutterApplication*>(userdata)
-        ->render_delegate_.OnApplicationGetOnscreenFBO();
+        ->render_delegate_.OnApplicationPresent(info->frame_damage.damage,
+                                                info->frame_damage.num_rects);
   };
+  config.open_gl.populate_existing_damage =
+      [](void* userdata, intptr_t fbo_id, FlutterDamage* existing_damage)
+      -> void {
+    reinterpret_cast<FlutterApplication*>(userdata)
+        ->render_delegate_.OnApplicationPopulateExistingDamage(
+            existing_damage);
+  };
+  config.open_gl.fbo_with_frame_info_callback =
+      [](void* userdata, const FlutterFrameInfo* info) -> uint32_t {
+    return reinterpret_cast<FlutterApplication*>(userdata)
+        ->render_delegate_.OnApplicationGetOnscreenFBO(info->size.width,
+                                                       info->size.height);
+  };
+  // The engine otherwise keeps rendering into the framebuffer it was given
+  // first.
+  config.open_gl.fbo_reset_after_present =
+      render_delegate_.OnApplicationRotatesFBOs();
   config.open_gl.gl_proc_resolver = [](void* userdata,
                                        const char* name) -> void* {
-    auto address = eglGetProcAddress(name);
-    if (address != nullptr) {
-      return reinterpret_cast<void*>(address);
-    }
-    FLWAY_ERROR << "Tried unsuccessfully to resolve: " << name << std::endl;
-    return nullptr;
+    return reinterpret_cast<FlutterApplication*>(userdata)
+        ->gl_proc_resolver_.Resolve(name);
+  };
+  config.open_gl.gl_external_texture_frame_callback =
+      [](void* userdata, int64_t texture_id, size_t width, size_t height,
+         FlutterOpenGLTexture* texture) -> bool {
+    return reinterpret_cast<FlutterApplication*>(userdata)
+        ->external_textures_.PopulateTexture(texture_id, texture);
   };
 
+  if (render_delegate_.OnApplicationComposesLayers()) {
+    compositor_.struct_size = sizeof(compositor_);
+    compositor_.user_data = this;
+    compositor_.create_backing_store_callback =
+        [](const FlutterBackingStoreConfig* config,
+           FlutterBackingStore* backing_store, void* user_data) -> bool {
+      return reinterpret_cast<FlutterApplication*>(user_data)
+          ->render_delegate_.OnApplicationCreateBackingStore(config,
+                                                             backing_store);
+    };
+    compositor_.collect_backing_store_callback =
+        [](const FlutterBackingStore* backing_store, void* user_data) -> bool {
+      return reinterpret_cast<FlutterApplication*>(user_data)
+          ->render_delegate_.OnApplicationCollectBackingStore(backing_store);
+    };
+    compositor_.present_layers_callback = [](const FlutterLayer** layers,
+                                             size_t layers_count,
+                                             void* user_data) -> bool {
+      return reinterpret_cast<FlutterApplication*>(user_data)
+          ->render_delegate_.OnApplicationPresentLayers(layers, layers_count);
+    };
+    // Each frame needs backing stores of its own for the delegate to rotate
+    // their buffers.
+    compositor_.avoid_backing_store_cache = true;
+  }
+
   auto icu_data_path = GetICUDataPath();
 
   if (icu_data_path == "") {
@@ -85,61 +142,195 @@ FlutterApplication::FlutterApplication(
     return;
   }
 
+  // The engine maps the ICU data itself. Make sure it is in the page cache by
+  // the time it does. Processes on the same device all share those pages.
+  PrefetchFile(icu_data_path);
+
   std::vector<const char*> command_line_args_c;
 
   for (const auto& arg : command_line_args) {
     command_line_args_c.push_back(arg.c_str());
   }
 
-  FlutterProjectArgs args = {
-      .struct_size = sizeof(FlutterProjectArgs),
-      .assets_path = bundle_path.c_str(),
-      .main_path = "",
-      .packages_path = "",
-      .icu_data_path = icu_data_path.c_str(),
-      .command_line_argc = static_cast<int>(command_line_args_c.size()),
-      .command_line_argv = command_line_args_c.data(),
+  FlutterCustomTaskRunners custom_task_runners = {};
+  custom_task_runners.struct_size = sizeof(custom_task_runners);
+  custom_task_runners.platform_task_runner =
+      &platform_task_runner_.GetDescription();
+
+  FlutterProjectArgs args = {};
+  args.struct_size = sizeof(FlutterProjectArgs);
+  args.assets_path = bundle_path.c_str();
+  args.icu_data_path = icu_data_path.c_str();
+  args.command_line_argc = static_cast<int>(command_line_args_c.size());
+  args.command_line_argv = command_line_args_c.data();
+  args.custom_task_runners = &custom_task_runners;
+  if (compositor_.struct_size != 0) {
+    args.compositor = &compositor_;
+  }
+  args.vsync_callback = [](void* userdata, intptr_t baton) -> void {
+    reinterpret_cast<FlutterApplication*>(userdata)->OnVsyncRequested(baton);
+  };
+  args.platform_message_callback = [](const FlutterPlatformMessage* message,
+                                      void* userdata) -> void {
+    reinterpret_cast<FlutterApplication*>(userdata)->OnPlatformMessage(
+        *message);
   };
 
-  FlutterEngine engine = nullptr;
-  auto result = FlutterEngineRun(FLUTTER_ENGINE_VERSION, &config, &args,
-                                 this /* userdata */, &engine_);
+  // Without AOT snapshots, the engine runs the kernel blob in the bundle.
+  if (FlutterEngineRunsAOTCompiledDartCode()) {
+    aot_snapshot_.reset(new AOTSnapshot(bundle_path));
+    if (!aot_snapshot_->IsValid()) {
+      FLWAY_ERROR << "Could not load the AOT snapshots." << std::endl;
+      return;
+    }
+    aot_snapshot_->PopulateProjectArgs(args);
+  } else {
+    PrefetchFile(bundle_path + "/kernel_blob.bin");
+  }
+
+  // Starts the VM and loads the snapshots and ICU data. Nothing in here calls
+  // back into the render delegate, so it can overlap with the display setup.
+  FlutterEngineResult result = kSuccess;
+  {
+    FLWAY_TRACE_SCOPE("FlutterApplication::InitializeEngine");
+    result = FlutterEngineInitialize(FLUTTER_ENGINE_VERSION, &config, &args,
+                                     this /* userdata */, &engine_);
+  }
 
   if (result != kSuccess) {
-    FLWAY_ERROR << "Could not run the Flutter engine" << std::endl;
+    FLWAY_ERROR << "Could not initialize the Flutter engine" << std::endl;
     return;
   }
 
+  RecordStartupMilestone("engine initialized");
   valid_ = true;
 }
 
+bool FlutterApplication::Run() {
+  if (!valid_) {
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("FlutterApplication::Run");
+
+  if (FlutterEngineRunInitialized(engine_) != kSuccess) {
+    FLWAY_ERROR << "Could not run the Flutter engine" << std::endl;
+    return false;
+  }
+
+  RecordStartupMilestone("engine running");
+  return true;
+}
+
 FlutterApplication::~FlutterApplication() {
   if (engine_ == nullptr) {
     return;
   }
 
+  // Handlers may still hold responses the engine can no longer take.
+  platform_channels_.Shutdown();
+
   auto result = FlutterEngineShutdown(engine_);
 
   if (result != kSuccess) {
     FLWAY_ERROR << "Could not shutdown the Flutter engine." << std::endl;
   }
+
+  const auto stats = platform_task_runner_.GetStats();
+  FLWAY_LOG << "Platform tasks run: " << stats.tasks_run
+            << ", max queue depth: " << stats.max_queue_depth
+            << ", mean latency: "
+            << (stats.tasks_run == 0
+                    ? 0
+                    : stats.total_latency_nanos / stats.tasks_run / 1000)
+            << "us, max latency: " << stats.max_latency_nanos / 1000 << "us"
+            << std::endl;
 }
 
 bool FlutterApplication::IsValid() const {
   return valid_;
 }
 
-bool FlutterApplication::SetWindowSize(size_t width, size_t height) {
+// Called by the engine on the UI thread. Vsync waiting is driven by the Wayland
+// connection, which is only ever touched on the platform thread.
+void FlutterApplication::OnVsyncRequested(intptr_t baton) {
+  platform_task_runner_.PostTask([this, baton]() {
+    render_delegate_.OnApplicationRequestVsync(
+        [this, baton](uint64_t frame_start_nanos, uint64_t frame_target_nanos) {
+          RecordTimingEvent(TimingEvent::kUIFrameBegin, frame_start_nanos,
+                            nullptr);
+          if (FlutterEngineOnVsync(engine_, baton, frame_start_nanos,
+                                   frame_target_nanos) != kSuccess) {
+            FLWAY_ERROR << "Could not notify the engine of a vsync."
+                        << std::endl;
+          }
+        });
+  });
+}
+
+bool FlutterApplication::SetWindowSize(size_t width,
+                                       size_t height,
+                                       double pixel_ratio) {
   FlutterWindowMetricsEvent event = {};
   event.struct_size = sizeof(event);
   event.width = width;
   event.height = height;
-  event.pixel_ratio = 1.0;
-  return FlutterEngineSendWindowMetricsEvent(engine_, &event) == kSuccess;
+  event.pixel_ratio = pixel_ratio;
+  if (FlutterEngineSendWindowMetricsEvent(engine_, &event) != kSuccess) {
+    return false;
+  }
+
+  if (resource_cache_frames_ == 0) {
+    return true;
+  }
+
+  // The engine ignores limits that do not fit in an int.
+  const uint64_t wanted_bytes = static_cast<uint64_t>(width) * height * 4 *
+                                resource_cache_frames_;
+  const uint64_t bytes = std::min<uint64_t>(
+      wanted_bytes, std::numeric_limits<int32_t>::max());
+
+  if (bytes == resource_cache_bytes_) {
+    return true;
+  }
+
+  if (bytes < wanted_bytes) {
+    FLWAY_LOG << "Clamping the resource cache limit of " << wanted_bytes
+              << " bytes to " << bytes << std::endl;
+  }
+
+  // The engine keeps a limit set on the skia channel over its own.
+  std::ostringstream stream;
+  stream << "{\"method\":\"Skia.setResourceCacheMaxBytes\",\"args\":"
+         << bytes << "}";
+
+  if (!SendJSONMessage("flutter/skia", stream.str())) {
+    FLWAY_ERROR << "Could not set the resource cache limit." << std::endl;
+    return false;
+  }
+
+  resource_cache_bytes_ = bytes;
+  return true;
 }
 
-void FlutterApplication::ProcessEvents() {
-  __FlutterEngineFlushPendingTasksNow();
+void FlutterApplication::SetResourceCacheFrames(uint32_t frames) {
+  resource_cache_frames_ = frames;
+}
+
+bool FlutterApplication::SetDisplays(
+    const std::vector<FlutterEngineDisplay>& displays) {
+  if (displays_reported_ || displays.empty()) {
+    return true;
+  }
+
+  if (FlutterEngineNotifyDisplayUpdate(
+          engine_, kFlutterEngineDisplaysUpdateTypeStartup, displays.data(),
+          displays.size()) != kSuccess) {
+    return false;
+  }
+
+  displays_reported_ = true;
+  return true;
 }
 
 bool FlutterApplication::SendPointerEvent(int button, int x, int y) {
@@ -167,6 +358,146 @@ bool FlutterApplication::SendPointerEvent(int button, int x, int y) {
   return SendFlutterPointerEvent(phase, x, y);
 }
 
+bool FlutterApplication::SendPointerEvents(const FlutterPointerEvent* events,
+                                           size_t count) {
+  if (!valid_) {
+    FLWAY_ERROR << "Pointer events on an invalid application." << std::endl;
+    return false;
+  }
+
+  return FlutterEngineSendPointerEvent(engine_, events, count) == kSuccess;
+}
+
+bool FlutterApplication::SendKeyEvent(bool pressed,
+                                      uint32_t keysym,
+                                      uint32_t scan_code,
+                                      uint32_t modifiers,
+                                      uint32_t unicode) {
+  if (!valid_) {
+    FLWAY_ERROR << "Key events on an invalid application." << std::endl;
+    return false;
+  }
+
+  std::ostringstream stream;
+  stream << "{\"keymap\":\"linux\",\"toolkit\":\"gtk\",\"type\":\""
+         << (pressed ? "keydown" : "keyup") << "\",\"keyCode\":" << keysym
+         << ",\"scanCode\":" << scan_code << ",\"modifiers\":" << modifiers
+         << ",\"unicodeScalarValues\":" << unicode << "}";
+  return SendJSONMessage("flutter/keyevent", stream.str());
+}
+
+bool FlutterApplication::NotifyMemoryPressure() {
+  if (!valid_) {
+    FLWAY_ERROR << "Memory pressure on an invalid application." << std::endl;
+    return false;
+  }
+
+  return FlutterEngineNotifyLowMemoryWarning(engine_) == kSuccess;
+}
+
+bool FlutterApplication::SendJSONMessage(const char* channel,
+                                         const std::string& json) {
+  return SendPlatformMessage(channel,
+                             reinterpret_cast<const uint8_t*>(json.data()),
+                             json.size());
+}
+
+bool FlutterApplication::SendPlatformMessage(const char* channel,
+                                             const uint8_t* message,
+                                             size_t message_size) {
+  FlutterPlatformMessage platform_message = {};
+  platform_message.struct_size = sizeof(platform_message);
+  platform_message.channel = channel;
+  platform_message.message = message;
+  platform_message.message_size = message_size;
+  return FlutterEngineSendPlatformMessage(engine_, &platform_message) ==
+         kSuccess;
+}
+
+void FlutterApplication::SetMessageHandler(
+    const std::string& channel,
+    PlatformChannels::MessageHandler handler) {
+  platform_channels_.SetMessageHandler(channel, std::move(handler));
+}
+
+// The engine invokes this on the platform thread, which is the only one that
+// touches the handlers.
+void FlutterApplication::OnPlatformMessage(
+    const FlutterPlatformMessage& message) {
+  platform_channels_.DispatchMessage(engine_, message);
+}
+
+static const char* GetLifecycleStateName(
+    FlutterApplication::LifecycleState state) {
+  switch (state) {
+    case FlutterApplication::LifecycleState::kResumed:
+      return "AppLifecycleState.resumed";
+    case FlutterApplication::LifecycleState::kInactive:
+      return "AppLifecycleState.inactive";
+    case FlutterApplication::LifecycleState::kPaused:
+      return "AppLifecycleState.paused";
+  }
+  return "";
+}
+
+// The lifecycle channel uses the string codec, which is plain UTF-8.
+bool FlutterApplication::SetLifecycleState(LifecycleState state) {
+  if (!valid_) {
+    FLWAY_ERROR << "Lifecycle changes on an invalid application." << std::endl;
+    return false;
+  }
+
+  const char* name = GetLifecycleStateName(state);
+  return SendPlatformMessage("flutter/lifecycle",
+                             reinterpret_cast<const uint8_t*>(name),
+                             strlen(name));
+}
+
+int64_t FlutterApplication::RegisterExternalTexture() {
+  if (!valid_) {
+    FLWAY_ERROR << "Textures on an invalid application." << std::endl;
+    return 0;
+  }
+
+  const int64_t texture_id = external_textures_.AddTexture();
+
+  if (FlutterEngineRegisterExternalTexture(engine_, texture_id) != kSuccess) {
+    FLWAY_ERROR << "Could not register external texture " << texture_id
+                << std::endl;
+    external_textures_.RemoveTexture(texture_id);
+    return 0;
+  }
+
+  return texture_id;
+}
+
+bool FlutterApplication::UnregisterExternalTexture(int64_t texture_id) {
+  if (!valid_) {
+    FLWAY_ERROR << "Textures on an invalid application." << std::endl;
+    return false;
+  }
+
+  const bool unregistered =
+      FlutterEngineUnregisterExternalTexture(engine_, texture_id) == kSuccess;
+  external_textures_.RemoveTexture(texture_id);
+  return unregistered;
+}
+
+bool FlutterApplication::PushExternalTextureFrame(int64_t texture_id,
+                                                  DmabufFrame frame) {
+  if (!valid_) {
+    FLWAY_ERROR << "Textures on an invalid application." << std::endl;
+    return false;
+  }
+
+  if (!external_textures_.PushFrame(texture_id, std::move(frame))) {
+    return false;
+  }
+
+  return FlutterEngineMarkExternalTextureFrameAvailable(engine_, texture_id) ==
+         kSuccess;
+}
+
 bool FlutterApplication::SendFlutterPointerEvent(FlutterPointerPhase phase,
                                                  double x,
                                                  double y) {
@@ -175,10 +506,7 @@ bool FlutterApplication::SendFlutterPointerEvent(FlutterPointerPhase phase,
   event.phase = phase;
   event.x = x;
   event.y = y;
-  event.timestamp =
-      std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::high_resolution_clock::now().time_since_epoch())
-          .count();
+  event.timestamp = GetCurrentTimeNanos() / kNanosPerMicro;
   return FlutterEngineSendPointerEvent(engine_, &event, 1) == kSuccess;
 }
 
@@ -7,44 +7,191 @@
 #include <flutter_embedder.h>
 
 #include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "aot_snapshot.h"
+#include "event_loop.h"
+#include "external_texture_registry.h"
+#include "gl_proc_resolver.h"
 #include "macros.h"
+#include "platform_channels.h"
+#include "platform_task_runner.h"
 
 namespace flutter {
 
 class FlutterApplication {
  public:
+  // The states of the framework's AppLifecycleState the embedder reports.
+  enum class LifecycleState {
+    kResumed,
+    kInactive,
+    kPaused,
+  };
+
   class RenderDelegate {
    public:
+    using VsyncCallback =
+        std::function<void(uint64_t frame_start_nanos,
+                            uint64_t frame_target_nanos)>;
+
     virtual bool OnApplicationContextMakeCurrent() = 0;
 
     virtual bool OnApplicationContextClearCurrent() = 0;
 
-    virtual bool OnApplicationPresent() = 0;
-
-    virtual uint32_t OnApplicationGetOnscreenFBO() = 0;
+    // Invoked on the IO thread to make a context that shares with the
+    // onscreen context current for texture uploads.
+    virtual bool OnApplicationResourceContextMakeCurrent() = 0;
+
+    // |damage| is the region of the frame that changed since the previous
+    // present, in surface pixels with the origin at the top left.
+    virtual bool OnApplicationPresent(const FlutterRect* damage,
+                                      size_t damage_count) = 0;
+
+    // Report the region of the buffer about to be rendered into that is stale
+    // with respect to the previous frame. Delegates that cannot tell should
+    // report the whole surface.
+    virtual void OnApplicationPopulateExistingDamage(
+        FlutterDamage* existing_damage) = 0;
+
+    // Invoked on the raster thread at the start of each frame with the size the
+    // engine is about to render at.
+    virtual uint32_t OnApplicationGetOnscreenFBO(size_t frame_width,
+                                                 size_t frame_height) = 0;
+
+    // Invoked on the platform thread when the engine wants to produce a frame.
+    // The callback must be invoked on the platform thread at the start of the
+    // next frame interval.
+    virtual void OnApplicationRequestVsync(VsyncCallback callback) = 0;
+
+    // Whether |OnApplicationGetOnscreenFBO| may return a different
+    // framebuffer for every frame. Queried once, before the delegate is
+    // necessarily ready.
+    virtual bool OnApplicationRotatesFBOs() const { return false; }
+
+    // Whether frames are handed over as layers, through the backing store
+    // and |OnApplicationPresentLayers| calls below, instead of being
+    // flattened into the onscreen framebuffer. Queried once, like
+    // |OnApplicationRotatesFBOs|.
+    virtual bool OnApplicationComposesLayers() const { return false; }
+
+    // Invoked on the raster thread with the onscreen context current for each
+    // layer of a frame before the engine renders into it.
+    virtual bool OnApplicationCreateBackingStore(
+        const FlutterBackingStoreConfig* config,
+        FlutterBackingStore* backing_store) {
+      return false;
+    }
+
+    virtual bool OnApplicationCollectBackingStore(
+        const FlutterBackingStore* backing_store) {
+      return false;
+    }
+
+    // |layers| are in bottom to top order, with offsets in surface pixels.
+    virtual bool OnApplicationPresentLayers(const FlutterLayer** layers,
+                                            size_t layers_count) {
+      return false;
+    }
   };
 
+  // Initializes the engine without running it. Must be called on the event
+  // loop thread. The render delegate is not used until |Run|, so it may still
+  // be setting up on another thread. |bundle_path| must already be known to be
+  // valid.
   FlutterApplication(std::string bundle_path,
                      const std::vector<std::string>& args,
-                     RenderDelegate& render_delegate);
+                     RenderDelegate& render_delegate,
+                     EventLoop& event_loop);
 
   ~FlutterApplication();
 
   bool IsValid() const;
 
-  void ProcessEvents();
+  // Launches the root isolate and creates the onscreen surface. The render
+  // delegate must be ready.
+  bool Run();
+
+  // |width| and |height| are in physical pixels.
+  bool SetWindowSize(size_t width, size_t height, double pixel_ratio);
 
-  bool SetWindowSize(size_t width, size_t height);
+  // Limits the engine's GPU resource cache to |frames| RGBA frames of the
+  // window's size, updated along with it. Zero leaves the limit to the engine.
+  // Takes effect with the next |SetWindowSize|.
+  void SetResourceCacheFrames(uint32_t frames);
+
+  // Describe the outputs to the engine. The first display paces the frame
+  // scheduler. The embedder API only has an update type for the displays
+  // present at startup, so only the first non-empty list is reported and
+  // later calls do nothing. Refresh rate changes still reach the engine
+  // through the vsync target times, and scale changes through the window
+  // metrics.
+  bool SetDisplays(const std::vector<FlutterEngineDisplay>& displays);
 
   bool SendPointerEvent(int button, int x, int y);
 
+  // Send a batch of pointer events with physical coordinates in one call.
+  bool SendPointerEvents(const FlutterPointerEvent* events, size_t count);
+
+  // Sends a raw key event in the format of the GTK embedder, which uses X11
+  // keysyms and hardware keycodes just like XKB.
+  bool SendKeyEvent(bool pressed,
+                    uint32_t keysym,
+                    uint32_t scan_code,
+                    uint32_t modifiers,
+                    uint32_t unicode);
+
+  // Handles the messages the app sends on |channel|. See |PlatformChannels|.
+  // Must be called on the platform thread.
+  void SetMessageHandler(const std::string& channel,
+                         PlatformChannels::MessageHandler handler);
+
+  // Sends |message| to the handler the app set for |channel|, without
+  // expecting a reply. May be called from any thread after |Run|.
+  bool SendPlatformMessage(const char* channel,
+                           const uint8_t* message,
+                           size_t message_size);
+
+  // Tells the framework over the lifecycle channel. Apps stop animating and
+  // scheduling frames while paused.
+  bool SetLifecycleState(LifecycleState state);
+
+  // Has the engine purge the GPU resources of the rasterizer and tell the
+  // framework to drop what it can, such as decoded images.
+  bool NotifyMemoryPressure();
+
+  // Registers a texture fed with dmabuf frames. Returns the identifier for
+  // the framework's Texture widget, or zero on failure. May be called from any
+  // thread after |Run|.
+  int64_t RegisterExternalTexture();
+
+  bool UnregisterExternalTexture(int64_t texture_id);
+
+  // Hands |frame| to the engine and schedules a frame to draw it. See
+  // |DmabufFrame| for who owns what. May be called from any thread.
+  bool PushExternalTextureFrame(int64_t texture_id, DmabufFrame frame);
+
  private:
-  bool valid_;
+  bool valid_ = false;
   RenderDelegate& render_delegate_;
+  PlatformTaskRunner platform_task_runner_;
+  GLProcResolver gl_proc_resolver_;
+  std::unique_ptr<AOTSnapshot> aot_snapshot_;
+  ExternalTextureRegistry external_textures_;
+  PlatformChannels platform_channels_;
+  FlutterCompositor compositor_ = {};
   FlutterEngine engine_ = nullptr;
   int last_button_ = 0;
+  bool displays_reported_ = false;
+  uint32_t resource_cache_frames_ = 0;
+  uint64_t resource_cache_bytes_ = 0;
+
+  void OnVsyncRequested(intptr_t baton);
+
+  void OnPlatformMessage(const FlutterPlatformMessage& message);
+
+  bool SendJSONMessage(const char* channel, const std::string& json);
 
   bool SendFlutterPointerEvent(FlutterPointerPhase phase, double x, double y);
 
@@ -0,0 +1,92 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gl_proc_resolver.h"
+
+#include <EGL/egl.h>
+#include <dlfcn.h>
+#include <string.h>
+
+namespace flutter {
+
+static const char* kGLESLibraryNames[] = {
+    "libGLESv2.so.2",
+    "libGLESv2.so",
+};
+
+// Vendor suffixes of GL and EGL extension entry points.
+static const char* kExtensionSuffixes[] = {
+    "EXT", "OES", "KHR", "ARB", "NV", "ANGLE", "APPLE", "ARM",
+    "IMG", "INTEL", "MESA", "QCOM", "AMD", "NVX", "EXTX",
+};
+
+// The cache is keyed by name, so a table sized for everything the engine
+// resolves avoids rehashing during startup.
+static const size_t kExpectedSymbolCount = 512;
+
+static bool IsExtensionSymbol(const char* name) {
+  const size_t length = ::strlen(name);
+  for (const char* suffix : kExtensionSuffixes) {
+    const size_t suffix_length = ::strlen(suffix);
+    if (length > suffix_length &&
+        ::strcmp(name + length - suffix_length, suffix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+GLProcResolver::GLProcResolver() {
+  for (const char* library_name : kGLESLibraryNames) {
+    gles_library_ = ::dlopen(library_name, RTLD_NOW | RTLD_LOCAL);
+    if (gles_library_ != nullptr) {
+      break;
+    }
+  }
+
+  if (gles_library_ == nullptr) {
+    FLWAY_ERROR << "Could not open libGLESv2. All GL symbols will be resolved "
+                   "through eglGetProcAddress."
+                << std::endl;
+  }
+
+  cache_.reserve(kExpectedSymbolCount);
+}
+
+GLProcResolver::~GLProcResolver() {
+  if (gles_library_ != nullptr) {
+    ::dlclose(gles_library_);
+  }
+}
+
+void* GLProcResolver::Resolve(const char* name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto found = cache_.find(name);
+  if (found != cache_.end()) {
+    return found->second;
+  }
+
+  void* address = Lookup(name);
+  cache_[name] = address;
+
+  if (address == nullptr) {
+    FLWAY_ERROR << "Tried unsuccessfully to resolve: " << name << std::endl;
+  }
+
+  return address;
+}
+
+void* GLProcResolver::Lookup(const char* name) const {
+  if (gles_library_ != nullptr && !IsExtensionSymbol(name)) {
+    void* address = ::dlsym(gles_library_, name);
+    if (address != nullptr) {
+      return address;
+    }
+  }
+
+  return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+}  // namespace flutter
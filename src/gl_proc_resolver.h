@@ -0,0 +1,39 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Resolves GL entry points for the engine. Core GLES symbols are looked up in
+// libGLESv2 directly since some drivers are slow to answer eglGetProcAddress,
+// or return stubs for names they do not implement. Extension symbols, and core
+// symbols the library does not export, go through eglGetProcAddress. Every
+// result is cached, including misses, so each name hits the driver at most
+// once and each miss is logged once. Safe to call from any thread.
+class GLProcResolver {
+ public:
+  GLProcResolver();
+
+  ~GLProcResolver();
+
+  void* Resolve(const char* name);
+
+ private:
+  void* gles_library_ = nullptr;
+  std::mutex mutex_;
+  std::unordered_map<std::string, void*> cache_;
+
+  void* Lookup(const char* name) const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(GLProcResolver);
+};
+
+}  // namespace flutter
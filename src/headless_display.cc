@@ -0,0 +1,452 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "headless_display.h"
+
+#include <EGL/eglext.h>
+
+#include <cmath>
+
+#include "egl_utils.h"
+#include "time_base.h"
+#include "tracing.h"
+
+namespace flutter {
+
+// Frame target times in unthrottled mode assume a display of this rate.
+static const double kUnthrottledNominalRefreshRate = 60.0;
+
+HeadlessDisplay::HeadlessDisplay(EventLoop& event_loop,
+                                 size_t width,
+                                 size_t height,
+                                 const EmbedderOptions& options)
+    : event_loop_(event_loop),
+      options_(options),
+      width_(width),
+      height_(height),
+      frames_presented_(0) {}
+
+HeadlessDisplay::~HeadlessDisplay() {
+  frame_stats_reporter_.reset();
+  vsync_timer_.reset();
+
+  FLWAY_LOG << "Headless frames presented: " << GetFramesPresented()
+            << std::endl;
+
+  // Framebuffer objects are released along with the context.
+  if (resource_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, resource_context_);
+    resource_context_ = EGL_NO_CONTEXT;
+  }
+
+  if (egl_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, egl_context_);
+    egl_context_ = EGL_NO_CONTEXT;
+  }
+
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(egl_display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+
+  if (egl_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(egl_display_, egl_surface_);
+    egl_surface_ = EGL_NO_SURFACE;
+  }
+
+  if (egl_display_ != EGL_NO_DISPLAY) {
+    eglTerminate(egl_display_);
+    egl_display_ = EGL_NO_DISPLAY;
+  }
+}
+
+bool HeadlessDisplay::Connect() {
+  FLWAY_TRACE_SCOPE("HeadlessDisplay::Connect");
+
+  const bool ready = width_ > 0 && height_ > 0 && SetupEGL();
+
+  if (ready) {
+    RecordStartupMilestone("egl ready");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(egl_setup_mutex_);
+    egl_setup_done_ = true;
+    egl_ready_ = ready;
+  }
+  egl_setup_cv_.notify_all();
+
+  return ready;
+}
+
+bool HeadlessDisplay::WaitForEGLSetup() {
+  std::unique_lock<std::mutex> lock(egl_setup_mutex_);
+  egl_setup_cv_.wait(lock, [this]() { return egl_setup_done_; });
+  return egl_ready_;
+}
+
+bool HeadlessDisplay::SetupEGL() {
+  // The surfaceless platform needs neither a display server nor a display
+  // controller, which is what build machines have.
+  if (HasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    auto get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display) {
+      egl_display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                          EGL_DEFAULT_DISPLAY, nullptr);
+    }
+  }
+
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    egl_display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not access an EGL display." << std::endl;
+    return false;
+  }
+
+  if (eglInitialize(egl_display_, nullptr, nullptr) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not initialize EGL display." << std::endl;
+    return false;
+  }
+
+  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not bind the ES API." << std::endl;
+    return false;
+  }
+
+  const bool surfaceless =
+      HasEGLExtension(egl_display_, "EGL_KHR_surfaceless_context");
+
+  EGLConfig config = nullptr;
+
+  {
+    const EGLint attribs[] = {
+        // clang-format off
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+      EGL_SURFACE_TYPE,    surfaceless ? 0 : EGL_PBUFFER_BIT,
+      EGL_RED_SIZE,        8,
+      EGL_GREEN_SIZE,      8,
+      EGL_BLUE_SIZE,       8,
+      EGL_ALPHA_SIZE,      8,
+      EGL_NONE,            // termination sentinel
+        // clang-format on
+    };
+
+    EGLint config_count = 0;
+
+    if (eglChooseConfig(egl_display_, attribs, &config, 1, &config_count) !=
+            EGL_TRUE ||
+        config_count == 0 || config == nullptr) {
+      LogLastEGLError();
+      FLWAY_ERROR << "No matching configs." << std::endl;
+      return false;
+    }
+  }
+
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+
+  egl_context_ =
+      eglCreateContext(egl_display_, config, EGL_NO_CONTEXT, context_attribs);
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not create the onscreen context." << std::endl;
+    return false;
+  }
+
+  resource_context_ =
+      eglCreateContext(egl_display_, config, egl_context_, context_attribs);
+  if (resource_context_ == EGL_NO_CONTEXT) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not create the resource context." << std::endl;
+    return false;
+  }
+
+  if (!surfaceless) {
+    const EGLint attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    egl_surface_ = eglCreatePbufferSurface(egl_display_, config, attribs);
+    resource_surface_ = eglCreatePbufferSurface(egl_display_, config, attribs);
+    if (egl_surface_ == EGL_NO_SURFACE || resource_surface_ == EGL_NO_SURFACE) {
+      LogLastEGLError();
+      FLWAY_ERROR << "Could not create the pbuffer surfaces." << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool HeadlessDisplay::AttachToEventLoop() {
+  if (!WaitForEGLSetup()) {
+    return false;
+  }
+
+  if (options_.headless_refresh_rate > 0.0) {
+    vsync_period_nanos_ =
+        std::llround(kNanosPerSecond / options_.headless_refresh_rate);
+  }
+
+  vsync_timer_.reset(new Timer(event_loop_, [this]() { OnVsyncTimer(); }));
+  if (!vsync_timer_->IsValid()) {
+    FLWAY_ERROR << "Could not create the vsync timer." << std::endl;
+    return false;
+  }
+
+  if (options_.stats_interval_seconds > 0) {
+    const uint64_t period =
+        vsync_period_nanos_ != 0
+            ? vsync_period_nanos_
+            : std::llround(kNanosPerSecond / kUnthrottledNominalRefreshRate);
+    frame_stats_reporter_.reset(new FrameStatsReporter(
+        event_loop_, options_.stats_interval_seconds * kNanosPerSecond,
+        [period]() { return period; }));
+  }
+
+  valid_ = true;
+  return true;
+}
+
+bool HeadlessDisplay::IsValid() const {
+  return valid_;
+}
+
+bool HeadlessDisplay::SetApplication(FlutterApplication* application) {
+  application_ = application;
+
+  if (!application_) {
+    return true;
+  }
+
+  FlutterEngineDisplay display = {};
+  display.struct_size = sizeof(display);
+  display.single_display = true;
+  display.refresh_rate = options_.headless_refresh_rate > 0.0
+                             ? options_.headless_refresh_rate
+                             : kUnthrottledNominalRefreshRate;
+  display.width = width_;
+  display.height = height_;
+  display.device_pixel_ratio = 1.0;
+
+  if (!application_->SetDisplays({display})) {
+    FLWAY_ERROR << "Could not describe the display to the engine."
+                << std::endl;
+  }
+
+  return application_->SetWindowSize(width_, height_, 1.0);
+}
+
+size_t HeadlessDisplay::GetFramesPresented() const {
+  return frames_presented_.load();
+}
+
+// Color is a texture as renderbuffers of eight bits per channel are an
+// extension in ES 2.0. Skia needs a stencil buffer for path rendering.
+bool HeadlessDisplay::UpdateFramebuffer(int width, int height) {
+  if (framebuffer_ != 0 && width == framebuffer_width_ &&
+      height == framebuffer_height_) {
+    return true;
+  }
+
+  FLWAY_TRACE_SCOPE("HeadlessDisplay::UpdateFramebuffer");
+
+  if (framebuffer_ == 0) {
+    glGenFramebuffers(1, &framebuffer_);
+    glGenTextures(1, &color_texture_);
+    glGenRenderbuffers(1, &stencil_renderbuffer_);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, color_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, nullptr);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindRenderbuffer(GL_RENDERBUFFER, stencil_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_STENCIL_INDEX8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color_texture_, 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, stencil_renderbuffer_);
+
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    FLWAY_ERROR << "Offscreen framebuffer is incomplete: " << status
+                << std::endl;
+    return false;
+  }
+
+  framebuffer_width_ = width;
+  framebuffer_height_ = height;
+  return true;
+}
+
+// Hands out vsyncs on a fixed grid anchored at the first request, or right
+// away when unthrottled.
+void HeadlessDisplay::OnVsyncTimer() {
+  if (!pending_vsync_) {
+    return;
+  }
+
+  auto callback = std::move(pending_vsync_);
+  pending_vsync_ = nullptr;
+
+  const uint64_t period =
+      vsync_period_nanos_ != 0
+          ? vsync_period_nanos_
+          : std::llround(kNanosPerSecond / kUnthrottledNominalRefreshRate);
+  const uint64_t frame_start =
+      vsync_period_nanos_ != 0 ? next_vsync_nanos_ : GetCurrentTimeNanos();
+
+  RecordTimingEvent(TimingEvent::kVsyncReceived, frame_start, this);
+  callback(frame_start, frame_start + period);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationContextMakeCurrent() {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("HeadlessDisplay::MakeCurrent");
+
+  if (eglMakeCurrent(egl_display_, egl_surface_, egl_surface_, egl_context_) !=
+      EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not make the onscreen context current" << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationContextClearCurrent() {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  if (eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                     EGL_NO_CONTEXT) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not clear the context." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationResourceContextMakeCurrent() {
+  if (!WaitForEGLSetup()) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  if (eglMakeCurrent(egl_display_, resource_surface_, resource_surface_,
+                     resource_context_) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not make the resource context current."
+                << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool HeadlessDisplay::OnApplicationPresent(const FlutterRect* damage,
+                                           size_t damage_count) {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("HeadlessDisplay::Present");
+  RecordTimingEvent(TimingEvent::kPresentBegin, this);
+
+  if (!first_frame_presented_) {
+    first_frame_presented_ = true;
+    RecordStartupMilestone("first frame");
+    ReportStartupMilestones();
+  }
+
+  // There is no compositor to hand the frame to. Waiting for the GPU instead
+  // makes the present time the time it took to render the frame.
+  glFinish();
+
+  frames_presented_++;
+  RecordTimingEvent(TimingEvent::kPresentEnd, this);
+  return true;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+void HeadlessDisplay::OnApplicationPopulateExistingDamage(
+    FlutterDamage* existing_damage) {
+  // The single framebuffer always holds the previous frame, so the engine
+  // only has to repaint what changed since.
+  existing_damage_ = {};
+  existing_damage->num_rects = 1;
+  existing_damage->damage = &existing_damage_;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+uint32_t HeadlessDisplay::OnApplicationGetOnscreenFBO(size_t frame_width,
+                                                      size_t frame_height) {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return 0;
+  }
+
+  const int width = frame_width != 0 ? frame_width : width_;
+  const int height = frame_height != 0 ? frame_height : height_;
+
+  if (!UpdateFramebuffer(width, height)) {
+    return 0;
+  }
+
+  return framebuffer_;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+void HeadlessDisplay::OnApplicationRequestVsync(VsyncCallback callback) {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return;
+  }
+
+  pending_vsync_ = std::move(callback);
+
+  const uint64_t now = GetCurrentTimeNanos();
+
+  if (vsync_period_nanos_ == 0) {
+    vsync_timer_->ArmAt(now);
+    return;
+  }
+
+  if (vsync_phase_nanos_ == 0) {
+    vsync_phase_nanos_ = now;
+  }
+
+  // The first vsync on the grid that is still ahead of us.
+  const uint64_t elapsed_periods =
+      (now - vsync_phase_nanos_) / vsync_period_nanos_ + 1;
+  next_vsync_nanos_ =
+      vsync_phase_nanos_ + elapsed_periods * vsync_period_nanos_;
+  vsync_timer_->ArmAt(next_vsync_nanos_);
+}
+
+}  // namespace flutter
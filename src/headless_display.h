@@ -0,0 +1,121 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include "embedder_options.h"
+#include "event_loop.h"
+#include "flutter_application.h"
+#include "instrumentation.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Renders into an offscreen framebuffer without a compositor, for
+// benchmarking raster throughput on machines without a display. Frames are
+// paced by a virtual vsync at a fixed rate, or handed out as fast as the
+// engine asks for them. Each present waits for the GPU to finish so frame
+// times reflect the actual rendering work.
+class HeadlessDisplay : public FlutterApplication::RenderDelegate {
+ public:
+  HeadlessDisplay(EventLoop& event_loop,
+                  size_t width,
+                  size_t height,
+                  const EmbedderOptions& options);
+
+  ~HeadlessDisplay();
+
+  // Sets up EGL on a surfaceless display if the platform supports one, on the
+  // default display otherwise. May run on another thread while the engine
+  // starts up.
+  bool Connect();
+
+  // Called on the event loop thread after |Connect|.
+  bool AttachToEventLoop();
+
+  bool IsValid() const;
+
+  bool SetApplication(FlutterApplication* application);
+
+  size_t GetFramesPresented() const;
+
+ private:
+  EventLoop& event_loop_;
+  const EmbedderOptions options_;
+  const int width_;
+  const int height_;
+  bool valid_ = false;
+  FlutterApplication* application_ = nullptr;
+  std::mutex egl_setup_mutex_;
+  std::condition_variable egl_setup_cv_;
+  bool egl_setup_done_ = false;
+  bool egl_ready_ = false;
+  EGLDisplay egl_display_ = EGL_NO_DISPLAY;
+  EGLContext egl_context_ = EGL_NO_CONTEXT;
+  EGLContext resource_context_ = EGL_NO_CONTEXT;
+  // Tiny pbuffers the contexts are bound to when the driver cannot make them
+  // current without a surface.
+  EGLSurface egl_surface_ = EGL_NO_SURFACE;
+  EGLSurface resource_surface_ = EGL_NO_SURFACE;
+  // The render target. Only accessed on the raster thread.
+  GLuint framebuffer_ = 0;
+  GLuint color_texture_ = 0;
+  GLuint stencil_renderbuffer_ = 0;
+  int framebuffer_width_ = 0;
+  int framebuffer_height_ = 0;
+  FlutterRect existing_damage_ = {};
+  bool first_frame_presented_ = false;
+  std::atomic<size_t> frames_presented_;
+  // Virtual vsync. Only accessed on the event loop thread.
+  uint64_t vsync_period_nanos_ = 0;
+  uint64_t vsync_phase_nanos_ = 0;
+  uint64_t next_vsync_nanos_ = 0;
+  std::unique_ptr<Timer> vsync_timer_;
+  VsyncCallback pending_vsync_;
+  std::unique_ptr<FrameStatsReporter> frame_stats_reporter_;
+
+  bool SetupEGL();
+
+  bool WaitForEGLSetup();
+
+  bool UpdateFramebuffer(int width, int height);
+
+  void OnVsyncTimer();
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationContextMakeCurrent() override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationContextClearCurrent() override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationResourceContextMakeCurrent() override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresent(const FlutterRect* damage,
+                            size_t damage_count) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationPopulateExistingDamage(
+      FlutterDamage* existing_damage) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  uint32_t OnApplicationGetOnscreenFBO(size_t frame_width,
+                                       size_t frame_height) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationRequestVsync(VsyncCallback callback) override;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(HeadlessDisplay);
+};
+
+}  // namespace flutter
@@ -0,0 +1,359 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "instrumentation.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace flutter {
+
+struct TimingRecord {
+  uint64_t time_nanos = 0;
+  const void* window = nullptr;
+  TimingEvent event = TimingEvent::kVsyncReceived;
+};
+
+// Single producer, single consumer. The owning thread advances |head| and the
+// reporter advances |tail|.
+class TimingRing {
+ public:
+  static const size_t kCapacity = 1024;
+
+  void Push(TimingEvent event, uint64_t time_nanos, const void* window) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= kCapacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    TimingRecord& record = records_[head % kCapacity];
+    record.time_nanos = time_nanos;
+    record.window = window;
+    record.event = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  template <class Callback>
+  void Drain(Callback callback) {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    for (; tail < head; tail++) {
+      callback(records_[tail % kCapacity]);
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  size_t TakeDropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::array<TimingRecord, kCapacity> records_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<size_t> dropped_{0};
+};
+
+// Rings are only ever added. They outlive the threads that write to them so
+// the reader never races with a thread exiting.
+static std::mutex g_rings_mutex;
+static std::vector<std::unique_ptr<TimingRing>> g_rings;
+static std::atomic_bool g_timing_enabled(false);
+
+static TimingRing* GetThreadRing() {
+  thread_local TimingRing* ring = nullptr;
+
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    g_rings.emplace_back(new TimingRing());
+    ring = g_rings.back().get();
+  }
+
+  return ring;
+}
+
+// Enough for several seconds of frames at high refresh rates.
+static const size_t kMaxSamples = 1000;
+
+// Longer gaps between presents mean the app went idle, not that it missed
+// frames.
+static const uint64_t kIdleIntervalPeriods = 8;
+
+void SetTimingEventsEnabled(bool enabled) {
+  g_timing_enabled = enabled;
+}
+
+void RecordTimingEvent(TimingEvent event,
+                       uint64_t time_nanos,
+                       const void* window) {
+  if (!g_timing_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  GetThreadRing()->Push(event, time_nanos, window);
+}
+
+void RecordTimingEvent(TimingEvent event, const void* window) {
+  if (!g_timing_enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  GetThreadRing()->Push(event, GetCurrentTimeNanos(), window);
+}
+
+static double NanosToMillis(uint64_t nanos) {
+  return nanos / static_cast<double>(kNanosPerMilli);
+}
+
+struct StartupMilestone {
+  const char* name = nullptr;
+  uint64_t time_nanos = 0;
+};
+
+static std::mutex g_startup_mutex;
+static std::vector<StartupMilestone> g_startup_milestones;
+static bool g_startup_reported = false;
+
+void RecordStartupMilestone(const char* name) {
+  const uint64_t now = GetCurrentTimeNanos();
+  std::lock_guard<std::mutex> lock(g_startup_mutex);
+  if (!g_startup_reported) {
+    g_startup_milestones.push_back({name, now});
+  }
+}
+
+// The start time in /proc/self/stat is in clock ticks since boot, so it only
+// has a resolution of about 10ms. Zero if it cannot be read.
+static uint64_t GetProcessStartTimeNanos() {
+  std::ifstream stream("/proc/self/stat");
+  std::string stat((std::istreambuf_iterator<char>(stream)),
+                   std::istreambuf_iterator<char>());
+
+  // The command name may contain spaces. The fields after it are counted
+  // from the state, which is the third field. The start time is the 22nd.
+  const size_t command_end = stat.rfind(')');
+  if (command_end == std::string::npos) {
+    return 0;
+  }
+
+  std::istringstream fields(stat.substr(command_end + 1));
+  std::string field;
+  for (int i = 3; i < 22; i++) {
+    if (!(fields >> field)) {
+      return 0;
+    }
+  }
+
+  uint64_t start_ticks = 0;
+  const long ticks_per_second = ::sysconf(_SC_CLK_TCK);
+  if (!(fields >> start_ticks) || ticks_per_second <= 0) {
+    return 0;
+  }
+
+  return ClockTimeToTimeBase(CLOCK_BOOTTIME,
+                             start_ticks * kNanosPerSecond / ticks_per_second);
+}
+
+void ReportStartupMilestones() {
+  std::lock_guard<std::mutex> lock(g_startup_mutex);
+  if (g_startup_reported || g_startup_milestones.empty()) {
+    return;
+  }
+  g_startup_reported = true;
+
+  uint64_t origin = GetProcessStartTimeNanos();
+  const char* origin_name = "process start";
+  if (origin == 0 || origin > g_startup_milestones.front().time_nanos) {
+    origin = g_startup_milestones.front().time_nanos;
+    origin_name = g_startup_milestones.front().name;
+  }
+
+  std::stringstream report;
+  for (const auto& milestone : g_startup_milestones) {
+    report << ", " << milestone.name << ": "
+           << NanosToMillis(milestone.time_nanos - origin) << "ms";
+  }
+
+  FLWAY_LOG << "Startup timeline since " << origin_name << report.str()
+            << std::endl;
+}
+
+void FrameStatsReporter::Samples::Add(uint64_t sample) {
+  samples_.push_back(sample);
+  if (samples_.size() > kMaxSamples) {
+    samples_.pop_front();
+  }
+}
+
+uint64_t FrameStatsReporter::Samples::GetPercentile(double percentile) const {
+  if (samples_.empty()) {
+    return 0;
+  }
+
+  std::vector<uint64_t> sorted(samples_.begin(), samples_.end());
+  const size_t index = std::min(
+      sorted.size() - 1, static_cast<size_t>(percentile * sorted.size()));
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+  return sorted[index];
+}
+
+size_t FrameStatsReporter::Samples::GetCount() const {
+  return samples_.size();
+}
+
+FrameStatsReporter::FrameStatsReporter(EventLoop& loop,
+                                       uint64_t interval_nanos,
+                                       RefreshPeriodCallback refresh_period)
+    : timer_(loop, [this]() { OnTimer(); }),
+      refresh_period_(std::move(refresh_period)) {
+  if (!timer_.IsValid() || !timer_.ArmRepeating(interval_nanos)) {
+    FLWAY_ERROR << "Could not start the frame stats timer." << std::endl;
+    return;
+  }
+
+  SetTimingEventsEnabled(true);
+  valid_ = true;
+}
+
+FrameStatsReporter::~FrameStatsReporter() {
+  SetTimingEventsEnabled(false);
+}
+
+bool FrameStatsReporter::IsValid() const {
+  return valid_;
+}
+
+void FrameStatsReporter::OnTimer() {
+  std::vector<TimingRecord> records;
+
+  {
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    for (const auto& ring : g_rings) {
+      ring->Drain([&records](const TimingRecord& record) {
+        records.push_back(record);
+      });
+      dropped_events_ += ring->TakeDropped();
+    }
+  }
+
+  // Merge the per thread streams into a single timeline.
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TimingRecord& a, const TimingRecord& b) {
+                     return a.time_nanos < b.time_nanos;
+                   });
+
+  const uint64_t period = refresh_period_();
+
+  for (const auto& record : records) {
+    // Events of no window in particular do not feed any statistics.
+    if (!record.window) {
+      continue;
+    }
+
+    auto found = windows_.find(record.window);
+    if (found == windows_.end()) {
+      const size_t index = windows_.size() + 1;
+      found = windows_.emplace(record.window, WindowStats()).first;
+      found->second.index = index;
+    }
+
+    Process(found->second, record.event, record.time_nanos, period);
+  }
+
+  Dump();
+}
+
+void FrameStatsReporter::Process(WindowStats& stats,
+                                 TimingEvent event,
+                                 uint64_t time_nanos,
+                                 uint64_t period) {
+  switch (event) {
+    case TimingEvent::kVsyncReceived:
+    case TimingEvent::kUIFrameBegin:
+    case TimingEvent::kSwapComplete:
+      return;
+    case TimingEvent::kPresentBegin:
+      stats.present_begin = time_nanos;
+      return;
+    case TimingEvent::kPresentEnd:
+      stats.frames++;
+
+      if (stats.present_begin != 0 && stats.present_begin <= time_nanos) {
+        stats.present_durations.Add(time_nanos - stats.present_begin);
+      }
+
+      if (stats.last_present_end != 0) {
+        const uint64_t interval = time_nanos - stats.last_present_end;
+        if (period != 0 && interval < kIdleIntervalPeriods * period) {
+          stats.frame_intervals.Add(interval);
+          // Allow for jitter of half a period before calling a frame missed.
+          const uint64_t periods = (interval + period / 2) / period;
+          if (periods > 1) {
+            stats.missed_frames += periods - 1;
+          }
+        }
+      }
+
+      if (stats.pending_input != 0 && stats.pending_input <= time_nanos) {
+        stats.input_latencies.Add(time_nanos - stats.pending_input);
+      }
+
+      stats.last_present_end = time_nanos;
+      stats.unpresented_present_end = time_nanos;
+      stats.pending_input = 0;
+      return;
+    case TimingEvent::kPresented:
+      if (stats.unpresented_present_end != 0 &&
+          stats.unpresented_present_end <= time_nanos) {
+        stats.display_latencies.Add(time_nanos -
+                                    stats.unpresented_present_end);
+      }
+      stats.unpresented_present_end = 0;
+      return;
+    case TimingEvent::kInputReceived:
+      if (stats.pending_input == 0) {
+        stats.pending_input = time_nanos;
+      }
+      return;
+  }
+}
+
+// One line per window, in the order the windows were first seen.
+void FrameStatsReporter::Dump() const {
+  std::vector<const WindowStats*> windows(windows_.size());
+  for (const auto& window : windows_) {
+    windows[window.second.index - 1] = &window.second;
+  }
+
+  for (const WindowStats* stats : windows) {
+    FLWAY_LOG
+        << "Window " << stats->index << " frames: " << stats->frames
+        << ", missed: " << stats->missed_frames << ", frame time p50/p99: "
+        << NanosToMillis(stats->frame_intervals.GetPercentile(0.5)) << "/"
+        << NanosToMillis(stats->frame_intervals.GetPercentile(0.99))
+        << "ms, present p50/p99: "
+        << NanosToMillis(stats->present_durations.GetPercentile(0.5)) << "/"
+        << NanosToMillis(stats->present_durations.GetPercentile(0.99))
+        << "ms, input to present p50/p99: "
+        << NanosToMillis(stats->input_latencies.GetPercentile(0.5)) << "/"
+        << NanosToMillis(stats->input_latencies.GetPercentile(0.99))
+        << "ms, present to display p50/p99: "
+        << NanosToMillis(stats->display_latencies.GetPercentile(0.5)) << "/"
+        << NanosToMillis(stats->display_latencies.GetPercentile(0.99)) << "ms"
+        << std::endl;
+  }
+
+  FLWAY_LOG << "Dropped timing events: " << dropped_events_ << std::endl;
+}
+
+}  // namespace flutter
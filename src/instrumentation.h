@@ -0,0 +1,125 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+#include "event_loop.h"
+#include "macros.h"
+#include "time_base.h"
+
+namespace flutter {
+
+// Points in the life of a frame. Recorded from whichever thread observes them.
+enum class TimingEvent : uint8_t {
+  // The compositor is ready for a new frame.
+  kVsyncReceived,
+  // The engine was handed a vsync and starts building a frame on the UI
+  // thread.
+  kUIFrameBegin,
+  // On the raster thread around the buffer swap.
+  kPresentBegin,
+  kPresentEnd,
+  // The compositor picked up the committed buffer.
+  kSwapComplete,
+  // The compositor reported the frame on screen through wp_presentation.
+  kPresented,
+  // A batch of input was delivered. The time is when the compositor generated
+  // its first event.
+  kInputReceived,
+};
+
+// Recording is off until enabled. Once on, each thread writes into a fixed
+// size ring buffer of its own without taking locks. When a ring is full, new
+// events are dropped until the reader catches up.
+void SetTimingEventsEnabled(bool enabled);
+
+// |window| identifies the window the event belongs to, such as its surface,
+// or is null for events of no window in particular.
+void RecordTimingEvent(TimingEvent event,
+                       uint64_t time_nanos,
+                       const void* window);
+
+// Records |event| at the current time. The clock is only read while recording
+// is enabled.
+void RecordTimingEvent(TimingEvent event, const void* window);
+
+// Marks a point on the way from process start to the first frame. May be
+// called from any thread. Milestones after the report are ignored.
+void RecordStartupMilestone(const char* name);
+
+// Logs every milestone so far as the time since the process started.
+void ReportStartupMilestones();
+
+// Periodically drains the rings of all threads on the event loop thread and
+// logs rolling statistics over the most recent frames of each window:
+// - the interval between presents.
+// - the time spent in the buffer swap.
+// - frames missed while animating, judged against the refresh period.
+// - latency from input to the present that first reflects it and, with
+//   presentation feedback, from present to display.
+class FrameStatsReporter {
+ public:
+  using RefreshPeriodCallback = std::function<uint64_t()>;
+
+  FrameStatsReporter(EventLoop& loop,
+                     uint64_t interval_nanos,
+                     RefreshPeriodCallback refresh_period);
+
+  ~FrameStatsReporter();
+
+  bool IsValid() const;
+
+ private:
+  class Samples {
+   public:
+    void Add(uint64_t sample);
+
+    uint64_t GetPercentile(double percentile) const;
+
+    size_t GetCount() const;
+
+   private:
+    std::deque<uint64_t> samples_;
+  };
+
+  struct WindowStats {
+    // Numbers the windows in the order their first event was seen.
+    size_t index = 0;
+    uint64_t present_begin = 0;
+    uint64_t last_present_end = 0;
+    uint64_t pending_input = 0;
+    uint64_t unpresented_present_end = 0;
+    size_t frames = 0;
+    size_t missed_frames = 0;
+    Samples frame_intervals;
+    Samples present_durations;
+    Samples input_latencies;
+    Samples display_latencies;
+  };
+
+  Timer timer_;
+  RefreshPeriodCallback refresh_period_;
+  bool valid_ = false;
+  size_t dropped_events_ = 0;
+  std::unordered_map<const void*, WindowStats> windows_;
+
+  void OnTimer();
+
+  void Process(WindowStats& stats,
+               TimingEvent event,
+               uint64_t time_nanos,
+               uint64_t period);
+
+  void Dump() const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(FrameStatsReporter);
+};
+
+}  // namespace flutter
@@ -0,0 +1,80 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "legacy_shell_surface.h"
+
+namespace flutter {
+
+#define SHELL_SURFACE reinterpret_cast<LegacyShellSurface*>(data)
+
+const wl_shell_surface_listener LegacyShellSurface::kShellSurfaceListener = {
+    .ping = [](void* data,
+               struct wl_shell_surface* wl_shell_surface,
+               uint32_t serial) -> void {
+      wl_shell_surface_pong(wl_shell_surface, serial);
+    },
+
+    .configure = [](void* data,
+                    struct wl_shell_surface* wl_shell_surface,
+                    uint32_t edges,
+                    int32_t width,
+                    int32_t height) -> void {
+      SHELL_SURFACE->delegate_.OnShellSurfaceConfigure(width, height);
+    },
+
+    .popup_done = [](void* data,
+                     struct wl_shell_surface* wl_shell_surface) -> void {
+      // Nothing to do.
+    },
+};
+
+#undef SHELL_SURFACE
+
+LegacyShellSurface::LegacyShellSurface(wl_shell* shell,
+                                       wl_surface* surface,
+                                       const char* title,
+                                       bool fullscreen,
+                                       wl_output* output,
+                                       Delegate& delegate)
+    : delegate_(delegate) {
+  shell_surface_ = wl_shell_get_shell_surface(shell, surface);
+
+  if (!shell_surface_) {
+    FLWAY_ERROR << "Could not shell surface." << std::endl;
+    return;
+  }
+
+  wl_shell_surface_add_listener(shell_surface_, &kShellSurfaceListener, this);
+
+  wl_shell_surface_set_title(shell_surface_, title);
+
+  if (fullscreen) {
+    // Let the compositor switch the output mode to match our buffer, which is
+    // sized to the current mode, rather than scaling or letterboxing it.
+    wl_shell_surface_set_fullscreen(shell_surface_,
+                                    WL_SHELL_SURFACE_FULLSCREEN_METHOD_DRIVER,
+                                    0 /* framerate */, output);
+  } else {
+    wl_shell_surface_set_toplevel(shell_surface_);
+  }
+}
+
+LegacyShellSurface::~LegacyShellSurface() {
+  if (shell_surface_) {
+    wl_shell_surface_destroy(shell_surface_);
+    shell_surface_ = nullptr;
+  }
+}
+
+// |flutter::ShellSurface|
+bool LegacyShellSurface::IsValid() const {
+  return shell_surface_ != nullptr;
+}
+
+// |flutter::ShellSurface|
+void LegacyShellSurface::OnSurfaceWillCommit(int32_t width, int32_t height) {
+  // wl_shell has no configure handshake.
+}
+
+}  // namespace flutter
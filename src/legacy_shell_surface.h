@@ -0,0 +1,42 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <wayland-client.h>
+
+#include "macros.h"
+#include "shell_surface.h"
+
+namespace flutter {
+
+// Shell surface backed by the deprecated wl_shell interface. Only used on
+// compositors that do not expose xdg_wm_base.
+class LegacyShellSurface : public ShellSurface {
+ public:
+  LegacyShellSurface(wl_shell* shell,
+                     wl_surface* surface,
+                     const char* title,
+                     bool fullscreen,
+                     wl_output* output,
+                     Delegate& delegate);
+
+  ~LegacyShellSurface() override;
+
+  // |flutter::ShellSurface|
+  bool IsValid() const override;
+
+  // |flutter::ShellSurface|
+  void OnSurfaceWillCommit(int32_t width, int32_t height) override;
+
+ private:
+  static const wl_shell_surface_listener kShellSurfaceListener;
+
+  Delegate& delegate_;
+  wl_shell_surface* shell_surface_ = nullptr;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(LegacyShellSurface);
+};
+
+}  // namespace flutter
@@ -0,0 +1,359 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "logging.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "time_base.h"
+
+namespace flutter {
+
+// Longer messages are truncated.
+static const size_t kMaxLogMessageLength = 512;
+
+// Times a message may be emitted per second before repeats are suppressed.
+static const uint32_t kLogBurstPerSecond = 10;
+
+// Message texts are hashed into this many rate limiting slots. Colliding
+// messages share a budget.
+static const size_t kLogRateSlots = 256;
+
+// How long the writer sleeps without a wakeup. Threads only wake it when their
+// ring stops being empty or fills up, and a wakeup may come while it is still
+// writing.
+static const auto kLogFlushInterval = std::chrono::milliseconds(100);
+
+static std::atomic<int> g_min_log_severity(
+    static_cast<int>(LogSeverity::kInfo));
+
+// Orders messages from different threads.
+static std::atomic<uint64_t> g_log_sequence(0);
+
+struct LogRateSlot {
+  std::atomic<uint64_t> window{0};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> suppressed{0};
+};
+
+static std::array<LogRateSlot, kLogRateSlots> g_log_rate_slots;
+
+// FNV-1a over the text, without the location prefix.
+static LogRateSlot& GetLogRateSlot(const std::string& text) {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char c : text) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+  }
+  return g_log_rate_slots[hash % kLogRateSlots];
+}
+
+// Whether another copy of the message in |slot| may be emitted this second.
+static bool TakeLogBudget(LogRateSlot& slot) {
+  const uint64_t window = GetCurrentTimeNanos() / kNanosPerSecond;
+
+  uint64_t current = slot.window.load(std::memory_order_relaxed);
+  if (current != window &&
+      slot.window.compare_exchange_strong(current, window,
+                                          std::memory_order_relaxed)) {
+    slot.count.store(0, std::memory_order_relaxed);
+  }
+
+  if (slot.count.fetch_add(1, std::memory_order_relaxed) <
+      kLogBurstPerSecond) {
+    return true;
+  }
+
+  slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+struct LogRecord {
+  uint64_t sequence = 0;
+  LogSeverity severity = LogSeverity::kInfo;
+  size_t length = 0;
+  char text[kMaxLogMessageLength];
+};
+
+// Single producer, single consumer. The owning thread advances |head| and the
+// writer advances |tail|.
+class LogRing {
+ public:
+  static const size_t kCapacity = 64;
+
+  // Past this many queued records the writer is woken even though it already
+  // has records to write, so the ring does not overflow while it sleeps.
+  static const size_t kWakeupFill = kCapacity / 2;
+
+  enum class PushResult {
+    kDropped,
+    kQueued,
+    // The writer may be idle and should be woken.
+    kNeedsWakeup,
+  };
+
+  PushResult Push(LogSeverity severity, const std::string& message) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t queued = head - tail_.load(std::memory_order_acquire);
+    if (queued >= kCapacity) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return PushResult::kDropped;
+    }
+    LogRecord& record = records_[head % kCapacity];
+    record.sequence = g_log_sequence.fetch_add(1, std::memory_order_relaxed);
+    record.severity = severity;
+    record.length = std::min(message.size(), kMaxLogMessageLength);
+    ::memcpy(record.text, message.data(), record.length);
+    head_.store(head + 1, std::memory_order_release);
+    return queued == 0 || queued + 1 == kWakeupFill ? PushResult::kNeedsWakeup
+                                                    : PushResult::kQueued;
+  }
+
+  template <class Callback>
+  void Drain(Callback callback) {
+    const uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    for (; tail < head; tail++) {
+      callback(records_[tail % kCapacity]);
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  size_t TakeDropped() {
+    return dropped_.exchange(0, std::memory_order_relaxed);
+  }
+
+ private:
+  std::array<LogRecord, kCapacity> records_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<size_t> dropped_{0};
+};
+
+static void WriteFully(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    const ssize_t result =
+        ::write(fd, data.data() + written, data.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return;
+    }
+    written += result;
+  }
+}
+
+static int GetLogFileDescriptor(LogSeverity severity) {
+  return severity == LogSeverity::kError ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+static std::atomic_bool g_log_writer_shut_down(false);
+
+// Owns the rings of all threads and the thread that writes them out. Rings
+// are only ever added and outlive the threads that write to them.
+class LogWriter {
+ public:
+  LogWriter() : thread_([this]() { Run(); }) {}
+
+  // Runs during static destruction, after the engine threads are gone. Any
+  // message logged from here on is written synchronously.
+  ~LogWriter() {
+    g_log_writer_shut_down = true;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      terminate_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+  }
+
+  static bool IsShutDown() { return g_log_writer_shut_down.load(); }
+
+  LogRing* GetThreadRing() {
+    thread_local LogRing* ring = nullptr;
+
+    if (!ring) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      rings_.emplace_back(new LogRing());
+      ring = rings_.back().get();
+    }
+
+    return ring;
+  }
+
+  void Wakeup() { wakeup_.notify_one(); }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool terminate_ = false;
+  std::vector<std::unique_ptr<LogRing>> rings_;
+  std::vector<LogRecord> batch_;
+  std::thread thread_;
+
+  void Run() {
+    std::vector<LogRing*> rings;
+    bool terminate = false;
+
+    while (!terminate) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!terminate_) {
+          wakeup_.wait_for(lock, kLogFlushInterval);
+        }
+        terminate = terminate_;
+        rings.clear();
+        for (const auto& ring : rings_) {
+          rings.push_back(ring.get());
+        }
+      }
+
+      // Written without holding the lock so a thread logging for the first
+      // time never waits on the output device.
+      Flush(rings);
+    }
+  }
+
+  void Flush(const std::vector<LogRing*>& rings) {
+    size_t dropped = 0;
+    batch_.clear();
+    for (auto ring : rings) {
+      ring->Drain(
+          [this](const LogRecord& record) { batch_.push_back(record); });
+      dropped += ring->TakeDropped();
+    }
+
+    if (batch_.empty() && dropped == 0) {
+      return;
+    }
+
+    std::sort(batch_.begin(), batch_.end(),
+              [](const LogRecord& a, const LogRecord& b) {
+                return a.sequence < b.sequence;
+              });
+
+    std::string out;
+    std::string err;
+    for (const auto& record : batch_) {
+      std::string& target =
+          GetLogFileDescriptor(record.severity) == STDERR_FILENO ? err : out;
+      target.append(record.text, record.length);
+      target.push_back('\n');
+    }
+
+    if (dropped != 0) {
+      err += "ERROR: Dropped " + std::to_string(dropped) +
+             " log messages that could not be written in time.\n";
+    }
+
+    WriteFully(STDOUT_FILENO, out);
+    WriteFully(STDERR_FILENO, err);
+  }
+
+  LogWriter(const LogWriter&) = delete;
+  void operator=(const LogWriter&) = delete;
+};
+
+static LogWriter& GetLogWriter() {
+  static LogWriter writer;
+  return writer;
+}
+
+void SetMinLogSeverity(LogSeverity severity) {
+  g_min_log_severity = static_cast<int>(severity);
+}
+
+bool ShouldLog(LogSeverity severity) {
+  return static_cast<int>(severity) >=
+         g_min_log_severity.load(std::memory_order_relaxed);
+}
+
+struct ThreadLogBuffer {
+  std::ostringstream stream;
+  std::string text;
+  std::string message;
+  bool in_use = false;
+};
+
+static ThreadLogBuffer& GetThreadLogBuffer() {
+  thread_local ThreadLogBuffer buffer;
+  return buffer;
+}
+
+LogMessage::LogMessage(LogSeverity severity, const char* file, int line)
+    : severity_(severity), file_(file), line_(line) {
+  ThreadLogBuffer& buffer = GetThreadLogBuffer();
+  if (buffer.in_use) {
+    nested_stream_.reset(new std::ostringstream());
+    stream_ = nested_stream_.get();
+  } else {
+    buffer.in_use = true;
+    buffer.stream.str(std::string());
+    buffer.stream.clear();
+    stream_ = &buffer.stream;
+  }
+}
+
+LogMessage::~LogMessage() {
+  ThreadLogBuffer& buffer = GetThreadLogBuffer();
+  std::string& text = buffer.text;
+  text = stream_->str();
+
+  if (!nested_stream_) {
+    buffer.in_use = false;
+  }
+
+  // Call sites end their messages with std::endl. The writer adds its own.
+  while (!text.empty() && text.back() == '\n') {
+    text.pop_back();
+  }
+
+  LogRateSlot& slot = GetLogRateSlot(text);
+  if (!TakeLogBudget(slot)) {
+    return;
+  }
+
+  std::string& message = buffer.message;
+  message = severity_ == LogSeverity::kError ? "ERROR: " : "LOG: ";
+  message.append(file_);
+  message.push_back(':');
+  message.append(std::to_string(line_));
+  message.append(": ");
+
+  const uint32_t suppressed =
+      slot.suppressed.exchange(0, std::memory_order_relaxed);
+  if (suppressed != 0) {
+    message.append("(" + std::to_string(suppressed) +
+                   " similar messages suppressed) ");
+  }
+  message.append(text);
+
+  if (LogWriter::IsShutDown()) {
+    message.push_back('\n');
+    WriteFully(GetLogFileDescriptor(severity_), message);
+    return;
+  }
+
+  LogWriter& writer = GetLogWriter();
+  if (writer.GetThreadRing()->Push(severity_, message) ==
+      LogRing::PushResult::kNeedsWakeup) {
+    writer.Wakeup();
+  }
+}
+
+}  // namespace flutter
@@ -0,0 +1,72 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <memory>
+#include <sstream>
+
+// Messages below this severity are compiled out entirely. Build with
+// -DFLWAY_MIN_LOG_SEVERITY=1 to keep only errors, or 2 to drop all logging.
+#ifndef FLWAY_MIN_LOG_SEVERITY
+#define FLWAY_MIN_LOG_SEVERITY 0
+#endif
+
+namespace flutter {
+
+enum class LogSeverity : int {
+  kInfo = 0,
+  kError = 1,
+  kNone = 2,
+};
+
+// Messages below |severity| are dropped at runtime before they are formatted.
+void SetMinLogSeverity(LogSeverity severity);
+
+// Whether a message of |severity| should be formatted at all.
+bool ShouldLog(LogSeverity severity);
+
+// Formats a single message into a buffer owned by the calling thread and hands
+// it to a background thread for writing, so callers never wait on the output
+// device. If the calling thread logs faster than the output drains, messages
+// are dropped and counted instead of blocking. Each distinct message text may
+// be emitted in a short burst per second, from whichever call sites. Repeats
+// beyond that are counted and reported with the next one that makes it
+// through.
+class LogMessage {
+ public:
+  LogMessage(LogSeverity severity, const char* file, int line);
+
+  ~LogMessage();
+
+  std::ostream& stream() { return *stream_; }
+
+ private:
+  const LogSeverity severity_;
+  const char* const file_;
+  const int line_;
+  std::ostringstream* stream_ = nullptr;
+  // Only used if the thread buffer is already in use, such as when a value
+  // being streamed logs itself.
+  std::unique_ptr<std::ostringstream> nested_stream_;
+
+  LogMessage(const LogMessage&) = delete;
+  void operator=(const LogMessage&) = delete;
+};
+
+// Turns the streaming expression into void so it can appear in the ternary of
+// |FLWAY_LOG_STREAM|.
+class LogMessageVoidify {
+ public:
+  void operator&(std::ostream&) {}
+};
+
+}  // namespace flutter
+
+#define FLWAY_LOG_STREAM(severity)                                          \
+  (static_cast<int>(severity) < FLWAY_MIN_LOG_SEVERITY ||                   \
+   !::flutter::ShouldLog(severity))                                         \
+      ? (void)0                                                             \
+      : ::flutter::LogMessageVoidify() &                                    \
+            ::flutter::LogMessage(severity, __FILE__, __LINE__).stream()
@@ -6,6 +6,8 @@
 
 #include <iostream>
 
+#include "logging.h"
+
 #define FLWAY_DISALLOW_COPY(TypeName) TypeName(const TypeName&) = delete;
 
 #define FLWAY_DISALLOW_ASSIGN(TypeName) \
@@ -15,9 +17,11 @@
   FLWAY_DISALLOW_COPY(TypeName)                  \
   FLWAY_DISALLOW_ASSIGN(TypeName)
 
-#define __FLWAY_LINE_PREFIX << __FILE__ << ":" << __LINE__ << ": "
-#define FLWAY_LOG std::cout << "LOG: " __FLWAY_LINE_PREFIX
-#define FLWAY_ERROR std::cerr << "ERROR: " __FLWAY_LINE_PREFIX
+// Asynchronous. See |logging.h|.
+#define FLWAY_LOG FLWAY_LOG_STREAM(::flutter::LogSeverity::kInfo)
+#define FLWAY_ERROR FLWAY_LOG_STREAM(::flutter::LogSeverity::kError)
+
+// Written synchronously since the process is about to go away.
 #define FLWAY_WIP                                          \
   std::cerr << "Work In Progress. Aborting." << std::endl; \
   abort();
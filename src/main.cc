@@ -4,11 +4,20 @@
 
 #include <stdlib.h>
 
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "embedder_options.h"
+#include "event_loop.h"
 #include "flutter_application.h"
+#include "headless_display.h"
+#include "instrumentation.h"
+#include "memory_monitor.h"
+#include "tracing.h"
 #include "utils.h"
+#include "wayland_connection.h"
 #include "wayland_display.h"
 
 namespace flutter {
@@ -17,7 +26,8 @@ static void PrintUsage() {
   std::cerr << "Flutter Wayland Embedder" << std::endl << std::endl;
   std::cerr << "========================" << std::endl;
   std::cerr << "Usage: `" << GetExecutableName()
-            << " <asset_bundle_path> <flutter_flags>`" << std::endl
+            << " <asset_bundle_path> <embedder_flags> <flutter_flags>`"
+            << std::endl
             << std::endl;
   std::cerr << R"~(
 This utility runs an instance of a Flutter application and renders using
@@ -33,6 +43,108 @@ asset_bundle_path: The Flutter application code needs to be snapshotted using
                    assets in the "build/flutter_assets" directory. Specify this
                    directory as the first argument to this utility.
 
+                   With a profile or release mode engine, the directory must
+                   also contain the AOT compiled app, either as "app.so" (or
+                   "lib/libapp.so") or as the "vm_snapshot_data",
+                   "vm_snapshot_instr", "isolate_snapshot_data" and
+                   "isolate_snapshot_instr" blobs.
+
+   embedder_flags: Optional switches understood by the embedder itself.
+
+                   --vsync-source=frame-callback|presentation
+                       Pace frames with wl_surface.frame callbacks alone
+                       (default) or refine the frame timing with
+                       wp_presentation feedback when available.
+
+                   --present-mode=driver|throttled
+                       Leave eglSwapBuffers throttling to the driver (default)
+                       or present with a swap interval of zero and throttle
+                       on the embedder's own frame callback bookkeeping.
+
+                   --presenter=wayland-egl|dmabuf
+                       Let the driver manage the buffers through wayland-egl
+                       (default), or allocate them with GBM and attach them
+                       with zwp_linux_dmabuf_v1, using the format modifiers
+                       the compositor prefers. Falls back to wayland-egl when
+                       the compositor or driver cannot do that.
+
+                   --buffer-count=<2-4>
+                       Buffers the dmabuf presenter cycles through. Defaults
+                       to 2. Three lets the engine render a frame while the
+                       compositor still holds the previous two.
+
+                   --sync=explicit|implicit
+                       How the dmabuf presenter synchronizes with the
+                       compositor. Explicit (default) passes fences with
+                       wp_linux_drm_syncobj_v1 and waits for buffer releases
+                       on the GPU. Falls back to implicit synchronization when
+                       the compositor or driver cannot do that.
+
+                   --subsurfaces
+                       Present each layer of a frame, platform views
+                       included, as a subsurface the compositor blends or
+                       puts on a hardware plane. Needs --presenter=dmabuf and
+                       fails to start when it cannot be used.
+
+                   --window=<asset_bundle_path>
+                       Run another engine with this asset bundle in a window
+                       of its own. May be repeated. All windows share one
+                       connection to the compositor and one EGL display, the
+                       engine flags apply to each of them, and closing any of
+                       them exits.
+
+                   --fullscreen
+                       Cover the output with an opaque surface sized to its
+                       current mode so the compositor can scan it out
+                       directly.
+
+                   --power-saving
+                       Stop handing out vsyncs and report the app as paused
+                       on the lifecycle channel while the window is hidden:
+                       suspended by the shell, on no output, or starved of
+                       frame callbacks. Resumes as soon as it shows again.
+
+                   --memory-pressure
+                       Watch the memory pressure stall information of the
+                       process's cgroup, or /proc/meminfo on kernels without
+                       it. When memory runs short, the engine purges its GPU
+                       resources and apps are told to drop their caches.
+
+                   --resource-cache-frames=<0-64>
+                       Limit each engine's GPU resource cache to this many
+                       RGBA frames of its window's size, following resizes.
+                       Defaults to 0, which leaves the limit to the engine.
+
+                   --headless
+                       Render into an offscreen framebuffer without a
+                       compositor, for benchmarking on machines without a
+                       display. Each frame waits for the GPU to finish.
+
+                   --headless-refresh-rate=<hz>
+                       The rate of the virtual vsync pacing headless frames.
+                       Defaults to 60. Zero renders frames back to back.
+
+                   --pointer-coalescing=off|merge|predict
+                       Send every pointer sample to the engine (default),
+                       merge the moves of each pointer until the next vsync,
+                       or merge them and extrapolate the merged position to
+                       the frame target time. Downs and ups are never held.
+
+                   --stats-interval=<seconds>
+                       Log rolling frame time percentiles, missed frames and
+                       input to present latency at this interval. Off by
+                       default.
+
+                   --log-level=<info|error|none>
+                       Drop embedder log messages below this severity.
+                       Defaults to info.
+
+                   --trace-to=<file>
+                       Record embedder spans (Wayland dispatch, context
+                       switches, buffer swaps and resizes) and write them to
+                       this file as Chrome trace JSON on exit. Timestamps are
+                       on the same clock as the engine's timeline.
+
     flutter_flags: Typically empty. These extra flags are passed directly to the
                    Flutter engine. To see all supported flags, run
                    `flutter_tester --help` using the test binary included in the
@@ -40,21 +152,76 @@ asset_bundle_path: The Flutter application code needs to be snapshotted using
 )~" << std::endl;
 }
 
-static bool Main(std::vector<std::string> args) {
-  if (args.size() == 0) {
-    std::cerr << "   <Invalid Arguments>   " << std::endl;
-    PrintUsage();
-    return false;
+// Runs an engine for each of |asset_bundle_paths| in the display at the same
+// index.
+template <class Display>
+static bool RunWithDisplays(
+    const std::vector<std::unique_ptr<Display>>& displays,
+    EventLoop& event_loop,
+    const std::vector<std::string>& asset_bundle_paths,
+    const std::vector<std::string>& args,
+    const EmbedderOptions& options) {
+  // Connecting to the compositor and setting up EGL do not depend on the
+  // engines. They run on another thread while the engines load their
+  // snapshots and ICU data on this one, which has to be the platform thread.
+  bool connected = true;
+  std::thread connect_thread([&displays, &connected]() {
+    // Every display is connected so none is left waiting for its setup.
+    for (const auto& display : displays) {
+      connected = display->Connect() && connected;
+    }
+  });
+
+  std::vector<std::unique_ptr<FlutterApplication>> applications;
+  for (size_t i = 0; i < displays.size(); i++) {
+    applications.emplace_back(new FlutterApplication(
+        asset_bundle_paths[i], args, *displays[i], event_loop));
   }
 
-  const auto asset_bundle_path = args[0];
+  connect_thread.join();
 
-  if (!FlutterAssetBundleIsValid(asset_bundle_path)) {
-    std::cerr << "   <Invalid Flutter Asset Bundle>   " << std::endl;
-    PrintUsage();
-    return false;
+  for (const auto& display : displays) {
+    if (!connected || !display->AttachToEventLoop()) {
+      FLWAY_ERROR << "Display was not valid." << std::endl;
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < displays.size(); i++) {
+    if (!applications[i]->IsValid() || !applications[i]->Run()) {
+      FLWAY_ERROR << "Flutter application was not valid." << std::endl;
+      return false;
+    }
+
+    applications[i]->SetResourceCacheFrames(options.resource_cache_frames);
+
+    if (!displays[i]->SetApplication(applications[i].get())) {
+      FLWAY_ERROR << "Could not update Flutter application size."
+                  << std::endl;
+      return false;
+    }
   }
 
+  std::unique_ptr<MemoryMonitor> memory_monitor;
+  if (options.memory_pressure) {
+    memory_monitor.reset(new MemoryMonitor(event_loop, [&applications]() {
+      for (const auto& application : applications) {
+        application->NotifyMemoryPressure();
+      }
+    }));
+
+    if (!memory_monitor->IsValid()) {
+      FLWAY_ERROR << "Could not watch the memory pressure." << std::endl;
+      return false;
+    }
+  }
+
+  return event_loop.Run();
+}
+
+static bool Run(const std::vector<std::string>& asset_bundle_paths,
+                std::vector<std::string> args,
+                const EmbedderOptions& options) {
   const size_t kWidth = 800;
   const size_t kHeight = 600;
 
@@ -62,27 +229,86 @@ static bool Main(std::vector<std::string> args) {
     FLWAY_ERROR << "Arg: " << arg << std::endl;
   }
 
-  WaylandDisplay display(kWidth, kHeight);
+  EventLoop event_loop;
 
-  if (!display.IsValid()) {
-    FLWAY_ERROR << "Wayland display was not valid." << std::endl;
+  if (!event_loop.IsValid()) {
+    FLWAY_ERROR << "Event loop was not valid." << std::endl;
     return false;
   }
 
-  FlutterApplication application(asset_bundle_path, args, display);
-  if (!application.IsValid()) {
-    FLWAY_ERROR << "Flutter application was not valid." << std::endl;
+  if (options.headless) {
+    std::vector<std::unique_ptr<HeadlessDisplay>> displays;
+    displays.emplace_back(
+        new HeadlessDisplay(event_loop, kWidth, kHeight, options));
+    return RunWithDisplays(displays, event_loop, asset_bundle_paths, args,
+                           options);
+  }
+
+  // Declared first so it outlives the windows.
+  WaylandConnection connection(event_loop, options);
+  std::vector<std::unique_ptr<WaylandDisplay>> displays;
+  for (size_t i = 0; i < asset_bundle_paths.size(); i++) {
+    displays.emplace_back(
+        new WaylandDisplay(connection, kWidth, kHeight, options));
+  }
+  return RunWithDisplays(displays, event_loop, asset_bundle_paths, args,
+                         options);
+}
+
+static bool Main(std::vector<std::string> args) {
+  RecordStartupMilestone("main");
+
+  EmbedderOptions options;
+
+  if (!ParseEmbedderOptions(args, options)) {
+    std::cerr << "   <Invalid Embedder Options>   " << std::endl;
+    PrintUsage();
     return false;
   }
 
-  if (!application.SetWindowSize(kWidth, kHeight)) {
-    FLWAY_ERROR << "Could not update Flutter application size." << std::endl;
+  SetMinLogSeverity(options.log_severity);
+
+  if (args.size() == 0) {
+    std::cerr << "   <Invalid Arguments>   " << std::endl;
+    PrintUsage();
+    return false;
+  }
+
+  std::vector<std::string> asset_bundle_paths = {args[0]};
+  asset_bundle_paths.insert(asset_bundle_paths.end(),
+                            options.window_bundle_paths.begin(),
+                            options.window_bundle_paths.end());
+
+  for (const auto& asset_bundle_path : asset_bundle_paths) {
+    if (!FlutterAssetBundleIsValid(asset_bundle_path)) {
+      std::cerr << "   <Invalid Flutter Asset Bundle>   " << std::endl;
+      PrintUsage();
+      return false;
+    }
+  }
+
+  if (options.headless && asset_bundle_paths.size() > 1) {
+    std::cerr << "   <Headless Runs Have A Single Window>   " << std::endl;
+    PrintUsage();
     return false;
   }
 
-  display.Run();
+  // Several minutes of continuous animation at around 10MB.
+  const size_t kTraceCapacity = 1 << 18;
+
+  if (!options.trace_path.empty() && !StartTracing(kTraceCapacity)) {
+    return false;
+  }
+
+  const bool success = Run(asset_bundle_paths, std::move(args), options);
+
+  // Everything that records spans, including the engine threads, is gone by
+  // now.
+  if (!options.trace_path.empty() && !StopTracingAndWrite(options.trace_path)) {
+    return false;
+  }
 
-  return true;
+  return success;
 }
 
 }  // namespace flutter
@@ -0,0 +1,174 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "memory_monitor.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "time_base.h"
+
+namespace flutter {
+
+// Fire once tasks of the cgroup were stalled on memory for 150ms of a two
+// second window. Unprivileged processes may only create triggers with windows
+// that are a multiple of two seconds.
+static const char* kPressureTrigger = "some 150000 2000000";
+static const uint64_t kTriggerWindowNanos = 2 * kNanosPerSecond;
+
+// Without PSI, less than a tenth of the memory being available counts as
+// pressure.
+static const uint64_t kMeminfoPollIntervalNanos = kNanosPerSecond;
+static const uint64_t kLowMemoryDivisor = 10;
+
+// The memory.pressure file of the cgroup v2 hierarchy the process is in.
+// Empty when the process is not in one.
+static std::string GetCgroupPressurePath() {
+  std::ifstream stream("/proc/self/cgroup");
+  std::string line;
+
+  while (std::getline(stream, line)) {
+    if (line.compare(0, 3, "0::") == 0) {
+      return "/sys/fs/cgroup" + line.substr(3) + "/memory.pressure";
+    }
+  }
+
+  return "";
+}
+
+// Reads a field of /proc/meminfo in kB. Zero if it is missing.
+static uint64_t GetMeminfoField(const std::string& meminfo,
+                                const char* field) {
+  const size_t found = meminfo.find(field);
+  if (found == std::string::npos) {
+    return 0;
+  }
+
+  std::istringstream stream(meminfo.substr(found + strlen(field)));
+  uint64_t kilobytes = 0;
+  stream >> kilobytes;
+  return kilobytes;
+}
+
+MemoryMonitor::MemoryMonitor(EventLoop& loop, PressureCallback on_pressure)
+    : loop_(loop),
+      on_pressure_(std::move(on_pressure)),
+      poll_timer_(loop, [this]() { PollMeminfo(); }) {
+  const std::string cgroup_path = GetCgroupPressurePath();
+
+  if ((!cgroup_path.empty() && OpenPressureTrigger(cgroup_path)) ||
+      OpenPressureTrigger("/proc/pressure/memory")) {
+    valid_ = true;
+    return;
+  }
+
+  FLWAY_LOG << "Pressure stall information is not available. Polling "
+               "/proc/meminfo instead."
+            << std::endl;
+  valid_ = StartPolling();
+}
+
+MemoryMonitor::~MemoryMonitor() {
+  ClosePressureTrigger();
+}
+
+bool MemoryMonitor::IsValid() const {
+  return valid_;
+}
+
+bool MemoryMonitor::OpenPressureTrigger(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+
+  // Triggers are written with their terminating NUL.
+  if (::write(fd, kPressureTrigger, strlen(kPressureTrigger) + 1) == -1) {
+    FLWAY_LOG << "Could not create a pressure trigger on " << path << ": "
+              << strerror(errno) << std::endl;
+    ::close(fd);
+    return false;
+  }
+
+  if (!loop_.AddFileDescriptor(
+          fd, EPOLLPRI | EPOLLERR,
+          [this](uint32_t events) { OnPressureEvents(events); })) {
+    ::close(fd);
+    return false;
+  }
+
+  pressure_fd_ = fd;
+  FLWAY_LOG << "Watching memory pressure on " << path << std::endl;
+  return true;
+}
+
+void MemoryMonitor::ClosePressureTrigger() {
+  if (pressure_fd_ == -1) {
+    return;
+  }
+
+  loop_.RemoveFileDescriptor(pressure_fd_);
+  ::close(pressure_fd_);
+  pressure_fd_ = -1;
+}
+
+bool MemoryMonitor::StartPolling() {
+  if (!poll_timer_.IsValid() ||
+      !poll_timer_.ArmRepeating(kMeminfoPollIntervalNanos)) {
+    FLWAY_ERROR << "Could not poll the available memory." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// The trigger reports an error once the cgroup it watches is removed.
+void MemoryMonitor::OnPressureEvents(uint32_t events) {
+  if (events & EPOLLERR) {
+    FLWAY_LOG << "The memory pressure trigger went away." << std::endl;
+    ClosePressureTrigger();
+    valid_ = StartPolling();
+    return;
+  }
+
+  if (events & EPOLLPRI) {
+    NotifyPressure();
+  }
+}
+
+void MemoryMonitor::PollMeminfo() {
+  std::ifstream stream("/proc/meminfo");
+  const std::string meminfo((std::istreambuf_iterator<char>(stream)),
+                            std::istreambuf_iterator<char>());
+
+  const uint64_t total = GetMeminfoField(meminfo, "MemTotal:");
+  const uint64_t available = GetMeminfoField(meminfo, "MemAvailable:");
+
+  if (total != 0 && available != 0 && available < total / kLowMemoryDivisor) {
+    NotifyPressure();
+  }
+}
+
+// Both sources fire repeatedly while the pressure lasts. Purging caches more
+// often than once per trigger window only costs the app its working set.
+void MemoryMonitor::NotifyPressure() {
+  const uint64_t now = GetCurrentTimeNanos();
+
+  if (last_notification_nanos_ != 0 &&
+      now - last_notification_nanos_ < kTriggerWindowNanos) {
+    return;
+  }
+
+  last_notification_nanos_ = now;
+  FLWAY_LOG << "Memory pressure." << std::endl;
+  on_pressure_();
+}
+
+}  // namespace flutter
@@ -0,0 +1,58 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Watches for the system running short of memory. Prefers a pressure stall
+// information trigger on the memory cgroup of the process, or on the whole
+// system outside of cgroup v2, which the kernel signals once tasks spend too
+// long waiting for memory. On kernels without PSI, /proc/meminfo is polled
+// for the available memory dropping below a fraction of the total. Must only
+// be used on the event loop thread.
+class MemoryMonitor {
+ public:
+  using PressureCallback = std::function<void()>;
+
+  // |on_pressure| is invoked at most once per trigger window while the
+  // pressure lasts.
+  MemoryMonitor(EventLoop& loop, PressureCallback on_pressure);
+
+  ~MemoryMonitor();
+
+  bool IsValid() const;
+
+ private:
+  EventLoop& loop_;
+  PressureCallback on_pressure_;
+  int pressure_fd_ = -1;
+  Timer poll_timer_;
+  uint64_t last_notification_nanos_ = 0;
+  bool valid_ = false;
+
+  bool OpenPressureTrigger(const std::string& path);
+
+  void ClosePressureTrigger();
+
+  bool StartPolling();
+
+  void OnPressureEvents(uint32_t events);
+
+  void PollMeminfo();
+
+  void NotifyPressure();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(MemoryMonitor);
+};
+
+}  // namespace flutter
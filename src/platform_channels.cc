@@ -0,0 +1,116 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform_channels.h"
+
+#include <cstring>
+#include <mutex>
+
+#include "tracing.h"
+
+namespace flutter {
+
+// Replies are sent with |mutex| held so shutdown cannot overtake one.
+struct PlatformMessageResponse::State {
+  std::mutex mutex;
+  bool shut_down = false;
+};
+
+PlatformMessageResponse::PlatformMessageResponse(
+    FlutterEngine engine,
+    const FlutterPlatformMessageResponseHandle* handle,
+    std::shared_ptr<State> state)
+    : engine_(engine), handle_(handle), state_(std::move(state)) {}
+
+PlatformMessageResponse::PlatformMessageResponse(
+    PlatformMessageResponse&& other)
+    : engine_(other.engine_),
+      handle_(other.handle_),
+      state_(std::move(other.state_)) {
+  other.handle_ = nullptr;
+}
+
+PlatformMessageResponse::~PlatformMessageResponse() {
+  Send(nullptr, 0);
+}
+
+bool PlatformMessageResponse::Send(const uint8_t* data, size_t size) {
+  if (!handle_) {
+    return false;
+  }
+
+  const FlutterPlatformMessageResponseHandle* handle = handle_;
+  handle_ = nullptr;
+
+  std::lock_guard<std::mutex> lock(state_->mutex);
+
+  if (state_->shut_down) {
+    return false;
+  }
+
+  if (FlutterEngineSendPlatformMessageResponse(engine_, handle, data, size) !=
+      kSuccess) {
+    FLWAY_ERROR << "Could not reply to a platform message." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+// FNV-1a, which is quick for names as short as those of channels.
+size_t PlatformChannels::ChannelHash::operator()(const char* channel) const {
+  uint64_t hash = 14695981039346656037ull;
+  for (const char* c = channel; *c != '\0'; c++) {
+    hash = (hash ^ static_cast<uint8_t>(*c)) * 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool PlatformChannels::ChannelEqual::operator()(const char* a,
+                                                const char* b) const {
+  return strcmp(a, b) == 0;
+}
+
+PlatformChannels::PlatformChannels()
+    : response_state_(std::make_shared<PlatformMessageResponse::State>()) {}
+
+PlatformChannels::~PlatformChannels() = default;
+
+void PlatformChannels::SetMessageHandler(const std::string& channel,
+                                         MessageHandler handler) {
+  registrations_.erase(channel.c_str());
+
+  if (!handler) {
+    return;
+  }
+
+  std::unique_ptr<Registration> registration(new Registration());
+  registration->channel = channel;
+  registration->handler = std::move(handler);
+  const char* key = registration->channel.c_str();
+  registrations_[key] = std::move(registration);
+}
+
+void PlatformChannels::DispatchMessage(FlutterEngine engine,
+                                       const FlutterPlatformMessage& message) {
+  PlatformMessageResponse response(engine, message.response_handle,
+                                   response_state_);
+
+  auto found = registrations_.find(message.channel);
+
+  if (found == registrations_.end()) {
+    return;
+  }
+
+  FLWAY_TRACE_SCOPE("PlatformChannels::DispatchMessage");
+  found->second->handler(message.message, message.message_size,
+                         std::move(response));
+}
+
+void PlatformChannels::Shutdown() {
+  std::lock_guard<std::mutex> lock(response_state_->mutex);
+  response_state_->shut_down = true;
+}
+
+}  // namespace flutter
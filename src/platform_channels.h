@@ -0,0 +1,106 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The reply to one platform message. The engine expects every message to be
+// answered exactly once, so a response that is dropped without being sent
+// answers with an empty reply, which the framework reads as the channel not
+// being implemented. May be sent from any thread. Responses kept past
+// |PlatformChannels::Shutdown| are dropped without reaching the engine.
+class PlatformMessageResponse {
+ public:
+  // Shared by the responses of one engine. Defined in the implementation.
+  struct State;
+
+  // |handle| is null for messages that expect no reply.
+  PlatformMessageResponse(FlutterEngine engine,
+                          const FlutterPlatformMessageResponseHandle* handle,
+                          std::shared_ptr<State> state);
+
+  PlatformMessageResponse(PlatformMessageResponse&& other);
+
+  ~PlatformMessageResponse();
+
+  bool Send(const uint8_t* data, size_t size);
+
+ private:
+  FlutterEngine engine_;
+  const FlutterPlatformMessageResponseHandle* handle_;
+  std::shared_ptr<State> state_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PlatformMessageResponse);
+};
+
+// Routes the platform messages of an engine to the handlers of their
+// channels. Handlers run on the platform thread with the message still owned
+// by the engine, so they read it in place, for instance with a
+// |StandardMessageReader|. Neither dispatching a message nor replying to it
+// allocates.
+class PlatformChannels {
+ public:
+  // |message| is only valid for the duration of the call. |response| may be
+  // kept to reply later.
+  using MessageHandler = std::function<void(const uint8_t* message,
+                                            size_t message_size,
+                                            PlatformMessageResponse response)>;
+
+  PlatformChannels();
+
+  ~PlatformChannels();
+
+  // Replaces the handler of |channel|. A null handler removes it. Must not be
+  // called from within the handler of the same channel.
+  void SetMessageHandler(const std::string& channel, MessageHandler handler);
+
+  // Messages on channels without a handler get an empty reply.
+  void DispatchMessage(FlutterEngine engine,
+                       const FlutterPlatformMessage& message);
+
+  // Must be called before the engine shuts down. Responses sent afterwards,
+  // from any thread, are dropped, and a response being sent concurrently is
+  // waited for.
+  void Shutdown();
+
+ private:
+  struct Registration {
+    std::string channel;
+    MessageHandler handler;
+  };
+
+  // Looks channels up by the name the engine hands out, without copying it
+  // into a string first.
+  struct ChannelHash {
+    size_t operator()(const char* channel) const;
+  };
+
+  struct ChannelEqual {
+    bool operator()(const char* a, const char* b) const;
+  };
+
+  // Keyed by the name owned by the registration.
+  std::unordered_map<const char*,
+                     std::unique_ptr<Registration>,
+                     ChannelHash,
+                     ChannelEqual>
+      registrations_;
+  // Allocated once, so handing it to responses only takes a reference.
+  std::shared_ptr<PlatformMessageResponse::State> response_state_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PlatformChannels);
+};
+
+}  // namespace flutter
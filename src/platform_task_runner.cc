@@ -0,0 +1,196 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "platform_task_runner.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "time_base.h"
+
+namespace flutter {
+
+PlatformTaskRunner::PlatformTaskRunner(EventLoop& loop, TaskExecutor executor)
+    : loop_(loop),
+      executor_(std::move(executor)),
+      thread_id_(std::this_thread::get_id()),
+      wakeup_pending_(false),
+      timer_(loop, [this]() { RunExpiredTasks(); }) {
+  description_.struct_size = sizeof(description_);
+  description_.user_data = this;
+  description_.runs_task_on_current_thread_callback =
+      [](void* user_data) -> bool {
+    return reinterpret_cast<PlatformTaskRunner*>(user_data)
+        ->RunsTasksOnCurrentThread();
+  };
+  description_.post_task_callback = [](FlutterTask task,
+                                       uint64_t target_time_nanos,
+                                       void* user_data) -> void {
+    reinterpret_cast<PlatformTaskRunner*>(user_data)->PostTask(
+        task, target_time_nanos);
+  };
+
+  if (!timer_.IsValid()) {
+    FLWAY_ERROR << "Could not create the task runner timer." << std::endl;
+    return;
+  }
+
+  wakeup_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (wakeup_fd_ == -1) {
+    FLWAY_ERROR << "Could not create the task runner wakeup event: "
+                << ::strerror(errno) << std::endl;
+    return;
+  }
+
+  if (!loop_.AddFileDescriptor(wakeup_fd_, EPOLLIN,
+                               [this](uint32_t) { OnWakeup(); })) {
+    ::close(wakeup_fd_);
+    wakeup_fd_ = -1;
+    return;
+  }
+}
+
+PlatformTaskRunner::~PlatformTaskRunner() {
+  if (wakeup_fd_ != -1) {
+    loop_.RemoveFileDescriptor(wakeup_fd_);
+    ::close(wakeup_fd_);
+    wakeup_fd_ = -1;
+  }
+}
+
+bool PlatformTaskRunner::IsValid() const {
+  return wakeup_fd_ != -1;
+}
+
+const FlutterTaskRunnerDescription& PlatformTaskRunner::GetDescription()
+    const {
+  return description_;
+}
+
+bool PlatformTaskRunner::RunsTasksOnCurrentThread() const {
+  return std::this_thread::get_id() == thread_id_;
+}
+
+void PlatformTaskRunner::PostTask(FlutterTask task,
+                                  uint64_t target_time_nanos) {
+  Task entry;
+  entry.target_time_nanos = target_time_nanos;
+  entry.task = task;
+  Enqueue(std::move(entry));
+}
+
+void PlatformTaskRunner::PostTask(std::function<void()> closure) {
+  Task entry;
+  entry.target_time_nanos = GetCurrentTimeNanos();
+  entry.closure = std::move(closure);
+  Enqueue(std::move(entry));
+}
+
+void PlatformTaskRunner::Enqueue(Task task) {
+  bool earliest = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task.order = order_++;
+    const uint64_t order = task.order;
+    queue_.push(std::move(task));
+    earliest = queue_.top().order == order;
+    stats_.max_queue_depth = std::max(stats_.max_queue_depth, queue_.size());
+  }
+
+  // Only a change in the earliest deadline requires the timer to be re-armed.
+  if (earliest) {
+    Wakeup();
+  }
+}
+
+PlatformTaskRunner::Stats PlatformTaskRunner::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PlatformTaskRunner::Wakeup() {
+  // Coalesce wakeups that arrive before the loop gets around to servicing the
+  // previous one.
+  if (wakeup_pending_.exchange(true)) {
+    return;
+  }
+
+  const uint64_t value = 1;
+  if (::write(wakeup_fd_, &value, sizeof(value)) != sizeof(value)) {
+    FLWAY_ERROR << "Could not wake up the platform task runner." << std::endl;
+  }
+}
+
+void PlatformTaskRunner::OnWakeup() {
+  uint64_t value = 0;
+  if (::read(wakeup_fd_, &value, sizeof(value)) != sizeof(value)) {
+    return;
+  }
+
+  wakeup_pending_ = false;
+  RunExpiredTasks();
+}
+
+void PlatformTaskRunner::RunExpiredTasks() {
+  // Tasks posted while this batch runs are picked up on the next iteration so
+  // a task that keeps re-posting itself cannot starve the Wayland connection.
+  const uint64_t now = GetCurrentTimeNanos();
+  uint64_t batch_end = 0;
+  bool has_next = false;
+  uint64_t next_target_time = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_end = order_;
+  }
+
+  while (true) {
+    Task task;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+
+      if (queue_.empty()) {
+        break;
+      }
+
+      const Task& top = queue_.top();
+
+      if (top.target_time_nanos > now || top.order >= batch_end) {
+        has_next = true;
+        next_target_time = top.target_time_nanos;
+        break;
+      }
+
+      task = std::move(const_cast<Task&>(top));
+      queue_.pop();
+
+      const uint64_t latency = now - task.target_time_nanos;
+      stats_.tasks_run++;
+      stats_.total_latency_nanos += latency;
+      stats_.max_latency_nanos = std::max(stats_.max_latency_nanos, latency);
+    }
+
+    if (task.closure) {
+      task.closure();
+    } else {
+      executor_(task.task);
+    }
+  }
+
+  if (has_next) {
+    timer_.ArmAt(next_target_time);
+  } else {
+    timer_.Disarm();
+  }
+}
+
+}  // namespace flutter
@@ -0,0 +1,96 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Runs engine tasks on the event loop thread at their target times. Tasks may
+// be posted from any thread; they are kept in a min-heap keyed on target time
+// and the event loop is woken through an eventfd whenever the earliest
+// deadline changes.
+class PlatformTaskRunner {
+ public:
+  using TaskExecutor = std::function<void(const FlutterTask& task)>;
+
+  struct Stats {
+    size_t tasks_run = 0;
+    size_t max_queue_depth = 0;
+    uint64_t total_latency_nanos = 0;
+    uint64_t max_latency_nanos = 0;
+  };
+
+  // Must be created on the event loop thread.
+  PlatformTaskRunner(EventLoop& loop, TaskExecutor executor);
+
+  ~PlatformTaskRunner();
+
+  bool IsValid() const;
+
+  const FlutterTaskRunnerDescription& GetDescription() const;
+
+  bool RunsTasksOnCurrentThread() const;
+
+  void PostTask(FlutterTask task, uint64_t target_time_nanos);
+
+  // Run an embedder closure on the event loop thread as soon as possible.
+  void PostTask(std::function<void()> closure);
+
+  Stats GetStats() const;
+
+ private:
+  struct Task {
+    uint64_t target_time_nanos = 0;
+    uint64_t order = 0;
+    FlutterTask task = {};
+    std::function<void()> closure;
+  };
+
+  struct TaskCompare {
+    bool operator()(const Task& a, const Task& b) const {
+      // std::priority_queue is a max-heap. Invert so the earliest target time
+      // is on top and ties run in the order they were posted.
+      if (a.target_time_nanos != b.target_time_nanos) {
+        return a.target_time_nanos > b.target_time_nanos;
+      }
+      return a.order > b.order;
+    }
+  };
+
+  EventLoop& loop_;
+  TaskExecutor executor_;
+  const std::thread::id thread_id_;
+  FlutterTaskRunnerDescription description_ = {};
+  int wakeup_fd_ = -1;
+  std::atomic_bool wakeup_pending_;
+  Timer timer_;
+  mutable std::mutex mutex_;
+  std::priority_queue<Task, std::vector<Task>, TaskCompare> queue_;
+  uint64_t order_ = 0;
+  Stats stats_;
+
+  void Enqueue(Task task);
+
+  void Wakeup();
+
+  void OnWakeup();
+
+  void RunExpiredTasks();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PlatformTaskRunner);
+};
+
+}  // namespace flutter
@@ -0,0 +1,160 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pointer_coalescer.h"
+
+#include <algorithm>
+
+#include "time_base.h"
+
+namespace flutter {
+
+// Extrapolating further than this, or from samples further apart than this,
+// overshoots more than it helps.
+static const uint64_t kMaxPredictionNanos = 20 * kNanosPerMilli;
+static const uint64_t kMaxSampleIntervalNanos = 50 * kNanosPerMilli;
+
+PointerCoalescer::PointerCoalescer(EventLoop& loop, bool predict, Sink sink)
+    : predict_(predict),
+      sink_(std::move(sink)),
+      hold_timer_(loop, [this]() { Flush(0); }) {}
+
+PointerCoalescer::~PointerCoalescer() = default;
+
+bool PointerCoalescer::IsMergeable(const FlutterPointerEvent& event) {
+  return (event.phase == kMove || event.phase == kHover) &&
+         event.signal_kind == kFlutterPointerSignalKindNone;
+}
+
+void PointerCoalescer::Push(const FlutterPointerEvent* events,
+                            size_t count,
+                            uint64_t max_hold_nanos) {
+  stats_.events_received += count;
+
+  bool deliver_now = false;
+
+  for (size_t i = 0; i < count; i++) {
+    const FlutterPointerEvent& event = events[i];
+    RecordSample(event);
+
+    if (!IsMergeable(event)) {
+      pending_.push_back(event);
+      deliver_now = true;
+      continue;
+    }
+
+    // Moves are only ever held at the end of the queue, so the held move of
+    // this pointer, if any, can be replaced without reordering anything.
+    auto held = std::find_if(pending_.rbegin(), pending_.rend(),
+                             [&event](const FlutterPointerEvent& pending) {
+                               return pending.device == event.device;
+                             });
+
+    if (held != pending_.rend() && IsMergeable(*held) &&
+        held->phase == event.phase && held->buttons == event.buttons) {
+      *held = event;
+    } else {
+      pending_.push_back(event);
+    }
+  }
+
+  if (deliver_now) {
+    Flush(0);
+    return;
+  }
+
+  if (!pending_.empty() && !hold_timer_armed_) {
+    hold_timer_armed_ =
+        hold_timer_.ArmAt(GetCurrentTimeNanos() + max_hold_nanos);
+  }
+}
+
+void PointerCoalescer::Flush(uint64_t target_time_nanos) {
+  if (hold_timer_armed_) {
+    hold_timer_.Disarm();
+    hold_timer_armed_ = false;
+  }
+
+  if (pending_.empty()) {
+    return;
+  }
+
+  if (predict_ && target_time_nanos != 0) {
+    for (auto& event : pending_) {
+      if (IsMergeable(event)) {
+        Predict(event, target_time_nanos);
+      }
+    }
+  }
+
+  Deliver();
+}
+
+PointerCoalescer::Stats PointerCoalescer::GetStats() const {
+  return stats_;
+}
+
+void PointerCoalescer::RecordSample(const FlutterPointerEvent& event) {
+  if (!IsMergeable(event) && event.phase != kDown) {
+    return;
+  }
+
+  History& history = history_[event.device];
+
+  // A down starts a new stroke. Do not extrapolate across it.
+  history.has_previous =
+      event.phase != kDown && history.latest.struct_size != 0;
+  history.previous = history.latest;
+  history.latest = event;
+}
+
+// Linear extrapolation from the two most recent samples.
+void PointerCoalescer::Predict(FlutterPointerEvent& event,
+                               uint64_t target_time_nanos) {
+  auto found = history_.find(event.device);
+
+  if (found == history_.end() || !found->second.has_previous) {
+    return;
+  }
+
+  const FlutterPointerEvent& previous = found->second.previous;
+  const FlutterPointerEvent& latest = found->second.latest;
+
+  const uint64_t latest_nanos = latest.timestamp * kNanosPerMicro;
+  const uint64_t previous_nanos = previous.timestamp * kNanosPerMicro;
+
+  if (latest_nanos <= previous_nanos ||
+      latest_nanos - previous_nanos > kMaxSampleIntervalNanos ||
+      target_time_nanos <= latest_nanos) {
+    return;
+  }
+
+  const uint64_t horizon =
+      std::min(target_time_nanos - latest_nanos, kMaxPredictionNanos);
+  const double scale = static_cast<double>(horizon) /
+                       static_cast<double>(latest_nanos - previous_nanos);
+
+  event.x = latest.x + (latest.x - previous.x) * scale;
+  event.y = latest.y + (latest.y - previous.y) * scale;
+  event.timestamp = (latest_nanos + horizon) / kNanosPerMicro;
+}
+
+void PointerCoalescer::Deliver() {
+  for (auto& event : pending_) {
+    History& history = history_[event.device];
+    event.timestamp =
+        std::max(event.timestamp, history.last_delivered_timestamp);
+    history.last_delivered_timestamp = event.timestamp;
+
+    if (event.phase == kRemove) {
+      history_.erase(event.device);
+    }
+  }
+
+  stats_.events_delivered += pending_.size();
+  sink_(pending_.data(), pending_.size());
+  pending_.clear();
+}
+
+}  // namespace flutter
@@ -0,0 +1,81 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Holds pointer moves back until the next vsync and merges consecutive moves
+// of the same pointer into one, so a digitizer reporting several samples per
+// display refresh costs the framework a single event per frame. Anything that
+// is not a plain move (downs, ups, signals, adds and removes) is delivered
+// right away together with everything held before it, so ordering and
+// down/up latency are preserved. Must only be used on the event loop thread.
+class PointerCoalescer {
+ public:
+  using Sink =
+      std::function<void(const FlutterPointerEvent* events, size_t count)>;
+
+  struct Stats {
+    size_t events_received = 0;
+    size_t events_delivered = 0;
+  };
+
+  // With |predict|, merged moves are extrapolated to the frame target time
+  // passed to |Flush|.
+  PointerCoalescer(EventLoop& loop, bool predict, Sink sink);
+
+  ~PointerCoalescer();
+
+  // Held moves are delivered no later than |max_hold_nanos| after the first
+  // of them arrived, even if no vsync is requested in the meantime.
+  void Push(const FlutterPointerEvent* events,
+            size_t count,
+            uint64_t max_hold_nanos);
+
+  // Deliver everything held. Called when the engine is about to begin a frame
+  // targeting |target_time_nanos|. A target of zero disables prediction.
+  void Flush(uint64_t target_time_nanos);
+
+  Stats GetStats() const;
+
+ private:
+  // The two most recent raw samples of a pointer.
+  struct History {
+    FlutterPointerEvent previous = {};
+    FlutterPointerEvent latest = {};
+    bool has_previous = false;
+    // Timestamps are kept increasing even after a predicted move.
+    size_t last_delivered_timestamp = 0;
+  };
+
+  const bool predict_;
+  Sink sink_;
+  Timer hold_timer_;
+  bool hold_timer_armed_ = false;
+  std::vector<FlutterPointerEvent> pending_;
+  std::map<int32_t, History> history_;
+  Stats stats_;
+
+  static bool IsMergeable(const FlutterPointerEvent& event);
+
+  void RecordSample(const FlutterPointerEvent& event);
+
+  void Predict(FlutterPointerEvent& event, uint64_t target_time_nanos);
+
+  void Deliver();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(PointerCoalescer);
+};
+
+}  // namespace flutter
@@ -0,0 +1,52 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#include "macros.h"
+
+namespace flutter {
+
+// The role given to the Flutter wl_surface by the compositor's shell. Either
+// xdg-shell or, on compositors that lack it, the deprecated wl_shell.
+class ShellSurface {
+ public:
+  class Delegate {
+   public:
+    // Invoked on the platform thread with the size the shell would like the
+    // window to be in surface coordinates. Zero dimensions mean the client is
+    // free to pick its own size.
+    virtual void OnShellSurfaceConfigure(int32_t width, int32_t height) = 0;
+
+    // Invoked on the platform thread when the user asked the window to close.
+    virtual void OnShellSurfaceClose() = 0;
+
+    // Invoked on the platform thread when the shell stops or resumes showing
+    // the window, for instance because it was minimized or another window
+    // covers it entirely. Not every shell tells.
+    virtual void OnShellSurfaceSuspended(bool suspended) = 0;
+
+    // Invoked on the platform thread after a configure was acknowledged
+    // without a new frame. The surface has to be committed for the shell to
+    // apply it.
+    virtual void OnShellSurfaceNeedsCommit() = 0;
+  };
+
+  ShellSurface() = default;
+
+  virtual ~ShellSurface() = default;
+
+  virtual bool IsValid() const = 0;
+
+  // Called on the raster thread just before the surface is committed with a
+  // frame of |width| by |height| in surface coordinates.
+  virtual void OnSurfaceWillCommit(int32_t width, int32_t height) = 0;
+
+ private:
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(ShellSurface);
+};
+
+}  // namespace flutter
@@ -0,0 +1,344 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "standard_message_codec.h"
+
+#include <limits>
+
+namespace flutter {
+
+// Sizes below this fit in the size byte itself. The two values above it
+// announce a uint16_t or a uint32_t size.
+static const uint8_t kMaxInlineSize = 253;
+static const uint8_t kUint16Size = 254;
+static const uint8_t kUint32Size = 255;
+
+// The size of the elements of typed lists, which is also their alignment.
+// Zero for everything else.
+static size_t GetElementSize(StandardValue::Type type) {
+  switch (type) {
+    case StandardValue::Type::kUint8List:
+      return sizeof(uint8_t);
+    case StandardValue::Type::kInt32List:
+      return sizeof(int32_t);
+    case StandardValue::Type::kInt64List:
+      return sizeof(int64_t);
+    case StandardValue::Type::kFloat32List:
+      return sizeof(float);
+    case StandardValue::Type::kFloat64List:
+      return sizeof(double);
+    default:
+      return 0;
+  }
+}
+
+StandardMessageReader::StandardMessageReader(const uint8_t* data, size_t size)
+    : data_(data), size_(data ? size : 0) {}
+
+StandardMessageReader::~StandardMessageReader() = default;
+
+bool StandardMessageReader::IsAtEnd() const {
+  return offset_ >= size_;
+}
+
+bool StandardMessageReader::ReadByte(uint8_t& byte) {
+  if (offset_ >= size_) {
+    return false;
+  }
+
+  byte = data_[offset_++];
+  return true;
+}
+
+bool StandardMessageReader::ReadBytes(size_t count, const uint8_t*& bytes) {
+  if (count > size_ - offset_) {
+    return false;
+  }
+
+  bytes = data_ + offset_;
+  offset_ += count;
+  return true;
+}
+
+bool StandardMessageReader::ReadSize(size_t& size) {
+  uint8_t byte = 0;
+
+  if (!ReadByte(byte)) {
+    return false;
+  }
+
+  if (byte <= kMaxInlineSize) {
+    size = byte;
+    return true;
+  }
+
+  const uint8_t* bytes = nullptr;
+
+  if (byte == kUint16Size) {
+    uint16_t value = 0;
+    if (!ReadBytes(sizeof(value), bytes)) {
+      return false;
+    }
+    memcpy(&value, bytes, sizeof(value));
+    size = value;
+    return true;
+  }
+
+  uint32_t value = 0;
+  if (!ReadBytes(sizeof(value), bytes)) {
+    return false;
+  }
+  memcpy(&value, bytes, sizeof(value));
+  size = value;
+  return true;
+}
+
+// Padding is relative to the start of the message.
+bool StandardMessageReader::Align(size_t alignment) {
+  const size_t padding = (alignment - offset_ % alignment) % alignment;
+  const uint8_t* bytes = nullptr;
+  return ReadBytes(padding, bytes);
+}
+
+bool StandardMessageReader::ReadValue(StandardValue& value) {
+  uint8_t type = 0;
+
+  if (!ReadByte(type) ||
+      type > static_cast<uint8_t>(StandardValue::Type::kFloat32List)) {
+    return false;
+  }
+
+  value = {};
+  value.type = static_cast<StandardValue::Type>(type);
+
+  const uint8_t* bytes = nullptr;
+
+  switch (value.type) {
+    case StandardValue::Type::kNull:
+    case StandardValue::Type::kTrue:
+    case StandardValue::Type::kFalse:
+      return true;
+    case StandardValue::Type::kInt32: {
+      int32_t int_value = 0;
+      if (!ReadBytes(sizeof(int_value), bytes)) {
+        return false;
+      }
+      memcpy(&int_value, bytes, sizeof(int_value));
+      value.int_value = int_value;
+      return true;
+    }
+    case StandardValue::Type::kInt64:
+      if (!ReadBytes(sizeof(value.int_value), bytes)) {
+        return false;
+      }
+      memcpy(&value.int_value, bytes, sizeof(value.int_value));
+      return true;
+    case StandardValue::Type::kFloat64:
+      if (!Align(sizeof(value.float_value)) ||
+          !ReadBytes(sizeof(value.float_value), bytes)) {
+        return false;
+      }
+      memcpy(&value.float_value, bytes, sizeof(value.float_value));
+      return true;
+    case StandardValue::Type::kLargeInt:
+    case StandardValue::Type::kString:
+      return ReadSize(value.size) && ReadBytes(value.size, value.data);
+    case StandardValue::Type::kList:
+    case StandardValue::Type::kMap:
+      return ReadSize(value.size);
+    case StandardValue::Type::kUint8List:
+    case StandardValue::Type::kInt32List:
+    case StandardValue::Type::kInt64List:
+    case StandardValue::Type::kFloat32List:
+    case StandardValue::Type::kFloat64List: {
+      const size_t element_size = GetElementSize(value.type);
+      if (!ReadSize(value.size) || !Align(element_size) ||
+          value.size > (size_ - offset_) / element_size) {
+        return false;
+      }
+      return ReadBytes(value.size * element_size, value.data);
+    }
+  }
+
+  return false;
+}
+
+// Iterates instead of recursing so a hostile message cannot exhaust the
+// stack. |pending| counts the values of enclosing lists and maps left to
+// read.
+bool StandardMessageReader::SkipValue(const StandardValue& value) {
+  size_t pending = 0;
+  StandardValue nested = value;
+
+  while (true) {
+    if (nested.type == StandardValue::Type::kList) {
+      pending += nested.size;
+    } else if (nested.type == StandardValue::Type::kMap) {
+      pending += nested.size * 2;
+    }
+
+    if (pending == 0) {
+      return true;
+    }
+
+    if (!ReadValue(nested)) {
+      return false;
+    }
+    pending--;
+  }
+}
+
+bool StandardMessageReader::ReadValueOfType(StandardValue::Type type,
+                                            StandardValue& value) {
+  return ReadValue(value) && value.type == type;
+}
+
+bool StandardMessageReader::ReadEnvelope(bool& success) {
+  uint8_t envelope = 0;
+
+  if (!ReadByte(envelope) || envelope > 1) {
+    return false;
+  }
+
+  success = envelope == 0;
+  return true;
+}
+
+StandardMessageWriter::StandardMessageWriter(std::vector<uint8_t>& buffer)
+    : buffer_(buffer), start_(buffer.size()) {}
+
+StandardMessageWriter::~StandardMessageWriter() = default;
+
+void StandardMessageWriter::WriteType(StandardValue::Type type) {
+  buffer_.push_back(static_cast<uint8_t>(type));
+}
+
+void StandardMessageWriter::WriteBytes(const void* bytes, size_t count) {
+  const uint8_t* begin = static_cast<const uint8_t*>(bytes);
+  buffer_.insert(buffer_.end(), begin, begin + count);
+}
+
+void StandardMessageWriter::WriteSize(size_t size) {
+  if (size <= kMaxInlineSize) {
+    buffer_.push_back(static_cast<uint8_t>(size));
+  } else if (size <= std::numeric_limits<uint16_t>::max()) {
+    const uint16_t value = static_cast<uint16_t>(size);
+    buffer_.push_back(kUint16Size);
+    WriteBytes(&value, sizeof(value));
+  } else {
+    const uint32_t value = static_cast<uint32_t>(size);
+    buffer_.push_back(kUint32Size);
+    WriteBytes(&value, sizeof(value));
+  }
+}
+
+void StandardMessageWriter::Align(size_t alignment) {
+  const size_t offset = buffer_.size() - start_;
+  const size_t padding = (alignment - offset % alignment) % alignment;
+  buffer_.insert(buffer_.end(), padding, 0);
+}
+
+void StandardMessageWriter::WriteNull() {
+  WriteType(StandardValue::Type::kNull);
+}
+
+void StandardMessageWriter::WriteBool(bool value) {
+  WriteType(value ? StandardValue::Type::kTrue : StandardValue::Type::kFalse);
+}
+
+void StandardMessageWriter::WriteInt(int64_t value) {
+  if (value >= std::numeric_limits<int32_t>::min() &&
+      value <= std::numeric_limits<int32_t>::max()) {
+    const int32_t int32_value = static_cast<int32_t>(value);
+    WriteType(StandardValue::Type::kInt32);
+    WriteBytes(&int32_value, sizeof(int32_value));
+    return;
+  }
+
+  WriteType(StandardValue::Type::kInt64);
+  WriteBytes(&value, sizeof(value));
+}
+
+void StandardMessageWriter::WriteDouble(double value) {
+  WriteType(StandardValue::Type::kFloat64);
+  Align(sizeof(value));
+  WriteBytes(&value, sizeof(value));
+}
+
+void StandardMessageWriter::WriteString(const char* string) {
+  WriteString(string, strlen(string));
+}
+
+void StandardMessageWriter::WriteString(const char* data, size_t size) {
+  WriteType(StandardValue::Type::kString);
+  WriteSize(size);
+  WriteBytes(data, size);
+}
+
+void StandardMessageWriter::WriteUint8List(const uint8_t* elements,
+                                           size_t count) {
+  WriteType(StandardValue::Type::kUint8List);
+  WriteSize(count);
+  WriteBytes(elements, count);
+}
+
+void StandardMessageWriter::WriteInt32List(const int32_t* elements,
+                                           size_t count) {
+  WriteType(StandardValue::Type::kInt32List);
+  WriteSize(count);
+  Align(sizeof(*elements));
+  WriteBytes(elements, count * sizeof(*elements));
+}
+
+void StandardMessageWriter::WriteInt64List(const int64_t* elements,
+                                           size_t count) {
+  WriteType(StandardValue::Type::kInt64List);
+  WriteSize(count);
+  Align(sizeof(*elements));
+  WriteBytes(elements, count * sizeof(*elements));
+}
+
+void StandardMessageWriter::WriteFloat32List(const float* elements,
+                                             size_t count) {
+  WriteType(StandardValue::Type::kFloat32List);
+  WriteSize(count);
+  Align(sizeof(*elements));
+  WriteBytes(elements, count * sizeof(*elements));
+}
+
+void StandardMessageWriter::WriteFloat64List(const double* elements,
+                                             size_t count) {
+  WriteType(StandardValue::Type::kFloat64List);
+  WriteSize(count);
+  Align(sizeof(*elements));
+  WriteBytes(elements, count * sizeof(*elements));
+}
+
+void StandardMessageWriter::WriteListHeader(size_t count) {
+  WriteType(StandardValue::Type::kList);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::WriteMapHeader(size_t count) {
+  WriteType(StandardValue::Type::kMap);
+  WriteSize(count);
+}
+
+void StandardMessageWriter::WriteSuccessEnvelope() {
+  buffer_.push_back(0);
+}
+
+void StandardMessageWriter::WriteErrorEnvelope(const char* code,
+                                               const char* message) {
+  buffer_.push_back(1);
+  WriteString(code);
+  if (message) {
+    WriteString(message);
+  } else {
+    WriteNull();
+  }
+  WriteNull();
+}
+
+}  // namespace flutter
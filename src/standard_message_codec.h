@@ -0,0 +1,167 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cstring>
+#include <vector>
+
+#include "macros.h"
+
+namespace flutter {
+
+// A value of the framework's StandardMessageCodec as it sits in a message.
+// Strings and typed lists point into the message instead of being copied out
+// of it. Lists and maps only carry their size. Their elements, keys and
+// values alternating for maps, are the values read after them.
+struct StandardValue {
+  // The type bytes of the wire format.
+  enum class Type : uint8_t {
+    kNull = 0,
+    kTrue = 1,
+    kFalse = 2,
+    kInt32 = 3,
+    kInt64 = 4,
+    kLargeInt = 5,
+    kFloat64 = 6,
+    kString = 7,
+    kUint8List = 8,
+    kInt32List = 9,
+    kInt64List = 10,
+    kFloat64List = 11,
+    kList = 12,
+    kMap = 13,
+    kFloat32List = 14,
+  };
+
+  Type type = Type::kNull;
+  // kInt32 and kInt64.
+  int64_t int_value = 0;
+  // kFloat64.
+  double float_value = 0.0;
+  // The UTF-8 bytes of strings and large ints, or the first element of typed
+  // lists. Typed list elements are aligned relative to the start of the
+  // message, not necessarily in memory, so read them with |GetElement|.
+  const uint8_t* data = nullptr;
+  // Bytes of strings and large ints, and elements of lists and maps.
+  size_t size = 0;
+
+  bool IsString(const char* string) const {
+    return type == Type::kString && size == strlen(string) &&
+           memcmp(data, string, size) == 0;
+  }
+
+  template <class Element>
+  Element GetElement(size_t index) const {
+    Element element;
+    memcpy(&element, data + index * sizeof(Element), sizeof(Element));
+    return element;
+  }
+};
+
+// Reads values of the StandardMessageCodec one after the other, straight from
+// the buffer of a message. The buffer must outlive the values read from it.
+//
+// StandardMethodCodec calls are the method name followed by the arguments.
+// Replies are an envelope byte, zero for success and one for errors, followed
+// by the result, or by the error code, message and details.
+class StandardMessageReader {
+ public:
+  StandardMessageReader(const uint8_t* data, size_t size);
+
+  ~StandardMessageReader();
+
+  // Returns false if the message is malformed or has no more values.
+  bool ReadValue(StandardValue& value);
+
+  // Reads |value| along with the elements of lists and maps, discarding them.
+  bool SkipValue(const StandardValue& value);
+
+  // Reads a value and checks it is of |type|.
+  bool ReadValueOfType(StandardValue::Type type, StandardValue& value);
+
+  bool ReadEnvelope(bool& success);
+
+  bool IsAtEnd() const;
+
+ private:
+  const uint8_t* data_;
+  const size_t size_;
+  size_t offset_ = 0;
+
+  bool ReadByte(uint8_t& byte);
+
+  bool ReadSize(size_t& size);
+
+  bool ReadBytes(size_t count, const uint8_t*& bytes);
+
+  bool Align(size_t alignment);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageReader);
+};
+
+// Appends values of the StandardMessageCodec to |buffer|. Reusing one buffer
+// for every message keeps encoding free of allocations once it is large
+// enough.
+class StandardMessageWriter {
+ public:
+  // The message starts at the current end of |buffer|.
+  explicit StandardMessageWriter(std::vector<uint8_t>& buffer);
+
+  ~StandardMessageWriter();
+
+  void WriteNull();
+
+  void WriteBool(bool value);
+
+  // Picks the smallest of kInt32 and kInt64 that fits.
+  void WriteInt(int64_t value);
+
+  void WriteDouble(double value);
+
+  void WriteString(const char* string);
+
+  void WriteString(const char* data, size_t size);
+
+  void WriteUint8List(const uint8_t* elements, size_t count);
+
+  void WriteInt32List(const int32_t* elements, size_t count);
+
+  void WriteInt64List(const int64_t* elements, size_t count);
+
+  void WriteFloat32List(const float* elements, size_t count);
+
+  void WriteFloat64List(const double* elements, size_t count);
+
+  // The |count| elements are written next.
+  void WriteListHeader(size_t count);
+
+  // The |count| keys and values are written next, alternating.
+  void WriteMapHeader(size_t count);
+
+  // The result of a successful method call is written next.
+  void WriteSuccessEnvelope();
+
+  // |message| may be null.
+  void WriteErrorEnvelope(const char* code, const char* message);
+
+ private:
+  std::vector<uint8_t>& buffer_;
+  const size_t start_;
+
+  void WriteType(StandardValue::Type type);
+
+  void WriteSize(size_t size);
+
+  void WriteBytes(const void* bytes, size_t count);
+
+  void Align(size_t alignment);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(StandardMessageWriter);
+};
+
+}  // namespace flutter
@@ -0,0 +1,300 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "subsurface_compositor.h"
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+
+#include "tracing.h"
+
+namespace flutter {
+
+// GL_RGBA8_OES, the format of the dmabuf presenter's renderbuffers.
+static const uint32_t kBackingStoreFormat = 0x8058;
+
+// More layers than any compositor has planes for, counting the window's own
+// surface. The engine only asks for this many with as many interleaved
+// platform views.
+static const size_t kMaxLayerSurfaces = 8;
+
+SubsurfaceCompositor::SubsurfaceCompositor(wl_compositor* compositor,
+                                           wl_subcompositor* subcompositor,
+                                           wl_surface* root_surface,
+                                           DmabufPresenter& root_presenter,
+                                           PresenterFactory presenter_factory,
+                                           Delegate& delegate)
+    : compositor_(compositor),
+      subcompositor_(subcompositor),
+      root_surface_(root_surface),
+      root_presenter_(root_presenter),
+      presenter_factory_(std::move(presenter_factory)),
+      delegate_(delegate),
+      slots_in_use_(1, false) {}
+
+SubsurfaceCompositor::~SubsurfaceCompositor() {
+  for (auto& layer : layer_surfaces_) {
+    layer.presenter.reset();
+    wl_subsurface_destroy(layer.subsurface);
+    wl_surface_destroy(layer.surface);
+  }
+
+  for (auto& view : platform_views_) {
+    if (view.second.subsurface) {
+      wl_subsurface_destroy(view.second.subsurface);
+    }
+    wl_surface_destroy(view.second.surface);
+  }
+}
+
+wl_surface* SubsurfaceCompositor::CreatePlatformViewSurface(
+    FlutterPlatformViewIdentifier view_id) {
+  std::lock_guard<std::mutex> lock(platform_views_mutex_);
+
+  if (platform_views_.count(view_id) != 0) {
+    FLWAY_ERROR << "Platform view " << view_id << " already has a surface."
+                << std::endl;
+    return nullptr;
+  }
+
+  wl_surface* surface = wl_compositor_create_surface(compositor_);
+  if (!surface) {
+    FLWAY_ERROR << "Could not create a platform view surface." << std::endl;
+    return nullptr;
+  }
+
+  // Input over the view still goes to the engine.
+  wl_region* region = wl_compositor_create_region(compositor_);
+  wl_surface_set_input_region(surface, region);
+  wl_region_destroy(region);
+
+  platform_views_[view_id].surface = surface;
+  return surface;
+}
+
+void SubsurfaceCompositor::DestroyPlatformViewSurface(
+    FlutterPlatformViewIdentifier view_id) {
+  std::lock_guard<std::mutex> lock(platform_views_mutex_);
+
+  auto found = platform_views_.find(view_id);
+  if (found == platform_views_.end()) {
+    return;
+  }
+
+  if (found->second.subsurface) {
+    wl_subsurface_destroy(found->second.subsurface);
+  }
+  wl_surface_destroy(found->second.surface);
+  platform_views_.erase(found);
+}
+
+bool SubsurfaceCompositor::CreateBackingStore(
+    const FlutterBackingStoreConfig& config,
+    FlutterBackingStore& backing_store) {
+  size_t slot = 0;
+  while (slot < slots_in_use_.size() && slots_in_use_[slot]) {
+    slot++;
+  }
+
+  if (slot >= kMaxLayerSurfaces) {
+    FLWAY_ERROR << "Too many layers in one frame." << std::endl;
+    return false;
+  }
+
+  if (slot == slots_in_use_.size()) {
+    slots_in_use_.push_back(false);
+  }
+
+  const uint32_t framebuffer =
+      AcquireSlotFramebuffer(slot, config.size.width, config.size.height);
+  if (framebuffer == 0) {
+    return false;
+  }
+
+  slots_in_use_[slot] = true;
+
+  backing_store.type = kFlutterBackingStoreTypeOpenGL;
+  backing_store.user_data = reinterpret_cast<void*>(slot);
+  backing_store.open_gl.type = kFlutterOpenGLTargetTypeFramebuffer;
+  backing_store.open_gl.framebuffer.target = kBackingStoreFormat;
+  backing_store.open_gl.framebuffer.name = framebuffer;
+  backing_store.open_gl.framebuffer.user_data = nullptr;
+  // The framebuffers belong to the presenters.
+  backing_store.open_gl.framebuffer.destruction_callback = [](void*) {};
+  return true;
+}
+
+bool SubsurfaceCompositor::CollectBackingStore(
+    const FlutterBackingStore& backing_store) {
+  const size_t slot = reinterpret_cast<uintptr_t>(backing_store.user_data);
+  if (slot < slots_in_use_.size()) {
+    slots_in_use_[slot] = false;
+  }
+  return true;
+}
+
+bool SubsurfaceCompositor::PresentLayers(const FlutterLayer** layers,
+                                         size_t layers_count) {
+  FLWAY_TRACE_SCOPE("SubsurfaceCompositor::PresentLayers");
+
+  // Offsets are in buffer pixels and subsurface positions in the window's
+  // surface coordinates.
+  const int32_t scale =
+      delegate_.OnCompositorWillCommitRoot(root_width_, root_height_);
+
+  std::lock_guard<std::mutex> lock(platform_views_mutex_);
+
+  for (auto& surface : layer_surfaces_) {
+    surface.placed = false;
+  }
+  for (auto& view : platform_views_) {
+    view.second.placed = false;
+  }
+
+  placements_.clear();
+  bool root_placed = false;
+  size_t root_index = 0;
+
+  for (size_t i = 0; i < layers_count; i++) {
+    const FlutterLayer& layer = *layers[i];
+    const int32_t x = layer.offset.x / scale;
+    const int32_t y = layer.offset.y / scale;
+
+    if (layer.type == kFlutterLayerContentTypeBackingStore) {
+      const size_t slot =
+          reinterpret_cast<uintptr_t>(layer.backing_store->user_data);
+
+      if (slot == 0) {
+        root_placed = true;
+        root_index = placements_.size();
+        placements_.push_back({root_surface_, nullptr});
+        continue;
+      }
+
+      if (slot > layer_surfaces_.size()) {
+        continue;
+      }
+
+      auto& surface = layer_surfaces_[slot - 1];
+      wl_subsurface_set_position(surface.subsurface, x, y);
+      if (surface.buffer_scale != scale) {
+        wl_surface_set_buffer_scale(surface.surface, scale);
+        surface.buffer_scale = scale;
+      }
+      // Cached by the compositor until the window's surface is committed.
+      surface.presenter->Present(nullptr, 0);
+      surface.visible = true;
+      surface.placed = true;
+      placements_.push_back({surface.surface, surface.subsurface});
+      continue;
+    }
+
+    // Views nobody created a surface for yet are left out.
+    auto found = platform_views_.find(layer.platform_view->identifier);
+    if (found == platform_views_.end()) {
+      continue;
+    }
+
+    auto& view = found->second;
+    if (!view.subsurface) {
+      view.subsurface = wl_subcompositor_get_subsurface(
+          subcompositor_, view.surface, root_surface_);
+      // The view's owner presents whenever its content changes.
+      wl_subsurface_set_desync(view.subsurface);
+    }
+    wl_subsurface_set_position(view.subsurface, x, y);
+    // Applied by the next commit of the view's owner.
+    if (view.buffer_scale != scale) {
+      wl_surface_set_buffer_scale(view.surface, scale);
+      view.buffer_scale = scale;
+    }
+    view.placed = true;
+    placements_.push_back({view.surface, view.subsurface});
+  }
+
+  // The window's surface has to be mapped for any layer to show.
+  if (!root_placed) {
+    ClearRoot();
+    placements_.insert(placements_.begin(), {root_surface_, nullptr});
+  }
+
+  // Layers come bottom to top. Stack them outwards from the window's surface.
+  for (size_t i = root_index; i > 0; i--) {
+    wl_subsurface_place_below(placements_[i - 1].subsurface,
+                              placements_[i].surface);
+  }
+  for (size_t i = root_index + 1; i < placements_.size(); i++) {
+    wl_subsurface_place_above(placements_[i].subsurface,
+                              placements_[i - 1].surface);
+  }
+
+  for (auto& surface : layer_surfaces_) {
+    if (surface.visible && !surface.placed) {
+      wl_surface_attach(surface.surface, nullptr, 0, 0);
+      wl_surface_commit(surface.surface);
+      surface.visible = false;
+    }
+  }
+
+  // Unmaps the surfaces of views that left the frame right away.
+  for (auto& view : platform_views_) {
+    if (view.second.subsurface && !view.second.placed) {
+      wl_subsurface_destroy(view.second.subsurface);
+      view.second.subsurface = nullptr;
+    }
+  }
+
+  // Applies the state of every synchronized subsurface along with it.
+  return root_presenter_.Present(nullptr, 0);
+}
+
+uint32_t SubsurfaceCompositor::AcquireSlotFramebuffer(size_t slot,
+                                                      int width,
+                                                      int height) {
+  if (slot == 0) {
+    root_width_ = width;
+    root_height_ = height;
+    return root_presenter_.AcquireFramebuffer(width, height);
+  }
+
+  while (layer_surfaces_.size() < slot) {
+    LayerSurface layer;
+    layer.surface = wl_compositor_create_surface(compositor_);
+    layer.subsurface = wl_subcompositor_get_subsurface(
+        subcompositor_, layer.surface, root_surface_);
+
+    // Input over the layer still goes to the window's surface.
+    wl_region* region = wl_compositor_create_region(compositor_);
+    wl_surface_set_input_region(layer.surface, region);
+    wl_region_destroy(region);
+
+    layer.presenter = presenter_factory_(layer.surface);
+    layer_surfaces_.push_back(std::move(layer));
+  }
+
+  auto& layer = layer_surfaces_[slot - 1];
+  if (!layer.presenter) {
+    FLWAY_ERROR << "Could not present layer " << slot << std::endl;
+    return 0;
+  }
+
+  return layer.presenter->AcquireFramebuffer(width, height);
+}
+
+// Used when no backing store of the frame went to the window's surface, which
+// then shows nothing but the layers above and below it.
+void SubsurfaceCompositor::ClearRoot() {
+  const uint32_t framebuffer =
+      root_presenter_.AcquireFramebuffer(root_width_, root_height_);
+  if (framebuffer == 0) {
+    return;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glClearColor(0.0, 0.0, 0.0, 0.0);
+  glClear(GL_COLOR_BUFFER_BIT);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+}  // namespace flutter
@@ -0,0 +1,129 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <wayland-client.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "dmabuf_presenter.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Hands the layers of a frame to the compositor instead of flattening them on
+// the GPU. Each backing store the engine renders into becomes a synchronized
+// subsurface of the window with buffers of its own, and each platform view is
+// a desynchronized subsurface whose owner attaches buffers at its own pace.
+// The compositor is then free to blend the layers, or to assign them to
+// hardware planes, and a video playing under the UI does not make the engine
+// redraw anything.
+//
+// Backing stores are matched to surfaces in the order the engine creates them
+// within a frame. The first one is rendered into the window's own surface. The
+// engine stacks the layers, and subsurfaces are placed above or below the
+// window's surface accordingly. Layers and platform views get the buffer scale
+// of the window's surface, so their owners render at the same scale. Platform
+// view mutations such as clips and transforms are not applied.
+class SubsurfaceCompositor {
+ public:
+  class Delegate {
+   public:
+    // Invoked on the raster thread before the layers of a frame are placed,
+    // ahead of the commit of the window's surface that applies every layer.
+    // |width| and |height| are the size of the buffer attached to it. Returns
+    // the buffer scale the window's surface is committed with.
+    virtual int32_t OnCompositorWillCommitRoot(int width, int height) = 0;
+  };
+
+  // Creates the presenter for a layer's surface.
+  using PresenterFactory =
+      std::function<std::unique_ptr<DmabufPresenter>(wl_surface* surface)>;
+
+  // |root_presenter| presents into |root_surface|, the window's own surface.
+  SubsurfaceCompositor(wl_compositor* compositor,
+                       wl_subcompositor* subcompositor,
+                       wl_surface* root_surface,
+                       DmabufPresenter& root_presenter,
+                       PresenterFactory presenter_factory,
+                       Delegate& delegate);
+
+  ~SubsurfaceCompositor();
+
+  // Creates the surface the platform view |view_id| is shown in. Its owner
+  // attaches buffers and commits it whenever it likes. The surface is only
+  // mapped while the engine places the view in a frame. Safe to call from any
+  // thread. Returns null if the view already has a surface.
+  wl_surface* CreatePlatformViewSurface(FlutterPlatformViewIdentifier view_id);
+
+  void DestroyPlatformViewSurface(FlutterPlatformViewIdentifier view_id);
+
+  // Invoked by the engine on the raster thread with the onscreen context
+  // current.
+  bool CreateBackingStore(const FlutterBackingStoreConfig& config,
+                          FlutterBackingStore& backing_store);
+
+  bool CollectBackingStore(const FlutterBackingStore& backing_store);
+
+  bool PresentLayers(const FlutterLayer** layers, size_t layers_count);
+
+ private:
+  // A subsurface showing backing stores.
+  struct LayerSurface {
+    wl_surface* surface = nullptr;
+    wl_subsurface* subsurface = nullptr;
+    std::unique_ptr<DmabufPresenter> presenter;
+    int32_t buffer_scale = 1;
+    // Whether a buffer is attached.
+    bool visible = false;
+    // Part of the frame being presented.
+    bool placed = false;
+  };
+
+  struct PlatformView {
+    wl_surface* surface = nullptr;
+    // Only exists while the view is part of the frame.
+    wl_subsurface* subsurface = nullptr;
+    int32_t buffer_scale = 1;
+    bool placed = false;
+  };
+
+  // Where a layer of the frame being presented ended up.
+  struct Placement {
+    wl_surface* surface = nullptr;
+    // Null for the window's surface.
+    wl_subsurface* subsurface = nullptr;
+  };
+
+  wl_compositor* compositor_;
+  wl_subcompositor* subcompositor_;
+  wl_surface* root_surface_;
+  DmabufPresenter& root_presenter_;
+  PresenterFactory presenter_factory_;
+  Delegate& delegate_;
+  // Raster thread only. Backing stores in slot zero are rendered into the
+  // window's surface, those in slot N into |layer_surfaces_[N - 1]|.
+  std::vector<LayerSurface> layer_surfaces_;
+  std::vector<bool> slots_in_use_;
+  int root_width_ = 0;
+  int root_height_ = 0;
+  std::vector<Placement> placements_;
+  std::mutex platform_views_mutex_;
+  std::unordered_map<FlutterPlatformViewIdentifier, PlatformView>
+      platform_views_;
+
+  uint32_t AcquireSlotFramebuffer(size_t slot, int width, int height);
+
+  void ClearRoot();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(SubsurfaceCompositor);
+};
+
+}  // namespace flutter
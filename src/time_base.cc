@@ -0,0 +1,49 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "time_base.h"
+
+namespace flutter {
+
+static uint64_t GetClockNanos(clockid_t clock) {
+  struct timespec spec = {};
+  if (::clock_gettime(clock, &spec) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(spec.tv_sec) * kNanosPerSecond + spec.tv_nsec;
+}
+
+uint64_t GetCurrentTimeNanos() {
+  return GetClockNanos(kTimeBaseClock);
+}
+
+uint64_t ClockTimeToTimeBase(clockid_t clock, uint64_t clock_nanos) {
+  if (clock == kTimeBaseClock) {
+    return clock_nanos;
+  }
+
+  const uint64_t clock_now = GetClockNanos(clock);
+  const uint64_t now = GetCurrentTimeNanos();
+  return now - (clock_now - clock_nanos);
+}
+
+uint64_t WaylandEventTimeToTimeBase(uint32_t time_millis) {
+  const uint64_t now = GetCurrentTimeNanos();
+  const uint32_t now_millis = static_cast<uint32_t>(now / kNanosPerMilli);
+
+  // Unsigned wraparound gives the age of the event even across a rollover of
+  // the 32 bit millisecond counter.
+  const uint32_t age_millis = now_millis - time_millis;
+
+  // More than half the range means the event is from the future.
+  if (age_millis > UINT32_MAX / 2) {
+    return now;
+  }
+
+  // Keep the sub-millisecond part of now so events are not reported as older
+  // than they are.
+  return now - static_cast<uint64_t>(age_millis) * kNanosPerMilli;
+}
+
+}  // namespace flutter
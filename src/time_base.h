@@ -0,0 +1,33 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+namespace flutter {
+
+// Every timestamp in the embedder is in nanoseconds on CLOCK_MONOTONIC. This
+// is the clock behind |FlutterEngineGetCurrentTime|, so task target times,
+// vsync baselines and input events can be compared with each other and with
+// the times the engine reports.
+static const clockid_t kTimeBaseClock = CLOCK_MONOTONIC;
+
+static const uint64_t kNanosPerSecond = 1000000000;
+static const uint64_t kNanosPerMilli = 1000000;
+static const uint64_t kNanosPerMicro = 1000;
+
+uint64_t GetCurrentTimeNanos();
+
+// Moves a time read from |clock| on to the time base by measuring the offset
+// between the two clocks now.
+uint64_t ClockTimeToTimeBase(clockid_t clock, uint64_t clock_nanos);
+
+// Wayland input event times are milliseconds on the compositor's monotonic
+// clock, truncated to 32 bits. The current time is used to recover the high
+// bits. Times that appear to be in the future are clamped to now.
+uint64_t WaylandEventTimeToTimeBase(uint32_t time_millis);
+
+}  // namespace flutter
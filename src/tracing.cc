@@ -0,0 +1,194 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "tracing.h"
+
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+
+namespace flutter {
+
+struct TraceSpan {
+  const char* name = nullptr;
+  uint64_t begin_nanos = 0;
+  uint64_t end_nanos = 0;
+  uint32_t thread_id = 0;
+  // Set once the fields above are written. Slots that were claimed but not
+  // yet filled in when tracing stopped are skipped.
+  std::atomic_bool committed{false};
+};
+
+struct TraceThread {
+  uint32_t thread_id = 0;
+  char name[16] = {};
+  std::atomic_bool committed{false};
+};
+
+// Threads beyond this still record spans but are left unnamed.
+static const size_t kMaxTraceThreads = 64;
+
+// The buffer is never freed. A thread that read |g_tracing_enabled| just
+// before tracing stopped may still be writing to it.
+static std::atomic_bool g_tracing_enabled(false);
+static TraceSpan* g_spans = nullptr;
+static size_t g_capacity = 0;
+static std::atomic<size_t> g_next_span(0);
+static std::atomic<size_t> g_dropped_spans(0);
+static TraceThread g_threads[kMaxTraceThreads];
+static std::atomic<size_t> g_next_thread(0);
+
+static uint32_t RegisterThread() {
+  const uint32_t thread_id = ::syscall(SYS_gettid);
+
+  const size_t index = g_next_thread.fetch_add(1, std::memory_order_relaxed);
+  if (index < kMaxTraceThreads) {
+    TraceThread& thread = g_threads[index];
+    thread.thread_id = thread_id;
+    ::prctl(PR_GET_NAME, thread.name, 0, 0, 0);
+    thread.name[sizeof(thread.name) - 1] = '\0';
+    thread.committed.store(true, std::memory_order_release);
+  }
+
+  return thread_id;
+}
+
+static uint32_t GetTraceThreadId() {
+  thread_local uint32_t thread_id = RegisterThread();
+  return thread_id;
+}
+
+bool StartTracing(size_t capacity) {
+  if (g_spans != nullptr) {
+    FLWAY_ERROR << "Tracing can only be started once." << std::endl;
+    return false;
+  }
+
+  // Value initialization touches every slot so the pages are faulted in here
+  // and not while recording.
+  g_spans = new TraceSpan[capacity]();
+  g_capacity = capacity;
+  g_tracing_enabled = true;
+  return true;
+}
+
+bool IsTracingEnabled() {
+  return g_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void RecordTraceSpan(const char* name,
+                     uint64_t begin_nanos,
+                     uint64_t end_nanos) {
+  if (!IsTracingEnabled()) {
+    return;
+  }
+
+  const uint32_t thread_id = GetTraceThreadId();
+
+  const size_t index = g_next_span.fetch_add(1, std::memory_order_relaxed);
+  if (index >= g_capacity) {
+    g_dropped_spans.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  TraceSpan& span = g_spans[index];
+  span.name = name;
+  span.begin_nanos = begin_nanos;
+  span.end_nanos = end_nanos;
+  span.thread_id = thread_id;
+  span.committed.store(true, std::memory_order_release);
+}
+
+// Span names are literals from this code base, but escape them anyway so a
+// stray character cannot corrupt the file.
+static void WriteJSONString(std::ostream& stream, const char* string) {
+  stream << '"';
+  for (const char* c = string; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      stream << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      stream << ' ';
+    } else {
+      stream << *c;
+    }
+  }
+  stream << '"';
+}
+
+// Chrome trace timestamps are microseconds. Keep the sub-microsecond part.
+static void WriteMicros(std::ostream& stream, uint64_t nanos) {
+  stream << nanos / kNanosPerMicro << '.';
+  const uint64_t remainder = nanos % kNanosPerMicro;
+  stream << remainder / 100 << (remainder / 10) % 10 << remainder % 10;
+}
+
+bool StopTracingAndWrite(const std::string& path) {
+  if (g_spans == nullptr) {
+    return false;
+  }
+
+  g_tracing_enabled = false;
+
+  std::ofstream stream(path, std::ios::out | std::ios::trunc);
+  if (!stream.is_open()) {
+    FLWAY_ERROR << "Could not open the trace file " << path << std::endl;
+    return false;
+  }
+
+  const pid_t pid = ::getpid();
+  const size_t count = std::min(
+      g_capacity, g_next_span.load(std::memory_order_relaxed));
+  const size_t thread_count = std::min(
+      kMaxTraceThreads, g_next_thread.load(std::memory_order_relaxed));
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first = true;
+
+  for (size_t i = 0; i < thread_count; i++) {
+    const TraceThread& thread = g_threads[i];
+    if (!thread.committed.load(std::memory_order_acquire)) {
+      continue;
+    }
+    stream << (first ? "\n" : ",\n");
+    first = false;
+    stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+           << ",\"tid\":" << thread.thread_id << ",\"args\":{\"name\":";
+    WriteJSONString(stream, thread.name);
+    stream << "}}";
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const TraceSpan& span = g_spans[i];
+    if (!span.committed.load(std::memory_order_acquire)) {
+      continue;
+    }
+    stream << (first ? "\n" : ",\n");
+    first = false;
+    stream << "{\"name\":";
+    WriteJSONString(stream, span.name);
+    stream << ",\"cat\":\"embedder\",\"ph\":\"X\",\"ts\":";
+    WriteMicros(stream, span.begin_nanos);
+    stream << ",\"dur\":";
+    WriteMicros(stream, span.end_nanos - span.begin_nanos);
+    stream << ",\"pid\":" << pid << ",\"tid\":" << span.thread_id << "}";
+  }
+
+  stream << "\n]}" << std::endl;
+
+  if (!stream.good()) {
+    FLWAY_ERROR << "Could not write the trace file " << path << std::endl;
+    return false;
+  }
+
+  FLWAY_LOG << "Wrote " << count << " trace spans to " << path << ", dropped "
+            << g_dropped_spans.load() << std::endl;
+  return true;
+}
+
+}  // namespace flutter
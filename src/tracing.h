@@ -0,0 +1,66 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "macros.h"
+#include "time_base.h"
+
+namespace flutter {
+
+// Embedder side spans for offline inspection. All storage is allocated when
+// tracing starts. Recording a span claims a slot with a single atomic
+// increment and never allocates, locks or blocks. Once the buffer is full,
+// further spans are dropped and counted.
+//
+// Span times are on the time base of |time_base.h|, which is the clock the
+// engine stamps its own timeline events with, so a trace written here lines
+// up with one captured from the engine without any conversion.
+bool StartTracing(size_t capacity);
+
+bool IsTracingEnabled();
+
+// |name| must outlive the process. Use string literals.
+void RecordTraceSpan(const char* name,
+                     uint64_t begin_nanos,
+                     uint64_t end_nanos);
+
+// Stops recording and writes everything recorded so far to |path| in the
+// Chrome trace event JSON format, which both chrome://tracing and the
+// Perfetto UI open. Must only be called after the threads that record spans
+// have stopped.
+bool StopTracingAndWrite(const std::string& path);
+
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(name),
+        begin_nanos_(IsTracingEnabled() ? GetCurrentTimeNanos() : 0) {}
+
+  ~TraceScope() {
+    if (begin_nanos_ != 0) {
+      RecordTraceSpan(name_, begin_nanos_, GetCurrentTimeNanos());
+    }
+  }
+
+ private:
+  const char* name_;
+  const uint64_t begin_nanos_;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(TraceScope);
+};
+
+#define __FLWAY_TRACE_CONCAT(a, b) a##b
+#define __FLWAY_TRACE_NAME(line) __FLWAY_TRACE_CONCAT(__flway_trace_, line)
+
+// Records a span covering the rest of the enclosing scope.
+#define FLWAY_TRACE_SCOPE(name) \
+  ::flutter::TraceScope __FLWAY_TRACE_NAME(__LINE__)(name)
+
+}  // namespace flutter
@@ -4,10 +4,13 @@
 
 #include "utils.h"
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <sstream>
 
+#include "aot_snapshot.h"
+
 namespace flutter {
 
 static std::string GetExecutablePath() {
@@ -46,12 +49,39 @@ bool FileExistsAtPath(const std::string& path) {
   return ::access(path.c_str(), R_OK) == 0;
 }
 
+void PrefetchFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  ::close(fd);
+}
+
+void EvictFile(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return;
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
 bool FlutterAssetBundleIsValid(const std::string& bundle_path) {
   if (!FileExistsAtPath(bundle_path)) {
     FLWAY_ERROR << "Bundle directory does not exist." << std::endl;
     return false;
   }
 
+  // Engines built in profile or release mode only run AOT compiled code.
+  if (FlutterEngineRunsAOTCompiledDartCode()) {
+    if (!AOTSnapshot::ExistsInBundle(bundle_path)) {
+      FLWAY_ERROR << "AOT snapshots do not exist." << std::endl;
+      return false;
+    }
+    return true;
+  }
+
   if (!FileExistsAtPath(bundle_path + std::string{"/kernel_blob.bin"})) {
     FLWAY_ERROR << "Kernel blob does not exist." << std::endl;
     return false;
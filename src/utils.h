@@ -14,6 +14,15 @@ std::string GetExecutableDirectory();
 
 bool FileExistsAtPath(const std::string& path);
 
+// Start reading |path| into the page cache in the background. Files the
+// engine reads or maps by itself are then already resident when it gets to
+// them, and the kernel can read them in large sequential chunks.
+void PrefetchFile(const std::string& path);
+
+// Drop the page cache pages of |path| so the next read comes from disk. Only
+// clean pages are dropped.
+void EvictFile(const std::string& path);
+
 bool FlutterAssetBundleIsValid(const std::string& bundle_path);
 
 }  // namespace flutter
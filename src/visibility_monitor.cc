@@ -0,0 +1,119 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "visibility_monitor.h"
+
+#include "time_base.h"
+
+namespace flutter {
+
+// Compositors delay frame callbacks by a few refreshes at most while they are
+// busy. Anything longer than this means the surface is not being repainted.
+static const uint64_t kFrameStarvationNanos = kNanosPerSecond / 2;
+
+// Throttled frame callbacks come in at most a few times a second, so this
+// many on time in a row means the compositor repaints the surface again.
+static const size_t kOnTimeProbesToRecover = 3;
+
+VisibilityMonitor::VisibilityMonitor(EventLoop& loop,
+                                     ChangeCallback on_change,
+                                     ProbeCallback on_probe)
+    : on_change_(std::move(on_change)),
+      on_probe_(std::move(on_probe)),
+      starvation_timer_(loop, [this]() { OnStarved(); }) {}
+
+VisibilityMonitor::~VisibilityMonitor() = default;
+
+bool VisibilityMonitor::IsVisible() const {
+  return visible_;
+}
+
+// Becoming visible again also gives the compositor another chance to deliver
+// frame callbacks.
+void VisibilityMonitor::SetSuspended(bool suspended) {
+  suspended_ = suspended;
+  if (!suspended_) {
+    ClearStarved();
+  }
+  Update();
+}
+
+void VisibilityMonitor::SetOnOutput(bool on_output) {
+  on_output_ = on_output;
+  if (on_output_) {
+    ClearStarved();
+  }
+  Update();
+}
+
+void VisibilityMonitor::OnFrameRequested() {
+  if (starvation_timer_armed_ || starved_) {
+    return;
+  }
+
+  starvation_timer_armed_ = starvation_timer_.ArmAt(GetCurrentTimeNanos() +
+                                                    kFrameStarvationNanos);
+}
+
+void VisibilityMonitor::OnFrameDone() {
+  if (starvation_timer_armed_) {
+    starvation_timer_.Disarm();
+    starvation_timer_armed_ = false;
+  }
+
+  if (!starved_) {
+    return;
+  }
+
+  // The first frame callback after starving answers the engine's last
+  // commit, which is late by definition.
+  if (probe_nanos_ != 0 &&
+      GetCurrentTimeNanos() - probe_nanos_ <= kFrameStarvationNanos) {
+    on_time_probes_++;
+  } else {
+    on_time_probes_ = 0;
+  }
+
+  if (on_time_probes_ >= kOnTimeProbesToRecover) {
+    ClearStarved();
+    Update();
+    return;
+  }
+
+  Probe();
+}
+
+void VisibilityMonitor::OnStarved() {
+  starvation_timer_armed_ = false;
+  starved_ = true;
+  probe_nanos_ = 0;
+  on_time_probes_ = 0;
+  Update();
+}
+
+void VisibilityMonitor::ClearStarved() {
+  starved_ = false;
+  probe_nanos_ = 0;
+  on_time_probes_ = 0;
+}
+
+// Probing once per frame callback keeps to the rate the compositor throttles
+// the surface to, and stops entirely if it withholds frame callbacks.
+void VisibilityMonitor::Probe() {
+  probe_nanos_ = GetCurrentTimeNanos();
+  on_probe_();
+}
+
+void VisibilityMonitor::Update() {
+  const bool visible = !suspended_ && on_output_ && !starved_;
+
+  if (visible == visible_) {
+    return;
+  }
+
+  visible_ = visible;
+  on_change_(visible_);
+}
+
+}  // namespace flutter
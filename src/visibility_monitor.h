@@ -0,0 +1,76 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <functional>
+
+#include "event_loop.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Works out whether anyone can see a window. Wayland has no occlusion events,
+// so a window is taken to be hidden when the shell suspends it, when it has
+// left every output, or when the compositor withholds the frame callback the
+// engine is waiting for for too long, which it does for minimized and fully
+// covered surfaces. Must only be used on the event loop thread.
+//
+// Some compositors throttle the frame callbacks of hidden surfaces instead of
+// withholding them, so frame callbacks arriving again only make a starved
+// window visible once a few in a row are on time. The paused engine commits
+// nothing, so a starved window is probed for those frame callbacks.
+class VisibilityMonitor {
+ public:
+  using ChangeCallback = std::function<void(bool visible)>;
+
+  // Commits the surface with a frame callback and nothing else.
+  using ProbeCallback = std::function<void()>;
+
+  // Windows start out visible.
+  VisibilityMonitor(EventLoop& loop,
+                    ChangeCallback on_change,
+                    ProbeCallback on_probe);
+
+  ~VisibilityMonitor();
+
+  bool IsVisible() const;
+
+  void SetSuspended(bool suspended);
+
+  void SetOnOutput(bool on_output);
+
+  // The engine asked for a frame while the compositor has yet to say it is
+  // ready for one.
+  void OnFrameRequested();
+
+  // The compositor is ready for a new frame.
+  void OnFrameDone();
+
+ private:
+  ChangeCallback on_change_;
+  ProbeCallback on_probe_;
+  Timer starvation_timer_;
+  bool starvation_timer_armed_ = false;
+  bool suspended_ = false;
+  bool on_output_ = true;
+  bool starved_ = false;
+  bool visible_ = true;
+  // While starved, when the last probe was made, or zero if none is pending,
+  // and the frame callbacks in a row that answered a probe on time.
+  uint64_t probe_nanos_ = 0;
+  size_t on_time_probes_ = 0;
+
+  void OnStarved();
+
+  void ClearStarved();
+
+  void Probe();
+
+  void Update();
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(VisibilityMonitor);
+};
+
+}  // namespace flutter
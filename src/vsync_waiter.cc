@@ -0,0 +1,273 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "vsync_waiter.h"
+
+#include "instrumentation.h"
+#include "time_base.h"
+
+namespace flutter {
+
+// Used until the compositor tells us otherwise.
+static const uint64_t kDefaultRefreshPeriodNanos = kNanosPerSecond / 60;
+
+#define WAITER reinterpret_cast<VsyncWaiter*>(data)
+
+const wl_callback_listener VsyncWaiter::kFrameCallbackListener = {
+    .done = [](void* data, struct wl_callback* callback, uint32_t time)
+        -> void { WAITER->OnFrameDone(callback); },
+};
+
+const wp_presentation_listener VsyncWaiter::kPresentationListener = {
+    .clock_id = [](void* data,
+                   struct wp_presentation* presentation,
+                   uint32_t clock_id) -> void {
+      std::lock_guard<std::mutex> lock(WAITER->mutex_);
+      WAITER->presentation_clock_ = static_cast<clockid_t>(clock_id);
+    },
+};
+
+const wp_presentation_feedback_listener VsyncWaiter::kFeedbackListener = {
+    .sync_output = [](void* data,
+                      struct wp_presentation_feedback* feedback,
+                      struct wl_output* output) -> void {
+      // Nothing to do.
+    },
+
+    .presented = [](void* data,
+                    struct wp_presentation_feedback* feedback,
+                    uint32_t tv_sec_hi,
+                    uint32_t tv_sec_lo,
+                    uint32_t tv_nsec,
+                    uint32_t refresh,
+                    uint32_t seq_hi,
+                    uint32_t seq_lo,
+                    uint32_t flags) -> void {
+      const uint64_t seconds =
+          (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+      WAITER->OnPresented(feedback, seconds * kNanosPerSecond + tv_nsec,
+                          refresh);
+    },
+
+    .discarded = [](void* data, struct wp_presentation_feedback* feedback)
+        -> void { WAITER->OnFeedbackDiscarded(feedback); },
+};
+
+#undef WAITER
+
+VsyncWaiter::VsyncWaiter(wl_surface* surface, wp_presentation* presentation)
+    : surface_(surface),
+      presentation_(presentation),
+      refresh_period_nanos_(kDefaultRefreshPeriodNanos) {
+  if (presentation_) {
+    wp_presentation_add_listener(presentation_, &kPresentationListener, this);
+  }
+}
+
+VsyncWaiter::~VsyncWaiter() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (frame_callback_) {
+    wl_callback_destroy(frame_callback_);
+    frame_callback_ = nullptr;
+  }
+
+  for (auto feedback : feedbacks_) {
+    wp_presentation_feedback_destroy(feedback);
+  }
+  feedbacks_.clear();
+}
+
+void VsyncWaiter::AsyncWaitForVsync(Callback callback) {
+  uint64_t frame_start = 0;
+  uint64_t frame_target = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // The compositor has not consumed the last frame yet. Producing another
+    // one now would only be thrown away.
+    if (frame_callback_ || paused_) {
+      pending_callback_ = std::move(callback);
+      return;
+    }
+
+    frame_start = GetCurrentTimeNanos();
+    frame_target = GetNextVblankLocked(frame_start);
+  }
+
+  RecordTimingEvent(TimingEvent::kVsyncReceived, frame_start, surface_);
+  callback(frame_start, frame_target);
+}
+
+void VsyncWaiter::SetFrameDoneCallback(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  frame_done_callback_ = std::move(callback);
+}
+
+void VsyncWaiter::OnSurfaceWillCommit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  frames_committed_++;
+
+  if (frame_callback_) {
+    frames_superseded_++;
+  } else {
+    frame_callback_ = wl_surface_frame(surface_);
+    wl_callback_add_listener(frame_callback_, &kFrameCallbackListener, this);
+  }
+
+  if (presentation_) {
+    auto feedback = wp_presentation_feedback(presentation_, surface_);
+    wp_presentation_feedback_add_listener(feedback, &kFeedbackListener, this);
+    feedbacks_.insert(feedback);
+  }
+}
+
+void VsyncWaiter::RequestFrameCallback() {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (!frame_callback_) {
+    frame_callback_ = wl_surface_frame(surface_);
+    wl_callback_add_listener(frame_callback_, &kFrameCallbackListener, this);
+  }
+}
+
+size_t VsyncWaiter::GetFramesCommitted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_committed_;
+}
+
+size_t VsyncWaiter::GetFramesSuperseded() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frames_superseded_;
+}
+
+uint64_t VsyncWaiter::GetRefreshPeriodNanos() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return refresh_period_nanos_;
+}
+
+void VsyncWaiter::SetRefreshRate(double refresh_rate) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (refresh_rate <= 0.0 || refresh_period_from_feedback_) {
+    return;
+  }
+
+  refresh_period_nanos_ = static_cast<uint64_t>(kNanosPerSecond / refresh_rate);
+}
+
+// Resuming does not wait for the frame callback, which a compositor that
+// stopped repainting the surface may still be sitting on.
+void VsyncWaiter::SetPaused(bool paused) {
+  Callback pending_callback;
+  uint64_t frame_start = 0;
+  uint64_t frame_target = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    paused_ = paused;
+
+    if (paused_ || !pending_callback_) {
+      return;
+    }
+
+    frame_start = GetCurrentTimeNanos();
+    frame_target = GetNextVblankLocked(frame_start);
+    pending_callback = std::move(pending_callback_);
+    pending_callback_ = nullptr;
+  }
+
+  RecordTimingEvent(TimingEvent::kVsyncReceived, frame_start, surface_);
+  pending_callback(frame_start, frame_target);
+}
+
+bool VsyncWaiter::HasPendingVsync() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_callback_ != nullptr;
+}
+
+void VsyncWaiter::OnFrameDone(wl_callback* callback) {
+  Callback pending_callback;
+  std::function<void()> frame_done_callback;
+  uint64_t frame_start = 0;
+  uint64_t frame_target = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    frame_done_callback = frame_done_callback_;
+
+    if (callback == frame_callback_) {
+      frame_callback_ = nullptr;
+    }
+    wl_callback_destroy(callback);
+
+    frame_start = GetCurrentTimeNanos();
+
+    // Without presentation feedback, the frame callback is the best estimate
+    // of the start of the compositor's repaint cycle.
+    if (!presentation_) {
+      last_vblank_nanos_ = frame_start;
+    }
+
+    frame_target = GetNextVblankLocked(frame_start);
+
+    if (!paused_) {
+      pending_callback = std::move(pending_callback_);
+      pending_callback_ = nullptr;
+    }
+  }
+
+  RecordTimingEvent(TimingEvent::kSwapComplete, frame_start, surface_);
+
+  if (frame_done_callback) {
+    frame_done_callback();
+  }
+
+  if (pending_callback) {
+    RecordTimingEvent(TimingEvent::kVsyncReceived, frame_start, surface_);
+    pending_callback(frame_start, frame_target);
+  }
+}
+
+void VsyncWaiter::OnPresented(struct wp_presentation_feedback* feedback,
+                              uint64_t presentation_time_nanos,
+                              uint32_t refresh_nanos) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  feedbacks_.erase(feedback);
+  wp_presentation_feedback_destroy(feedback);
+
+  last_vblank_nanos_ =
+      ClockTimeToTimeBase(presentation_clock_, presentation_time_nanos);
+  RecordTimingEvent(TimingEvent::kPresented, last_vblank_nanos_, surface_);
+
+  // A refresh of zero means the output does not have a constant rate.
+  if (refresh_nanos != 0) {
+    refresh_period_nanos_ = refresh_nanos;
+    refresh_period_from_feedback_ = true;
+  }
+}
+
+void VsyncWaiter::OnFeedbackDiscarded(
+    struct wp_presentation_feedback* feedback) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  feedbacks_.erase(feedback);
+  wp_presentation_feedback_destroy(feedback);
+}
+
+uint64_t VsyncWaiter::GetNextVblankLocked(uint64_t now) const {
+  if (last_vblank_nanos_ == 0 || last_vblank_nanos_ > now) {
+    return now + refresh_period_nanos_;
+  }
+
+  const uint64_t elapsed_periods =
+      (now - last_vblank_nanos_) / refresh_period_nanos_ + 1;
+  return last_vblank_nanos_ + elapsed_periods * refresh_period_nanos_;
+}
+
+}  // namespace flutter
@@ -0,0 +1,108 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <time.h>
+#include <wayland-client.h>
+
+#include <functional>
+#include <mutex>
+#include <set>
+
+#include "macros.h"
+#include "presentation-time-client-protocol.h"
+#include "time_base.h"
+
+namespace flutter {
+
+// Paces the engine to the compositor's repaint cycle. A wl_surface.frame
+// callback is requested with every commit and the engine is only handed a new
+// vsync once the compositor signals it is ready for the next frame. When
+// wp_presentation is available, presentation feedback refines the refresh
+// period and the phase of the display so frame target times line up with the
+// actual vblank.
+class VsyncWaiter {
+ public:
+  // Frame start and target times are in the time base of |time_base.h|.
+  using Callback =
+      std::function<void(uint64_t frame_start_nanos,
+                         uint64_t frame_target_nanos)>;
+
+  // |presentation| may be null in which case only frame callbacks are used.
+  VsyncWaiter(wl_surface* surface, wp_presentation* presentation);
+
+  ~VsyncWaiter();
+
+  // Must be called on the thread that dispatches the Wayland connection. The
+  // callback is invoked on that same thread.
+  void AsyncWaitForVsync(Callback callback);
+
+  // Invoked on the Wayland dispatch thread each time the compositor signals
+  // that it is ready for a new frame, before any pending vsync is delivered.
+  void SetFrameDoneCallback(std::function<void()> callback);
+
+  // Called on the raster thread just before the surface is committed.
+  void OnSurfaceWillCommit();
+
+  // Requests a frame callback with the next commit without counting it as a
+  // frame. Used to find out whether the compositor still repaints the surface
+  // while the engine produces no frames.
+  void RequestFrameCallback();
+
+  // Number of commits made and how many of those replaced a frame the
+  // compositor had not yet picked up.
+  size_t GetFramesCommitted() const;
+
+  size_t GetFramesSuperseded() const;
+
+  uint64_t GetRefreshPeriodNanos() const;
+
+  // The refresh rate of the output the surface is on. Presentation feedback,
+  // when available, takes precedence.
+  void SetRefreshRate(double refresh_rate);
+
+  // While paused, vsyncs are held even once the compositor is ready for a
+  // frame. Resuming hands out a held vsync right away. Must be called on the
+  // thread that dispatches the Wayland connection.
+  void SetPaused(bool paused);
+
+  // Whether a vsync is held until the compositor is ready or the waiter is
+  // resumed.
+  bool HasPendingVsync() const;
+
+ private:
+  static const wl_callback_listener kFrameCallbackListener;
+  static const wp_presentation_listener kPresentationListener;
+  static const wp_presentation_feedback_listener kFeedbackListener;
+
+  wl_surface* surface_ = nullptr;
+  wp_presentation* presentation_ = nullptr;
+  mutable std::mutex mutex_;
+  wl_callback* frame_callback_ = nullptr;
+  std::set<struct wp_presentation_feedback*> feedbacks_;
+  Callback pending_callback_;
+  std::function<void()> frame_done_callback_;
+  clockid_t presentation_clock_ = kTimeBaseClock;
+  uint64_t refresh_period_nanos_;
+  uint64_t last_vblank_nanos_ = 0;
+  bool refresh_period_from_feedback_ = false;
+  bool paused_ = false;
+  size_t frames_committed_ = 0;
+  size_t frames_superseded_ = 0;
+
+  void OnFrameDone(wl_callback* callback);
+
+  void OnPresented(struct wp_presentation_feedback* feedback,
+                   uint64_t presentation_time_nanos,
+                   uint32_t refresh_nanos);
+
+  void OnFeedbackDiscarded(struct wp_presentation_feedback* feedback);
+
+  uint64_t GetNextVblankLocked(uint64_t now) const;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(VsyncWaiter);
+};
+
+}  // namespace flutter
@@ -0,0 +1,621 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "wayland_connection.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "egl_utils.h"
+#include "tracing.h"
+
+namespace flutter {
+
+#define CONNECTION reinterpret_cast<WaylandConnection*>(data)
+
+const wl_registry_listener WaylandConnection::kRegistryListener = {
+    .global = [](void* data,
+                 struct wl_registry* wl_registry,
+                 uint32_t name,
+                 const char* interface,
+                 uint32_t version) -> void {
+      CONNECTION->AnnounceRegistryInterface(wl_registry, name, interface,
+                                            version);
+    },
+
+    .global_remove =
+        [](void* data, struct wl_registry* wl_registry, uint32_t name) -> void {
+      CONNECTION->UnannounceRegistryInterface(wl_registry, name);
+    },
+};
+
+const xdg_wm_base_listener WaylandConnection::kXdgWmBaseListener = {
+    .ping = [](void* data,
+               struct xdg_wm_base* xdg_wm_base,
+               uint32_t serial) -> void {
+      xdg_wm_base_pong(xdg_wm_base, serial);
+    },
+};
+
+const zwp_linux_dmabuf_v1_listener WaylandConnection::kLinuxDmabufListener = {
+    .format = [](void* data,
+                 struct zwp_linux_dmabuf_v1* linux_dmabuf,
+                 uint32_t format) -> void {},
+
+    .modifier = [](void* data,
+                   struct zwp_linux_dmabuf_v1* linux_dmabuf,
+                   uint32_t format,
+                   uint32_t modifier_hi,
+                   uint32_t modifier_lo) -> void {
+      CONNECTION->dmabuf_modifiers_[format].push_back(
+          (static_cast<uint64_t>(modifier_hi) << 32) | modifier_lo);
+    },
+};
+
+WaylandConnection::WaylandConnection(EventLoop& event_loop,
+                                     const EmbedderOptions& options)
+    : event_loop_(event_loop), options_(options) {}
+
+WaylandConnection::~WaylandConnection() {
+  if (attached_to_event_loop_) {
+    UnregisterFromEventLoop();
+  }
+
+  frame_stats_reporter_.reset();
+
+  if (presentation_) {
+    wp_presentation_destroy(presentation_);
+    presentation_ = nullptr;
+  }
+
+  if (subcompositor_) {
+    wl_subcompositor_destroy(subcompositor_);
+    subcompositor_ = nullptr;
+  }
+
+  if (syncobj_manager_) {
+    wp_linux_drm_syncobj_manager_v1_destroy(syncobj_manager_);
+    syncobj_manager_ = nullptr;
+  }
+
+  if (linux_dmabuf_) {
+    zwp_linux_dmabuf_v1_destroy(linux_dmabuf_);
+    linux_dmabuf_ = nullptr;
+  }
+
+  if (seat_) {
+    const auto stats = seat_->GetStats();
+    FLWAY_LOG << "Input batches: " << stats.batches
+              << ", events: " << stats.events << ", mean delay: "
+              << (stats.batches ? stats.total_delay_nanos / stats.batches : 0)
+              << "ns, max delay: " << stats.max_delay_nanos << "ns"
+              << std::endl;
+    seat_.reset();
+  }
+
+  if (input_timestamps_manager_) {
+    zwp_input_timestamps_manager_v1_destroy(input_timestamps_manager_);
+    input_timestamps_manager_ = nullptr;
+  }
+
+  outputs_.clear();
+
+  if (xdg_wm_base_) {
+    xdg_wm_base_destroy(xdg_wm_base_);
+    xdg_wm_base_ = nullptr;
+  }
+
+  if (shell_) {
+    wl_shell_destroy(shell_);
+    shell_ = nullptr;
+  }
+
+  if (share_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, share_context_);
+    share_context_ = EGL_NO_CONTEXT;
+  }
+
+  if (egl_display_) {
+    eglTerminate(egl_display_);
+    egl_display_ = nullptr;
+  }
+
+  if (compositor_) {
+    wl_compositor_destroy(compositor_);
+    compositor_ = nullptr;
+  }
+
+  if (registry_) {
+    wl_registry_destroy(registry_);
+    registry_ = nullptr;
+  }
+
+  if (display_) {
+    wl_display_flush(display_);
+    wl_display_disconnect(display_);
+    display_ = nullptr;
+  }
+}
+
+bool WaylandConnection::Connect() {
+  std::lock_guard<std::mutex> lock(connect_mutex_);
+
+  if (!connect_attempted_) {
+    FLWAY_TRACE_SCOPE("WaylandConnection::Connect");
+    connect_attempted_ = true;
+    connected_ = ConnectAndSetupEGL();
+  }
+
+  return connected_;
+}
+
+bool WaylandConnection::ConnectAndSetupEGL() {
+  display_ = wl_display_connect(nullptr);
+
+  if (!display_) {
+    FLWAY_ERROR << "Could not connect to the wayland display." << std::endl;
+    return false;
+  }
+
+  registry_ = wl_display_get_registry(display_);
+  if (!registry_) {
+    FLWAY_ERROR << "Could not get the wayland registry." << std::endl;
+    return false;
+  }
+
+  wl_registry_add_listener(registry_, &kRegistryListener, this);
+
+  wl_display_roundtrip(display_);
+
+  // Wait for the outputs to describe themselves so the first frame is
+  // rendered at the right scale.
+  wl_display_roundtrip(display_);
+
+  if (!compositor_) {
+    FLWAY_ERROR << "Compositor does not support wl_compositor." << std::endl;
+    return false;
+  }
+
+  RecordStartupMilestone("wayland connected");
+
+  if (!SetupEGL()) {
+    FLWAY_ERROR << "Could not setup EGL." << std::endl;
+    return false;
+  }
+
+  RecordStartupMilestone("egl ready");
+
+  if (options_.use_presentation_feedback && !presentation_) {
+    FLWAY_LOG << "Compositor does not support wp_presentation. Falling back "
+                 "to frame callbacks."
+              << std::endl;
+  }
+
+  return true;
+}
+
+// Driver state such as the shader cache lives with the display, so it is
+// initialized once however many windows there are.
+bool WaylandConnection::SetupEGL() {
+  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not bind the ES API." << std::endl;
+    return false;
+  }
+
+  egl_display_ = eglGetDisplay(display_);
+  if (egl_display_ == EGL_NO_DISPLAY) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not access EGL display." << std::endl;
+    return false;
+  }
+
+  if (eglInitialize(egl_display_, nullptr, nullptr) != EGL_TRUE) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not initialize EGL display." << std::endl;
+    return false;
+  }
+
+  const EGLint config_attribs[] = {
+      // clang-format off
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_SURFACE_TYPE,    0,
+    EGL_RED_SIZE,        8,
+    EGL_GREEN_SIZE,      8,
+    EGL_BLUE_SIZE,       8,
+    EGL_NONE,            // termination sentinel
+      // clang-format on
+  };
+
+  EGLConfig config = nullptr;
+  EGLint config_count = 0;
+
+  if (eglChooseConfig(egl_display_, config_attribs, &config, 1,
+                      &config_count) != EGL_TRUE ||
+      config_count == 0 || config == nullptr) {
+    LogLastEGLError();
+    FLWAY_ERROR << "No matching configs for the share context." << std::endl;
+    return false;
+  }
+
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+
+  share_context_ = eglCreateContext(egl_display_, config,
+                                    nullptr /* share group */, context_attribs);
+
+  if (share_context_ == EGL_NO_CONTEXT) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not create the share context." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+bool WaylandConnection::AttachToEventLoop() {
+  if (attached_to_event_loop_) {
+    return true;
+  }
+
+  if (!Connect()) {
+    return false;
+  }
+
+  if (pending_seat_name_ != 0) {
+    CreateSeat(registry_, pending_seat_name_, pending_seat_version_);
+    pending_seat_name_ = 0;
+  }
+
+  if (options_.stats_interval_seconds > 0) {
+    frame_stats_reporter_.reset(new FrameStatsReporter(
+        event_loop_, options_.stats_interval_seconds * kNanosPerSecond,
+        [this]() { return GetFastestRefreshPeriodNanos(); }));
+  }
+
+  if (!RegisterWithEventLoop()) {
+    FLWAY_ERROR << "Could not register the display with the event loop."
+                << std::endl;
+    return false;
+  }
+
+  attached_to_event_loop_ = true;
+  return true;
+}
+
+void WaylandConnection::StopRunning() {
+  CancelPendingRead();
+  event_loop_.Terminate();
+}
+
+void WaylandConnection::AddWindow(wl_surface* surface, Window& window) {
+  windows_[surface] = &window;
+}
+
+void WaylandConnection::RemoveWindow(wl_surface* surface) {
+  windows_.erase(surface);
+}
+
+WaylandConnection::Window* WaylandConnection::FindWindow(
+    wl_surface* surface) const {
+  auto found = windows_.find(surface);
+  return found == windows_.end() ? nullptr : found->second;
+}
+
+void WaylandConnection::NotifyOutputsChanged() {
+  for (const auto& window : windows_) {
+    window.second->OnConnectionOutputsChanged();
+  }
+}
+
+// Frame timing is recorded for the whole process, so misses are counted
+// against the fastest window.
+uint64_t WaylandConnection::GetFastestRefreshPeriodNanos() const {
+  uint64_t fastest = 0;
+
+  for (const auto& window : windows_) {
+    const uint64_t period = window.second->GetRefreshPeriodNanos();
+    if (period != 0 && (fastest == 0 || period < fastest)) {
+      fastest = period;
+    }
+  }
+
+  return fastest;
+}
+
+EventLoop& WaylandConnection::GetEventLoop() const {
+  return event_loop_;
+}
+
+wl_display* WaylandConnection::GetDisplay() const {
+  return display_;
+}
+
+wl_compositor* WaylandConnection::GetCompositor() const {
+  return compositor_;
+}
+
+uint32_t WaylandConnection::GetCompositorVersion() const {
+  return compositor_version_;
+}
+
+wl_shell* WaylandConnection::GetShell() const {
+  return shell_;
+}
+
+xdg_wm_base* WaylandConnection::GetXdgWmBase() const {
+  return xdg_wm_base_;
+}
+
+wp_presentation* WaylandConnection::GetPresentation() const {
+  return presentation_;
+}
+
+zwp_linux_dmabuf_v1* WaylandConnection::GetLinuxDmabuf() const {
+  return linux_dmabuf_;
+}
+
+wp_linux_drm_syncobj_manager_v1* WaylandConnection::GetSyncobjManager()
+    const {
+  return syncobj_manager_;
+}
+
+wl_subcompositor* WaylandConnection::GetSubcompositor() const {
+  return subcompositor_;
+}
+
+std::vector<uint64_t> WaylandConnection::GetDmabufModifiers(
+    uint32_t format) const {
+  auto found = dmabuf_modifiers_.find(format);
+  return found == dmabuf_modifiers_.end() ? std::vector<uint64_t>()
+                                          : found->second;
+}
+
+const std::vector<std::unique_ptr<WaylandOutput>>&
+WaylandConnection::GetOutputs() const {
+  return outputs_;
+}
+
+EGLDisplay WaylandConnection::GetEGLDisplay() const {
+  return egl_display_;
+}
+
+EGLContext WaylandConnection::GetShareContext() const {
+  return share_context_;
+}
+
+// |flutter::WaylandSeat::Delegate|
+void WaylandConnection::OnSeatPointerEvents(wl_surface* surface,
+                                            const FlutterPointerEvent* events,
+                                            size_t count) {
+  if (Window* window = FindWindow(surface)) {
+    window->OnConnectionPointerEvents(events, count);
+  }
+}
+
+// |flutter::WaylandSeat::Delegate|
+void WaylandConnection::OnSeatKeyEvent(wl_surface* surface,
+                                       const WaylandSeat::KeyEvent& event) {
+  if (Window* window = FindWindow(surface)) {
+    window->OnConnectionKeyEvent(event);
+  }
+}
+
+void WaylandConnection::AnnounceRegistryInterface(
+    struct wl_registry* wl_registry,
+    uint32_t name,
+    const char* interface_name,
+    uint32_t version) {
+  if (strcmp(interface_name, "wl_compositor") == 0) {
+    compositor_version_ = std::min(version, 4u);
+    compositor_ = static_cast<decltype(compositor_)>(wl_registry_bind(
+        wl_registry, name, &wl_compositor_interface, compositor_version_));
+    return;
+  }
+
+  if (strcmp(interface_name, "wl_shell") == 0) {
+    shell_ = static_cast<decltype(shell_)>(
+        wl_registry_bind(wl_registry, name, &wl_shell_interface, 1));
+    return;
+  }
+
+  if (strcmp(interface_name, "wl_output") == 0) {
+    std::unique_ptr<WaylandOutput> output(
+        new WaylandOutput(wl_registry, name, version,
+                          [this](WaylandOutput&) { NotifyOutputsChanged(); }));
+    if (output->IsValid()) {
+      outputs_.push_back(std::move(output));
+    }
+    return;
+  }
+
+  // Only the first seat is used. The seat owns timers on the event loop, so
+  // seats announced while connecting on another thread are created once the
+  // connection is attached to the loop.
+  if (strcmp(interface_name, "wl_seat") == 0 && !seat_ &&
+      pending_seat_name_ == 0) {
+    if (attached_to_event_loop_) {
+      CreateSeat(wl_registry, name, version);
+    } else {
+      pending_seat_name_ = name;
+      pending_seat_version_ = version;
+    }
+    return;
+  }
+
+  if (strcmp(interface_name, "zwp_input_timestamps_manager_v1") == 0) {
+    input_timestamps_manager_ =
+        static_cast<decltype(input_timestamps_manager_)>(wl_registry_bind(
+            wl_registry, name, &zwp_input_timestamps_manager_v1_interface, 1));
+    if (seat_) {
+      seat_->SetInputTimestampsManager(input_timestamps_manager_);
+    }
+    return;
+  }
+
+  if (strcmp(interface_name, "xdg_wm_base") == 0) {
+    xdg_wm_base_ = static_cast<decltype(xdg_wm_base_)>(wl_registry_bind(
+        wl_registry, name, &xdg_wm_base_interface,
+        std::min(version,
+                 static_cast<uint32_t>(xdg_wm_base_interface.version))));
+    xdg_wm_base_add_listener(xdg_wm_base_, &kXdgWmBaseListener, this);
+    return;
+  }
+
+  // Buffers are created with create_immed, which is new in version 2. Version
+  // 3 announces the modifiers.
+  if (strcmp(interface_name, "zwp_linux_dmabuf_v1") == 0 &&
+      options_.presenter == EmbedderOptions::Presenter::kDmabuf &&
+      version >= 2) {
+    linux_dmabuf_ = static_cast<decltype(linux_dmabuf_)>(
+        wl_registry_bind(wl_registry, name, &zwp_linux_dmabuf_v1_interface,
+                         std::min(version, 3u)));
+    zwp_linux_dmabuf_v1_add_listener(linux_dmabuf_, &kLinuxDmabufListener,
+                                     this);
+    return;
+  }
+
+  if (strcmp(interface_name, "wl_subcompositor") == 0 &&
+      options_.subsurfaces) {
+    subcompositor_ = static_cast<decltype(subcompositor_)>(
+        wl_registry_bind(wl_registry, name, &wl_subcompositor_interface, 1));
+    return;
+  }
+
+  if (strcmp(interface_name, "wp_linux_drm_syncobj_manager_v1") == 0 &&
+      options_.presenter == EmbedderOptions::Presenter::kDmabuf &&
+      options_.explicit_sync) {
+    syncobj_manager_ = static_cast<decltype(syncobj_manager_)>(
+        wl_registry_bind(wl_registry, name,
+                         &wp_linux_drm_syncobj_manager_v1_interface, 1));
+    return;
+  }
+
+  if (strcmp(interface_name, "wp_presentation") == 0 &&
+      options_.use_presentation_feedback) {
+    presentation_ = static_cast<decltype(presentation_)>(
+        wl_registry_bind(wl_registry, name, &wp_presentation_interface, 1));
+    return;
+  }
+}
+
+void WaylandConnection::CreateSeat(struct wl_registry* wl_registry,
+                                   uint32_t name,
+                                   uint32_t version) {
+  std::unique_ptr<WaylandSeat> seat(
+      new WaylandSeat(event_loop_, wl_registry, name, version, *this));
+  if (seat->IsValid()) {
+    seat->SetInputTimestampsManager(input_timestamps_manager_);
+    seat_ = std::move(seat);
+  }
+}
+
+void WaylandConnection::UnannounceRegistryInterface(
+    struct wl_registry* wl_registry,
+    uint32_t name) {
+  auto found = std::find_if(outputs_.begin(), outputs_.end(),
+                            [name](const std::unique_ptr<WaylandOutput>& o) {
+                              return o->GetName() == name;
+                            });
+
+  if (found == outputs_.end()) {
+    return;
+  }
+
+  for (const auto& window : windows_) {
+    window.second->OnConnectionOutputRemoved((*found)->GetOutput());
+  }
+
+  outputs_.erase(found);
+  NotifyOutputsChanged();
+}
+
+bool WaylandConnection::RegisterWithEventLoop() {
+  const int fd = wl_display_get_fd(display_);
+
+  if (!event_loop_.AddFileDescriptor(
+          fd, EPOLLIN | EPOLLERR | EPOLLHUP,
+          [this](uint32_t events) { OnDisplayFileDescriptorEvents(events); })) {
+    return false;
+  }
+
+  event_loop_.SetBeforeWaitCallback([this]() { PrepareToWait(); });
+  event_loop_.SetAfterWaitCallback([this]() { CancelPendingRead(); });
+  return true;
+}
+
+void WaylandConnection::UnregisterFromEventLoop() {
+  if (!display_) {
+    return;
+  }
+
+  CancelPendingRead();
+  event_loop_.SetBeforeWaitCallback(nullptr);
+  event_loop_.SetAfterWaitCallback(nullptr);
+  event_loop_.RemoveFileDescriptor(wl_display_get_fd(display_));
+}
+
+// Called on the event loop thread before it blocks. Events already queued
+// must be dispatched before we may announce our intent to read more from the
+// connection. Requests made since the last iteration are flushed at the same
+// time so the compositor sees them before we go to sleep.
+void WaylandConnection::PrepareToWait() {
+  if (read_prepared_) {
+    return;
+  }
+
+  while (wl_display_prepare_read(display_) != 0) {
+    FLWAY_TRACE_SCOPE("WaylandConnection::DispatchPending");
+    if (wl_display_dispatch_pending(display_) == -1) {
+      StopRunning();
+      return;
+    }
+  }
+
+  read_prepared_ = true;
+
+  if (wl_display_flush(display_) == -1 && errno != EAGAIN) {
+    FLWAY_ERROR << "Could not flush the Wayland connection." << std::endl;
+    StopRunning();
+  }
+}
+
+void WaylandConnection::OnDisplayFileDescriptorEvents(uint32_t events) {
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    FLWAY_ERROR << "Lost the connection to the Wayland compositor."
+                << std::endl;
+    StopRunning();
+    return;
+  }
+
+  if (!read_prepared_) {
+    return;
+  }
+
+  read_prepared_ = false;
+
+  FLWAY_TRACE_SCOPE("WaylandConnection::Dispatch");
+
+  if (wl_display_read_events(display_) == -1 ||
+      wl_display_dispatch_pending(display_) == -1) {
+    FLWAY_ERROR << "Could not dispatch Wayland events." << std::endl;
+    StopRunning();
+  }
+}
+
+// Called on the event loop thread after it wakes up. If the wakeup was due to
+// something other than the Wayland connection, release the read intent so
+// other threads waiting on the connection are not blocked.
+void WaylandConnection::CancelPendingRead() {
+  if (!read_prepared_) {
+    return;
+  }
+
+  wl_display_cancel_read(display_);
+  read_prepared_ = false;
+}
+
+}  // namespace flutter
@@ -0,0 +1,189 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <EGL/egl.h>
+#include <flutter_embedder.h>
+#include <wayland-client.h>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "embedder_options.h"
+#include "event_loop.h"
+#include "instrumentation.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "linux-drm-syncobj-v1-client-protocol.h"
+#include "macros.h"
+#include "presentation-time-client-protocol.h"
+#include "wayland_output.h"
+#include "wayland_seat.h"
+#include "xdg-shell-client-protocol.h"
+
+namespace flutter {
+
+// The connection to the compositor and the EGL display on top of it, shared
+// by every window of the process. Owns the globals, the outputs and the seat,
+// dispatches the connection on the event loop and routes input to the window
+// whose surface has the focus.
+//
+// Windows render with contexts in the share group of |GetShareContext|, so
+// resources such as external textures may be used in any of them.
+class WaylandConnection : public WaylandSeat::Delegate {
+ public:
+  class Window {
+   public:
+    // The set of outputs or the properties of one of them changed.
+    virtual void OnConnectionOutputsChanged() = 0;
+
+    // Invoked before |output| is destroyed.
+    virtual void OnConnectionOutputRemoved(wl_output* output) = 0;
+
+    // Coordinates are in surface coordinates.
+    virtual void OnConnectionPointerEvents(const FlutterPointerEvent* events,
+                                           size_t count) = 0;
+
+    virtual void OnConnectionKeyEvent(const WaylandSeat::KeyEvent& event) = 0;
+
+    // Zero if unknown.
+    virtual uint64_t GetRefreshPeriodNanos() const = 0;
+  };
+
+  WaylandConnection(EventLoop& event_loop, const EmbedderOptions& options);
+
+  ~WaylandConnection();
+
+  // Connects to the compositor, waits for the outputs to describe themselves
+  // and initializes EGL. Only the first call does anything. Later ones return
+  // its result. Like |WaylandDisplay::Connect|, it may run on another thread.
+  bool Connect();
+
+  // Called on the event loop thread after |Connect|. Starts dispatching the
+  // connection and input on the event loop. Only the first call does
+  // anything.
+  bool AttachToEventLoop();
+
+  // Stops the event loop, and with it every window.
+  void StopRunning();
+
+  // Input on |surface| is delivered to |window| until it is removed.
+  void AddWindow(wl_surface* surface, Window& window);
+
+  void RemoveWindow(wl_surface* surface);
+
+  EventLoop& GetEventLoop() const;
+
+  wl_display* GetDisplay() const;
+
+  wl_compositor* GetCompositor() const;
+
+  uint32_t GetCompositorVersion() const;
+
+  wl_shell* GetShell() const;
+
+  xdg_wm_base* GetXdgWmBase() const;
+
+  wp_presentation* GetPresentation() const;
+
+  zwp_linux_dmabuf_v1* GetLinuxDmabuf() const;
+
+  wp_linux_drm_syncobj_manager_v1* GetSyncobjManager() const;
+
+  wl_subcompositor* GetSubcompositor() const;
+
+  // The modifiers the compositor advertised for |format|. Empty if it only
+  // supports implicit modifiers.
+  std::vector<uint64_t> GetDmabufModifiers(uint32_t format) const;
+
+  // In the order the compositor announced them. Only accessed on the thread
+  // dispatching the connection.
+  const std::vector<std::unique_ptr<WaylandOutput>>& GetOutputs() const;
+
+  EGLDisplay GetEGLDisplay() const;
+
+  // A context that is never made current. Windows create theirs in its share
+  // group.
+  EGLContext GetShareContext() const;
+
+ private:
+  static const wl_registry_listener kRegistryListener;
+  static const xdg_wm_base_listener kXdgWmBaseListener;
+  static const zwp_linux_dmabuf_v1_listener kLinuxDmabufListener;
+
+  EventLoop& event_loop_;
+  const EmbedderOptions options_;
+  std::mutex connect_mutex_;
+  bool connect_attempted_ = false;
+  bool connected_ = false;
+  bool attached_to_event_loop_ = false;
+  bool read_prepared_ = false;
+  wl_display* display_ = nullptr;
+  wl_registry* registry_ = nullptr;
+  wl_compositor* compositor_ = nullptr;
+  uint32_t compositor_version_ = 0;
+  wl_shell* shell_ = nullptr;
+  xdg_wm_base* xdg_wm_base_ = nullptr;
+  std::vector<std::unique_ptr<WaylandOutput>> outputs_;
+  std::unique_ptr<WaylandSeat> seat_;
+  uint32_t pending_seat_name_ = 0;
+  uint32_t pending_seat_version_ = 0;
+  zwp_input_timestamps_manager_v1* input_timestamps_manager_ = nullptr;
+  wp_presentation* presentation_ = nullptr;
+  zwp_linux_dmabuf_v1* linux_dmabuf_ = nullptr;
+  std::unordered_map<uint32_t, std::vector<uint64_t>> dmabuf_modifiers_;
+  wp_linux_drm_syncobj_manager_v1* syncobj_manager_ = nullptr;
+  wl_subcompositor* subcompositor_ = nullptr;
+  EGLDisplay egl_display_ = EGL_NO_DISPLAY;
+  EGLContext share_context_ = EGL_NO_CONTEXT;
+  std::unordered_map<wl_surface*, Window*> windows_;
+  std::unique_ptr<FrameStatsReporter> frame_stats_reporter_;
+
+  bool ConnectAndSetupEGL();
+
+  bool SetupEGL();
+
+  Window* FindWindow(wl_surface* surface) const;
+
+  void NotifyOutputsChanged();
+
+  uint64_t GetFastestRefreshPeriodNanos() const;
+
+  void AnnounceRegistryInterface(struct wl_registry* wl_registry,
+                                 uint32_t name,
+                                 const char* interface,
+                                 uint32_t version);
+
+  void UnannounceRegistryInterface(struct wl_registry* wl_registry,
+                                   uint32_t name);
+
+  void CreateSeat(struct wl_registry* wl_registry,
+                  uint32_t name,
+                  uint32_t version);
+
+  bool RegisterWithEventLoop();
+
+  void UnregisterFromEventLoop();
+
+  void PrepareToWait();
+
+  void OnDisplayFileDescriptorEvents(uint32_t events);
+
+  void CancelPendingRead();
+
+  // |flutter::WaylandSeat::Delegate|
+  void OnSeatPointerEvents(wl_surface* surface,
+                           const FlutterPointerEvent* events,
+                           size_t count) override;
+
+  // |flutter::WaylandSeat::Delegate|
+  void OnSeatKeyEvent(wl_surface* surface,
+                      const WaylandSeat::KeyEvent& event) override;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandConnection);
+};
+
+}  // namespace flutter
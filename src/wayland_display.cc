@@ -11,99 +11,162 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-#include <cstring>
+#include <algorithm>
+
+#include "egl_utils.h"
+#include "legacy_shell_surface.h"
+#include "tracing.h"
+#include "xdg_shell_surface.h"
 
 namespace flutter {
 
 #define DISPLAY reinterpret_cast<WaylandDisplay*>(data)
 
-const wl_registry_listener WaylandDisplay::kRegistryListener = {
-    .global = [](void* data,
-                 struct wl_registry* wl_registry,
-                 uint32_t name,
-                 const char* interface,
-                 uint32_t version) -> void {
-      DISPLAY->AnnounceRegistryInterface(wl_registry, name, interface, version);
+const wl_surface_listener WaylandDisplay::kSurfaceListener = {
+    .enter = [](void* data,
+                struct wl_surface* wl_surface,
+                struct wl_output* output) -> void {
+      DISPLAY->OnSurfaceEnter(output);
     },
 
-    .global_remove =
-        [](void* data, struct wl_registry* wl_registry, uint32_t name) -> void {
-      DISPLAY->UnannounceRegistryInterface(wl_registry, name);
+    .leave = [](void* data,
+                struct wl_surface* wl_surface,
+                struct wl_output* output) -> void {
+      DISPLAY->OnSurfaceLeave(output);
     },
 };
 
-const wl_shell_surface_listener WaylandDisplay::kShellSurfaceListener = {
-    .ping = [](void* data,
-               struct wl_shell_surface* wl_shell_surface,
-               uint32_t serial) -> void {
-      wl_shell_surface_pong(DISPLAY->shell_surface_, serial);
-    },
+WaylandDisplay::WaylandDisplay(WaylandConnection& connection,
+                               size_t width,
+                               size_t height,
+                               const EmbedderOptions& options)
+    : connection_(connection),
+      event_loop_(connection.GetEventLoop()),
+      options_(options),
+      screen_width_(width),
+      screen_height_(height),
+      surface_width_(width),
+      surface_height_(height),
+      swap_interval_configured_(false) {}
 
-    .configure = [](void* data,
-                    struct wl_shell_surface* wl_shell_surface,
-                    uint32_t edges,
-                    int32_t width,
-                    int32_t height) -> void {
-      FLWAY_ERROR << "Unhandled resize." << std::endl;
-    },
+bool WaylandDisplay::Connect() {
+  FLWAY_TRACE_SCOPE("WaylandDisplay::Connect");
 
-    .popup_done = [](void* data,
-                     struct wl_shell_surface* wl_shell_surface) -> void {
-      // Nothing to do.
-    },
-};
+  const bool connected = connection_.Connect() && SetupWindow();
 
-WaylandDisplay::WaylandDisplay(size_t width, size_t height)
-    : screen_width_(width), screen_height_(height) {
+  {
+    std::lock_guard<std::mutex> lock(egl_setup_mutex_);
+    egl_setup_done_ = true;
+    egl_ready_ = connected;
+  }
+  egl_setup_cv_.notify_all();
+
+  return connected;
+}
+
+bool WaylandDisplay::SetupWindow() {
   if (screen_width_ == 0 || screen_height_ == 0) {
     FLWAY_ERROR << "Invalid screen dimensions." << std::endl;
-    return;
+    return false;
   }
 
-  display_ = wl_display_connect(nullptr);
+  // The outputs have described themselves by now, so the first frame is
+  // rendered at the right scale.
+  UpdateOutputState();
 
-  if (!display_) {
-    FLWAY_ERROR << "Could not connect to the wayland display." << std::endl;
-    return;
+  if (options_.fullscreen) {
+    const WaylandOutput* output = GetPrimaryOutput();
+
+    if (output && output->GetModeWidth() > 0 && output->GetModeHeight() > 0) {
+      screen_width_ = output->GetModeWidth() / buffer_scale_;
+      screen_height_ = output->GetModeHeight() / buffer_scale_;
+    } else {
+      FLWAY_LOG << "Could not determine the output mode. Using the default "
+                   "window size."
+                << std::endl;
+    }
   }
 
-  registry_ = wl_display_get_registry(display_);
-  if (!registry_) {
-    FLWAY_ERROR << "Could not get the wayland registry." << std::endl;
-    return;
+  if (!SetupEGL()) {
+    FLWAY_ERROR << "Could not setup EGL." << std::endl;
+    return false;
   }
 
-  wl_registry_add_listener(registry_, &kRegistryListener, this);
+  vsync_waiter_.reset(new VsyncWaiter(surface_, connection_.GetPresentation()));
+  vsync_waiter_->SetFrameDoneCallback([this]() { OnFrameDone(); });
+  vsync_waiter_->SetRefreshRate(refresh_rate_);
+  return true;
+}
 
-  wl_display_roundtrip(display_);
+bool WaylandDisplay::AttachToEventLoop() {
+  if (!WaitForEGLSetup() || !connection_.AttachToEventLoop()) {
+    return false;
+  }
 
-  if (!SetupEGL()) {
-    FLWAY_ERROR << "Could not setup EGL." << std::endl;
-    return;
+  if (options_.pointer_coalescing !=
+      EmbedderOptions::PointerCoalescing::kOff) {
+    pointer_coalescer_.reset(new PointerCoalescer(
+        event_loop_,
+        options_.pointer_coalescing ==
+            EmbedderOptions::PointerCoalescing::kPredict,
+        [this](const FlutterPointerEvent* events, size_t count) {
+          SendPointerEvents(events, count);
+        }));
+  }
+
+  if (options_.power_saving) {
+    visibility_monitor_.reset(new VisibilityMonitor(
+        event_loop_, [this](bool visible) { OnVisibilityChanged(visible); },
+        [this]() { ProbeFrameCallback(); }));
   }
 
   valid_ = true;
+  return true;
 }
 
 WaylandDisplay::~WaylandDisplay() {
-  if (shell_surface_) {
-    wl_shell_surface_destroy(shell_surface_);
-    shell_surface_ = nullptr;
+  visibility_monitor_.reset();
+
+  if (pointer_coalescer_) {
+    const auto stats = pointer_coalescer_->GetStats();
+    FLWAY_LOG << "Pointer events received: " << stats.events_received
+              << ", delivered after coalescing: " << stats.events_delivered
+              << std::endl;
+    pointer_coalescer_.reset();
   }
 
-  if (shell_) {
-    wl_shell_destroy(shell_);
-    shell_ = nullptr;
+  if (vsync_waiter_) {
+    FLWAY_LOG << "Frames committed: " << vsync_waiter_->GetFramesCommitted()
+              << ", superseded before the compositor picked them up: "
+              << vsync_waiter_->GetFramesSuperseded() << std::endl;
+    vsync_waiter_.reset();
   }
 
+  subsurface_compositor_.reset();
+  dmabuf_presenter_.reset();
+
+  shell_surface_.reset();
+
+  entered_outputs_.clear();
+
   if (egl_surface_) {
     eglDestroySurface(egl_display_, egl_surface_);
     egl_surface_ = nullptr;
   }
 
-  if (egl_display_) {
-    eglTerminate(egl_display_);
-    egl_display_ = nullptr;
+  if (resource_surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(egl_display_, resource_surface_);
+    resource_surface_ = EGL_NO_SURFACE;
+  }
+
+  if (resource_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, resource_context_);
+    resource_context_ = EGL_NO_CONTEXT;
+  }
+
+  if (egl_context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(egl_display_, egl_context_);
+    egl_context_ = EGL_NO_CONTEXT;
   }
 
   if (window_) {
@@ -112,228 +175,786 @@ WaylandDisplay::~WaylandDisplay() {
   }
 
   if (surface_) {
+    connection_.RemoveWindow(surface_);
     wl_surface_destroy(surface_);
     surface_ = nullptr;
   }
 
-  if (compositor_) {
-    wl_compositor_destroy(compositor_);
-    compositor_ = nullptr;
+}
+
+bool WaylandDisplay::IsValid() const {
+  return valid_;
+}
+
+bool WaylandDisplay::SetApplication(FlutterApplication* application) {
+  application_ = application;
+
+  if (!application_) {
+    return true;
   }
 
-  if (registry_) {
-    wl_registry_destroy(registry_);
-    registry_ = nullptr;
+  if (!SendDisplays()) {
+    FLWAY_ERROR << "Could not describe the displays to the engine."
+                << std::endl;
   }
 
-  if (display_) {
-    wl_display_flush(display_);
-    wl_display_disconnect(display_);
-    display_ = nullptr;
+  if (visibility_monitor_ && !SendLifecycleState()) {
+    FLWAY_ERROR << "Could not send the lifecycle state." << std::endl;
   }
+
+  return SendWindowMetrics();
 }
 
-bool WaylandDisplay::IsValid() const {
-  return valid_;
+// Shells can send configure events at the rate of the pointer during an
+// interactive resize. Only the most recent size matters and the engine is
+// told about at most one new size per frame.
+void WaylandDisplay::OnShellSurfaceConfigure(int32_t width, int32_t height) {
+  // A zero dimension means the client is free to pick its own size.
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+
+  pending_width_ = width;
+  pending_height_ = height;
+
+  if (!metrics_sent_this_frame_) {
+    FlushPendingWindowSize();
+  }
 }
 
-bool WaylandDisplay::Run() {
-  if (!valid_) {
-    FLWAY_ERROR << "Could not run an invalid display." << std::endl;
-    return false;
+// Closing any window exits, like the window of a single engine does.
+void WaylandDisplay::OnShellSurfaceClose() {
+  connection_.StopRunning();
+}
+
+void WaylandDisplay::OnShellSurfaceSuspended(bool suspended) {
+  if (visibility_monitor_) {
+    visibility_monitor_->SetSuspended(suspended);
   }
+}
+
+// A frame presented in the meantime already committed the acknowledgement,
+// and an extra commit of the same state does no harm.
+void WaylandDisplay::OnShellSurfaceNeedsCommit() {
+  std::lock_guard<std::mutex> lock(present_mutex_);
+  wl_surface_commit(surface_);
+}
 
-  while (valid_) {
-    wl_display_dispatch(display_);
+// |flutter::WaylandConnection::Window|
+void WaylandDisplay::OnConnectionPointerEvents(
+    const FlutterPointerEvent* events,
+    size_t count) {
+  if (!application_) {
+    return;
   }
 
-  return true;
+  // The engine wants physical pixels.
+  auto& scaled = scaled_pointer_events_;
+  scaled.assign(events, events + count);
+  for (auto& event : scaled) {
+    event.x *= buffer_scale_;
+    event.y *= buffer_scale_;
+    event.scroll_delta_x *= buffer_scale_;
+    event.scroll_delta_y *= buffer_scale_;
+  }
+
+  if (pointer_coalescer_) {
+    // Moves are held for at most a frame when no vsync is requested.
+    pointer_coalescer_->Push(scaled.data(), scaled.size(),
+                             vsync_waiter_->GetRefreshPeriodNanos());
+    return;
+  }
+
+  SendPointerEvents(scaled.data(), scaled.size());
 }
 
-static void LogLastEGLError() {
-  struct EGLNameErrorPair {
-    const char* name;
-    EGLint code;
-  };
+void WaylandDisplay::SendPointerEvents(const FlutterPointerEvent* events,
+                                       size_t count) {
+  if (!application_->SendPointerEvents(events, count)) {
+    FLWAY_ERROR << "Could not send pointer events." << std::endl;
+  }
+}
 
-#define _EGL_ERROR_DESC(a) \
-  { #a, a }
-
-  const EGLNameErrorPair pairs[] = {
-      _EGL_ERROR_DESC(EGL_SUCCESS),
-      _EGL_ERROR_DESC(EGL_NOT_INITIALIZED),
-      _EGL_ERROR_DESC(EGL_BAD_ACCESS),
-      _EGL_ERROR_DESC(EGL_BAD_ALLOC),
-      _EGL_ERROR_DESC(EGL_BAD_ATTRIBUTE),
-      _EGL_ERROR_DESC(EGL_BAD_CONTEXT),
-      _EGL_ERROR_DESC(EGL_BAD_CONFIG),
-      _EGL_ERROR_DESC(EGL_BAD_CURRENT_SURFACE),
-      _EGL_ERROR_DESC(EGL_BAD_DISPLAY),
-      _EGL_ERROR_DESC(EGL_BAD_SURFACE),
-      _EGL_ERROR_DESC(EGL_BAD_MATCH),
-      _EGL_ERROR_DESC(EGL_BAD_PARAMETER),
-      _EGL_ERROR_DESC(EGL_BAD_NATIVE_PIXMAP),
-      _EGL_ERROR_DESC(EGL_BAD_NATIVE_WINDOW),
-      _EGL_ERROR_DESC(EGL_CONTEXT_LOST),
-  };
+// |flutter::WaylandConnection::Window|
+void WaylandDisplay::OnConnectionKeyEvent(const WaylandSeat::KeyEvent& event) {
+  if (!application_) {
+    return;
+  }
+
+  if (!application_->SendKeyEvent(event.pressed, event.keysym,
+                                  event.scan_code, event.modifiers,
+                                  event.unicode)) {
+    FLWAY_ERROR << "Could not send the key event." << std::endl;
+  }
+}
+
+void WaylandDisplay::OnFrameDone() {
+  metrics_sent_this_frame_ = false;
+  FlushPendingWindowSize();
+
+  if (visibility_monitor_) {
+    visibility_monitor_->OnFrameDone();
+  }
+}
+
+// Vsyncs stop before the app hears it is paused, and resume as soon as the
+// window shows up again so the first frame does not wait for the framework.
+void WaylandDisplay::OnVisibilityChanged(bool visible) {
+  FLWAY_LOG << "Window " << (visible ? "visible" : "hidden") << std::endl;
+
+  vsync_waiter_->SetPaused(!visible);
+
+  if (application_ && !SendLifecycleState()) {
+    FLWAY_ERROR << "Could not send the lifecycle state." << std::endl;
+  }
+}
+
+// Only probed while vsyncs are paused, but the raster thread may still be
+// presenting the last frame. Waiting for it keeps the probe's commit from
+// applying that frame's state before it is complete.
+void WaylandDisplay::ProbeFrameCallback() {
+  std::lock_guard<std::mutex> lock(present_mutex_);
+  vsync_waiter_->RequestFrameCallback();
+  wl_surface_commit(surface_);
+}
+
+// Hidden windows pass through inactive on their way to paused, like they do
+// on other platforms.
+bool WaylandDisplay::SendLifecycleState() {
+  using LifecycleState = FlutterApplication::LifecycleState;
+
+  if (visibility_monitor_->IsVisible()) {
+    return application_->SetLifecycleState(LifecycleState::kResumed);
+  }
+
+  return application_->SetLifecycleState(LifecycleState::kInactive) &&
+         application_->SetLifecycleState(LifecycleState::kPaused);
+}
+
+void WaylandDisplay::FlushPendingWindowSize() {
+  if (pending_width_ == 0 || pending_height_ == 0) {
+    return;
+  }
+
+  FLWAY_TRACE_SCOPE("WaylandDisplay::FlushPendingWindowSize");
+
+  const int width = pending_width_;
+  const int height = pending_height_;
+  pending_width_ = 0;
+  pending_height_ = 0;
+
+  if (width == screen_width_ && height == screen_height_) {
+    return;
+  }
 
-#undef _EGL_ERROR_DESC
+  screen_width_ = width;
+  screen_height_ = height;
 
-  const auto count = sizeof(pairs) / sizeof(EGLNameErrorPair);
+  if (!SendWindowMetrics()) {
+    FLWAY_ERROR << "Could not update the window size." << std::endl;
+  }
+}
+
+// The EGL window itself is resized on the raster thread once the engine starts
+// rendering at the new size.
+bool WaylandDisplay::SendWindowMetrics() {
+  BufferGeometry geometry;
+  geometry.width = screen_width_ * buffer_scale_;
+  geometry.height = screen_height_ * buffer_scale_;
+  geometry.scale = buffer_scale_;
+
+  {
+    std::lock_guard<std::mutex> lock(geometry_mutex_);
+    sent_geometry_ = geometry;
+  }
+
+  if (!application_) {
+    return true;
+  }
+
+  metrics_sent_this_frame_ = true;
+  return application_->SetWindowSize(geometry.width, geometry.height,
+                                     geometry.scale);
+}
+
+// |flutter::WaylandConnection::Window|
+void WaylandDisplay::OnConnectionOutputsChanged() {
+  UpdateOutputState();
+}
+
+// |flutter::WaylandConnection::Window|
+void WaylandDisplay::OnConnectionOutputRemoved(wl_output* output) {
+  if (entered_outputs_.erase(output) == 0) {
+    return;
+  }
+
+  if (visibility_monitor_ && entered_outputs_.empty()) {
+    visibility_monitor_->SetOnOutput(false);
+  }
+}
+
+// |flutter::WaylandConnection::Window|
+uint64_t WaylandDisplay::GetRefreshPeriodNanos() const {
+  return vsync_waiter_ ? vsync_waiter_->GetRefreshPeriodNanos() : 0;
+}
+
+void WaylandDisplay::OnSurfaceEnter(wl_output* output) {
+  entered_outputs_.insert(output);
+  UpdateOutputState();
+
+  if (visibility_monitor_) {
+    visibility_monitor_->SetOnOutput(true);
+  }
+}
+
+void WaylandDisplay::OnSurfaceLeave(wl_output* output) {
+  entered_outputs_.erase(output);
+  UpdateOutputState();
 
-  EGLint last_error = eglGetError();
+  if (visibility_monitor_ && entered_outputs_.empty()) {
+    visibility_monitor_->SetOnOutput(false);
+  }
+}
+
+// Until the surface is mapped on an output, assume it could end up on any of
+// them.
+static bool IsRelevantOutput(const std::set<wl_output*>& entered_outputs,
+                             const WaylandOutput& output) {
+  return entered_outputs.empty() ||
+         entered_outputs.count(output.GetOutput()) != 0;
+}
 
-  for (size_t i = 0; i < count; i++) {
-    if (last_error == pairs[i].code) {
-      FLWAY_ERROR << "EGL Error: " << pairs[i].name << " (" << pairs[i].code
-                  << ")" << std::endl;
-      return;
+// The surface is rendered at the highest scale of the outputs it is on so it
+// is sharp on all of them, and paced to the fastest of them.
+void WaylandDisplay::UpdateOutputState() {
+  int32_t scale = 1;
+  double refresh_rate = 0.0;
+
+  const auto& outputs = connection_.GetOutputs();
+
+  for (const auto& output : outputs) {
+    if (!IsRelevantOutput(entered_outputs_, *output)) {
+      continue;
     }
+    scale = std::max(scale, output->GetScale());
+    refresh_rate = std::max(refresh_rate, output->GetRefreshRate());
   }
 
-  FLWAY_ERROR << "Unknown EGL Error" << std::endl;
+  // Older compositors cannot be told the buffer is scaled.
+  if (connection_.GetCompositorVersion() <
+      WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION) {
+    scale = 1;
+  }
+
+  if (refresh_rate != refresh_rate_) {
+    refresh_rate_ = refresh_rate;
+
+    if (vsync_waiter_) {
+      vsync_waiter_->SetRefreshRate(refresh_rate_);
+    }
+  }
+
+  // Only has an effect until the displays were first reported, for outputs
+  // announced after the application was set.
+  if (application_ && !SendDisplays()) {
+    FLWAY_ERROR << "Could not describe the displays to the engine."
+                << std::endl;
+  }
+
+  if (scale == buffer_scale_) {
+    return;
+  }
+
+  buffer_scale_ = scale;
+
+  if (application_ && !SendWindowMetrics()) {
+    FLWAY_ERROR << "Could not update the pixel ratio." << std::endl;
+  }
 }
 
-bool WaylandDisplay::SetupEGL() {
-  if (!compositor_ || !shell_) {
-    FLWAY_ERROR << "EGL setup needs missing compositor and shell connection."
+bool WaylandDisplay::SendDisplays() {
+  const WaylandOutput* primary = GetPrimaryOutput();
+  std::vector<FlutterEngineDisplay> displays;
+
+  const auto& outputs = connection_.GetOutputs();
+
+  for (const auto& output : outputs) {
+    FlutterEngineDisplay display = {};
+    display.struct_size = sizeof(display);
+    display.display_id = output->GetName();
+    display.single_display = outputs.size() == 1;
+    display.refresh_rate = output->GetRefreshRate();
+    display.width = output->GetModeWidth();
+    display.height = output->GetModeHeight();
+    display.device_pixel_ratio = output->GetScale();
+
+    if (output.get() == primary) {
+      displays.insert(displays.begin(), display);
+    } else {
+      displays.push_back(display);
+    }
+  }
+
+  return application_->SetDisplays(displays);
+}
+
+// The output the surface is on with the highest refresh rate, or the first one
+// announced before the surface is mapped.
+WaylandOutput* WaylandDisplay::GetPrimaryOutput() const {
+  WaylandOutput* primary = nullptr;
+
+  const auto& outputs = connection_.GetOutputs();
+
+  for (const auto& output : outputs) {
+    if (!IsRelevantOutput(entered_outputs_, *output)) {
+      continue;
+    }
+    if (!primary || output->GetRefreshRate() > primary->GetRefreshRate()) {
+      primary = output.get();
+    }
+  }
+
+  return primary;
+}
+
+static FlutterRect UnionRects(const FlutterRect& a, const FlutterRect& b) {
+  FlutterRect rect = {};
+  rect.left = std::min(a.left, b.left);
+  rect.top = std::min(a.top, b.top);
+  rect.right = std::max(a.right, b.right);
+  rect.bottom = std::max(a.bottom, b.bottom);
+  return rect;
+}
+
+bool WaylandDisplay::SetupShellSurface() {
+  static const char* kTitle = "Flutter";
+
+  WaylandOutput* primary_output = GetPrimaryOutput();
+  wl_output* output =
+      primary_output ? primary_output->GetOutput() : nullptr;
+
+  if (xdg_wm_base* xdg_wm_base = connection_.GetXdgWmBase()) {
+    shell_surface_.reset(new XdgShellSurface(
+        xdg_wm_base, surface_, kTitle, options_.fullscreen, output, *this));
+  } else if (wl_shell* shell = connection_.GetShell()) {
+    FLWAY_LOG << "Compositor does not support xdg-shell. Falling back to "
+                 "wl_shell."
+              << std::endl;
+    shell_surface_.reset(new LegacyShellSurface(
+        shell, surface_, kTitle, options_.fullscreen, output, *this));
+  } else {
+    FLWAY_ERROR << "Compositor supports neither xdg-shell nor wl_shell."
                 << std::endl;
     return false;
   }
 
-  surface_ = wl_compositor_create_surface(compositor_);
+  if (!shell_surface_->IsValid()) {
+    return false;
+  }
+
+  // Pick up the initial configure so the first frame is rendered at the size
+  // the shell wants.
+  wl_display_roundtrip(connection_.GetDisplay());
+  FlushPendingWindowSize();
+  surface_width_ = screen_width_ * buffer_scale_;
+  surface_height_ = screen_height_ * buffer_scale_;
+  return true;
+}
+
+bool WaylandDisplay::SetupEGL() {
+  surface_ = wl_compositor_create_surface(connection_.GetCompositor());
 
   if (!surface_) {
     FLWAY_ERROR << "Could not create compositor surface." << std::endl;
     return false;
   }
 
-  shell_surface_ = wl_shell_get_shell_surface(shell_, surface_);
+  wl_surface_add_listener(surface_, &kSurfaceListener, this);
+  connection_.AddWindow(surface_, *this);
+
+  if (!SetupShellSurface()) {
+    FLWAY_ERROR << "Could not setup the shell surface." << std::endl;
+    return false;
+  }
+
+  egl_display_ = connection_.GetEGLDisplay();
+
+  if (options_.presenter == EmbedderOptions::Presenter::kDmabuf &&
+      !SetupDmabufPresenter()) {
+    FLWAY_LOG << "Could not present dmabufs directly. Falling back to "
+                 "wayland-egl."
+              << std::endl;
+  }
+
+  if (options_.subsurfaces && !SetupSubsurfaceCompositor()) {
+    return false;
+  }
+
+  EGLConfig egl_config = nullptr;
 
-  if (!shell_surface_) {
-    FLWAY_ERROR << "Could not shell surface." << std::endl;
+  if (!ChooseOnscreenConfig(egl_config)) {
     return false;
   }
 
-  wl_shell_surface_add_listener(shell_surface_, &kShellSurfaceListener, this);
+  // The dmabuf presenter renders into framebuffers of its own, so the
+  // onscreen context is made current without a surface.
+  if (!dmabuf_presenter_ && !SetupWindowSurface(egl_config)) {
+    return false;
+  }
 
-  wl_shell_surface_set_title(shell_surface_, "Flutter");
+  // Create an EGL context with the match config, sharing with the other
+  // windows.
+  {
+    const EGLint attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
 
-  wl_shell_surface_set_toplevel(shell_surface_);
+    egl_context_ = eglCreateContext(egl_display_, egl_config,
+                                    connection_.GetShareContext(), attribs);
 
-  window_ = wl_egl_window_create(surface_, screen_width_, screen_height_);
+    if (egl_context_ == EGL_NO_CONTEXT) {
+      LogLastEGLError();
+      FLWAY_ERROR << "Could not create an onscreen context." << std::endl;
+      return false;
+    }
+  }
+
+  if (!SetupResourceContext(egl_config)) {
+    FLWAY_ERROR << "Could not setup the resource context." << std::endl;
+    return false;
+  }
+
+  SetupDamageExtensions();
+
+  return true;
+}
+
+bool WaylandDisplay::SetupWindowSurface(EGLConfig config) {
+  window_ = wl_egl_window_create(surface_, surface_width_, surface_height_);
 
   if (!window_) {
     FLWAY_ERROR << "Could not create EGL window." << std::endl;
     return false;
   }
 
-  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE) {
+  const EGLint attribs[] = {EGL_NONE};
+
+  egl_surface_ = eglCreateWindowSurface(egl_display_, config, window_, attribs);
+
+  if (egl_surface_ == EGL_NO_SURFACE) {
     LogLastEGLError();
-    FLWAY_ERROR << "Could not bind the ES API." << std::endl;
+    FLWAY_ERROR << "EGL surface was null during surface selection."
+                << std::endl;
     return false;
   }
 
-  egl_display_ = eglGetDisplay(display_);
-  if (egl_display_ == EGL_NO_DISPLAY) {
+  return true;
+}
+
+// An opaque buffer is a precondition for the compositor to promote the surface
+// to a hardware plane.
+uint32_t WaylandDisplay::GetDmabufFormat() const {
+  return options_.fullscreen ? GBM_FORMAT_XRGB8888 : GBM_FORMAT_ARGB8888;
+}
+
+bool WaylandDisplay::SetupDmabufPresenter() {
+  if (!connection_.GetLinuxDmabuf()) {
+    FLWAY_LOG << "Compositor does not support zwp_linux_dmabuf_v1."
+              << std::endl;
+    return false;
+  }
+
+  if (!HasEGLExtension(egl_display_, "EGL_KHR_surfaceless_context")) {
+    FLWAY_LOG << "EGL does not support surfaceless contexts." << std::endl;
+    return false;
+  }
+
+  dmabuf_presenter_ = CreateDmabufPresenter(surface_, GetDmabufFormat());
+  return dmabuf_presenter_ != nullptr;
+}
+
+std::unique_ptr<DmabufPresenter> WaylandDisplay::CreateDmabufPresenter(
+    wl_surface* surface,
+    uint32_t format) {
+  std::unique_ptr<DmabufPresenter> presenter(new DmabufPresenter(
+      connection_.GetDisplay(), surface, connection_.GetLinuxDmabuf(),
+      connection_.GetSyncobjManager(), egl_display_, format,
+      connection_.GetDmabufModifiers(format), options_.buffer_count));
+
+  if (!presenter->IsValid()) {
+    return nullptr;
+  }
+
+  return presenter;
+}
+
+// Layers above the window blend with it, so they always have alpha. With
+// --fullscreen, the window's surface stays opaque and hides platform views the
+// engine places below everything else.
+bool WaylandDisplay::SetupSubsurfaceCompositor() {
+  if (!dmabuf_presenter_ || !connection_.GetSubcompositor()) {
+    FLWAY_ERROR << "Presenting layers as subsurfaces needs the dmabuf "
+                   "presenter and wl_subcompositor."
+                << std::endl;
+    return false;
+  }
+
+  subsurface_compositor_.reset(new SubsurfaceCompositor(
+      connection_.GetCompositor(), connection_.GetSubcompositor(), surface_,
+      *dmabuf_presenter_,
+      [this](wl_surface* surface) {
+        return CreateDmabufPresenter(surface, GBM_FORMAT_ARGB8888);
+      },
+      *this));
+  return true;
+}
+
+// Choose an EGL config to use for the surface and context.
+bool WaylandDisplay::ChooseOnscreenConfig(EGLConfig& config) {
+  // An opaque buffer is a precondition for the compositor to promote the
+  // surface to a hardware plane.
+  const EGLint alpha_size = options_.fullscreen ? 0 : 8;
+  // Any config will do for rendering into the dmabuf presenter's buffers.
+  const EGLint surface_type = dmabuf_presenter_ ? 0 : EGL_WINDOW_BIT;
+
+  EGLint attribs[] = {
+      // clang-format off
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_SURFACE_TYPE,    surface_type,
+    EGL_RED_SIZE,        8,
+    EGL_GREEN_SIZE,      8,
+    EGL_BLUE_SIZE,       8,
+    EGL_ALPHA_SIZE,      alpha_size,
+    EGL_DEPTH_SIZE,      0,
+    EGL_STENCIL_SIZE,    0,
+    EGL_NONE,            // termination sentinel
+      // clang-format on
+  };
+
+  static const size_t kMaxConfigs = 64;
+  EGLConfig configs[kMaxConfigs] = {};
+  EGLint config_count = 0;
+
+  if (eglChooseConfig(egl_display_, attribs, configs, kMaxConfigs,
+                      &config_count) != EGL_TRUE) {
     LogLastEGLError();
-    FLWAY_ERROR << "Could not access EGL display." << std::endl;
+    FLWAY_ERROR << "Error when attempting to choose an EGL surface config."
+                << std::endl;
     return false;
   }
 
-  if (eglInitialize(egl_display_, nullptr, nullptr) != EGL_TRUE) {
+  if (config_count == 0 || configs[0] == nullptr) {
     LogLastEGLError();
-    FLWAY_ERROR << "Could not initialize EGL display." << std::endl;
+    FLWAY_ERROR << "No matching configs." << std::endl;
     return false;
   }
 
-  EGLConfig egl_config = nullptr;
+  config = configs[0];
+
+  if (!options_.fullscreen || dmabuf_presenter_) {
+    return true;
+  }
+
+  // eglChooseConfig treats the alpha size as a minimum. Look for a config
+  // whose buffers are XRGB8888, the format display controllers scan out.
+  const EGLint kXRGB8888 = 'X' | ('R' << 8) | ('2' << 16) | ('4' << 24);
+  for (EGLint i = 0; i < config_count; i++) {
+    EGLint visual = 0;
+    EGLint alpha = 0;
+    if (eglGetConfigAttrib(egl_display_, configs[i], EGL_NATIVE_VISUAL_ID,
+                           &visual) == EGL_TRUE &&
+        eglGetConfigAttrib(egl_display_, configs[i], EGL_ALPHA_SIZE, &alpha) ==
+            EGL_TRUE &&
+        visual == kXRGB8888 && alpha == 0) {
+      config = configs[i];
+      return true;
+    }
+  }
+
+  FLWAY_LOG << "No XRGB8888 config available. Direct scanout may not be "
+               "possible."
+            << std::endl;
+  return true;
+}
+
+bool WaylandDisplay::SetupResourceContext(EGLConfig onscreen_config) {
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+
+  // Prefer a context that does not need a surface at all.
+  if (HasEGLExtension(egl_display_, "EGL_KHR_surfaceless_context")) {
+    resource_context_ = eglCreateContext(egl_display_, onscreen_config,
+                                         egl_context_, context_attribs);
+
+    if (resource_context_ == EGL_NO_CONTEXT) {
+      LogLastEGLError();
+      FLWAY_ERROR << "Could not create the resource context." << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  // Otherwise, bind the resource context to a tiny pbuffer. The onscreen
+  // config may not support pbuffers so pick one that does.
+  EGLConfig pbuffer_config = nullptr;
 
-  // Choose an EGL config to use for the surface and context.
   {
-    EGLint attribs[] = {
+    const EGLint attribs[] = {
         // clang-format off
       EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-      EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
+      EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
       EGL_RED_SIZE,        8,
       EGL_GREEN_SIZE,      8,
       EGL_BLUE_SIZE,       8,
       EGL_ALPHA_SIZE,      8,
-      EGL_DEPTH_SIZE,      0,
-      EGL_STENCIL_SIZE,    0,
       EGL_NONE,            // termination sentinel
         // clang-format on
     };
 
     EGLint config_count = 0;
 
-    if (eglChooseConfig(egl_display_, attribs, &egl_config, 1, &config_count) !=
-        EGL_TRUE) {
+    if (eglChooseConfig(egl_display_, attribs, &pbuffer_config, 1,
+                        &config_count) != EGL_TRUE ||
+        config_count == 0 || pbuffer_config == nullptr) {
       LogLastEGLError();
-      FLWAY_ERROR << "Error when attempting to choose an EGL surface config."
+      FLWAY_ERROR << "No matching configs for the resource context."
                   << std::endl;
       return false;
     }
-
-    if (config_count == 0 || egl_config == nullptr) {
-      LogLastEGLError();
-      FLWAY_ERROR << "No matching configs." << std::endl;
-      return false;
-    }
   }
 
-  // Create an EGL window surface with the matched config.
   {
-    const EGLint attribs[] = {EGL_NONE};
+    const EGLint attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
 
-    egl_surface_ =
-        eglCreateWindowSurface(egl_display_, egl_config, window_, attribs);
+    resource_surface_ =
+        eglCreatePbufferSurface(egl_display_, pbuffer_config, attribs);
 
-    if (surface_ == EGL_NO_SURFACE) {
+    if (resource_surface_ == EGL_NO_SURFACE) {
       LogLastEGLError();
-      FLWAY_ERROR << "EGL surface was null during surface selection."
-                  << std::endl;
+      FLWAY_ERROR << "Could not create the resource surface." << std::endl;
       return false;
     }
   }
 
-  // Create an EGL context with the match config.
-  {
-    const EGLint attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
-
-    egl_context_ = eglCreateContext(egl_display_, egl_config,
-                                    nullptr /* share group */, attribs);
+  resource_context_ = eglCreateContext(egl_display_, pbuffer_config,
+                                       egl_context_, context_attribs);
 
-    if (egl_context_ == EGL_NO_CONTEXT) {
-      LogLastEGLError();
-      FLWAY_ERROR << "Could not create an onscreen context." << std::endl;
-      return false;
-    }
+  if (resource_context_ == EGL_NO_CONTEXT) {
+    LogLastEGLError();
+    FLWAY_ERROR << "Could not create the resource context." << std::endl;
+    return false;
   }
 
   return true;
 }
 
-void WaylandDisplay::AnnounceRegistryInterface(struct wl_registry* wl_registry,
-                                               uint32_t name,
-                                               const char* interface_name,
-                                               uint32_t version) {
-  if (strcmp(interface_name, "wl_compositor") == 0) {
-    compositor_ = static_cast<decltype(compositor_)>(
-        wl_registry_bind(wl_registry, name, &wl_compositor_interface, 1));
+void WaylandDisplay::SetupDamageExtensions() {
+  // Both variants have the same signature and semantics. With a wl_surface of
+  // version 4 or higher, the driver forwards the rects to
+  // wl_surface.damage_buffer.
+  if (HasEGLExtension(egl_display_, "EGL_KHR_swap_buffers_with_damage")) {
+    swap_buffers_with_damage_ =
+        reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+  } else if (HasEGLExtension(egl_display_,
+                             "EGL_EXT_swap_buffers_with_damage")) {
+    swap_buffers_with_damage_ =
+        reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+  }
+
+  // Partial repaint is only possible if we know how stale the back buffer is.
+  has_buffer_age_ = HasEGLExtension(egl_display_, "EGL_EXT_buffer_age");
+
+  if (!swap_buffers_with_damage_) {
+    FLWAY_LOG << "EGL does not support swapping with damage. The whole "
+                 "surface will be presented every frame."
+              << std::endl;
+  }
+}
+
+FlutterRect WaylandDisplay::GetSurfaceRect() const {
+  FlutterRect rect = {};
+  rect.right = surface_width_;
+  rect.bottom = surface_height_;
+  return rect;
+}
+
+// The buffer scale and the opaque region are double buffered state of the
+// surface and are applied by the commit of the frame they are set before.
+void WaylandDisplay::UpdateBufferScale() {
+  int32_t scale = applied_buffer_scale_;
+
+  // Only switch scales once the engine renders at the size that goes with the
+  // new scale.
+  {
+    std::lock_guard<std::mutex> lock(geometry_mutex_);
+    if (surface_width_ == sent_geometry_.width &&
+        surface_height_ == sent_geometry_.height) {
+      scale = sent_geometry_.scale;
+    }
+  }
+
+  // The compositor rejects buffers that are not a whole number of surface
+  // units.
+  if (surface_width_ % scale != 0 || surface_height_ % scale != 0) {
+    scale = 1;
+  }
+
+  if (scale == applied_buffer_scale_) {
     return;
   }
 
-  if (strcmp(interface_name, "wl_shell") == 0) {
-    shell_ = static_cast<decltype(shell_)>(
-        wl_registry_bind(wl_registry, name, &wl_shell_interface, 1));
+  wl_surface_set_buffer_scale(surface_, scale);
+  applied_buffer_scale_ = scale;
+}
+
+void WaylandDisplay::UpdateOpaqueRegion() {
+  const int width = surface_width_ / applied_buffer_scale_;
+  const int height = surface_height_ / applied_buffer_scale_;
+
+  if (!options_.fullscreen ||
+      (opaque_region_width_ == width && opaque_region_height_ == height)) {
     return;
   }
+
+  wl_region* region = wl_compositor_create_region(connection_.GetCompositor());
+  wl_region_add(region, 0, 0, width, height);
+  wl_surface_set_opaque_region(surface_, region);
+  wl_region_destroy(region);
+
+  opaque_region_width_ = width;
+  opaque_region_height_ = height;
+}
+
+void WaylandDisplay::BeginPresent() {
+  RecordTimingEvent(TimingEvent::kPresentBegin, surface_);
+
+  if (!first_frame_presented_) {
+    first_frame_presented_ = true;
+    RecordStartupMilestone("first frame");
+    ReportStartupMilestones();
+  }
 }
 
-void WaylandDisplay::UnannounceRegistryInterface(
-    struct wl_registry* wl_registry,
-    uint32_t name) {}
+void WaylandDisplay::PrepareSurfaceCommit() {
+  UpdateBufferScale();
+  UpdateOpaqueRegion();
+
+  // Acknowledge any configure this frame satisfies as part of the same commit.
+  shell_surface_->OnSurfaceWillCommit(surface_width_ / applied_buffer_scale_,
+                                      surface_height_ / applied_buffer_scale_);
+
+  // Ask for the next frame callback as part of the commit performed by the
+  // present.
+  vsync_waiter_->OnSurfaceWillCommit();
+}
+
+void WaylandDisplay::RecordFrameDamage(const FlutterRect& damage) {
+  std::move_backward(damage_history_.begin(), damage_history_.end() - 1,
+                     damage_history_.end());
+  damage_history_[0] = damage;
+  damage_history_count_ =
+      std::min(damage_history_count_ + 1, damage_history_.size());
+}
 
 // |flutter::FlutterApplication::RenderDelegate|
 bool WaylandDisplay::OnApplicationContextMakeCurrent() {
@@ -342,6 +963,8 @@ bool WaylandDisplay::OnApplicationContextMakeCurrent() {
     return false;
   }
 
+  FLWAY_TRACE_SCOPE("WaylandDisplay::MakeCurrent");
+
   if (eglMakeCurrent(egl_display_, egl_surface_, egl_surface_, egl_context_) !=
       EGL_TRUE) {
     LogLastEGLError();
@@ -349,9 +972,39 @@ bool WaylandDisplay::OnApplicationContextMakeCurrent() {
     return false;
   }
 
+  // The swap interval is per-surface state that can only be set while the
+  // surface is current on the raster thread.
+  if (!swap_interval_configured_.exchange(true) && !ConfigureSwapInterval()) {
+    return false;
+  }
+
   return true;
 }
 
+bool WaylandDisplay::ConfigureSwapInterval() {
+  // There is no window surface. Presents block on buffer releases instead.
+  if (dmabuf_presenter_) {
+    return true;
+  }
+
+  switch (options_.present_mode) {
+    case EmbedderOptions::PresentMode::kDriver:
+      return true;
+    case EmbedderOptions::PresentMode::kThrottled:
+      // Presents must never wait on the compositor inside the driver. The
+      // vsync waiter already withholds frames until the compositor is ready
+      // for them.
+      if (eglSwapInterval(egl_display_, 0) != EGL_TRUE) {
+        LogLastEGLError();
+        FLWAY_ERROR << "Could not set the swap interval." << std::endl;
+        return false;
+      }
+      return true;
+  }
+
+  return false;
+}
+
 // |flutter::FlutterApplication::RenderDelegate|
 bool WaylandDisplay::OnApplicationContextClearCurrent() {
   if (!valid_) {
@@ -359,6 +1012,8 @@ bool WaylandDisplay::OnApplicationContextClearCurrent() {
     return false;
   }
 
+  FLWAY_TRACE_SCOPE("WaylandDisplay::ClearCurrent");
+
   if (eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
                      EGL_NO_CONTEXT) != EGL_TRUE) {
     LogLastEGLError();
@@ -369,16 +1024,28 @@ bool WaylandDisplay::OnApplicationContextClearCurrent() {
   return true;
 }
 
+bool WaylandDisplay::WaitForEGLSetup() {
+  std::unique_lock<std::mutex> lock(egl_setup_mutex_);
+  egl_setup_cv_.wait(lock, [this]() { return egl_setup_done_; });
+  return egl_ready_;
+}
+
 // |flutter::FlutterApplication::RenderDelegate|
-bool WaylandDisplay::OnApplicationPresent() {
-  if (!valid_) {
+bool WaylandDisplay::OnApplicationResourceContextMakeCurrent() {
+  // The engine creates its resource context while it is being initialized,
+  // which may be before the display is done connecting.
+  if (!WaitForEGLSetup()) {
     FLWAY_ERROR << "Invalid display." << std::endl;
     return false;
   }
 
-  if (eglSwapBuffers(egl_display_, egl_surface_) != EGL_TRUE) {
+  FLWAY_TRACE_SCOPE("WaylandDisplay::ResourceMakeCurrent");
+
+  if (eglMakeCurrent(egl_display_, resource_surface_, resource_surface_,
+                     resource_context_) != EGL_TRUE) {
     LogLastEGLError();
-    FLWAY_ERROR << "Could not swap the EGL buffer." << std::endl;
+    FLWAY_ERROR << "Could not make the resource context current."
+                << std::endl;
     return false;
   }
 
@@ -386,13 +1053,230 @@ bool WaylandDisplay::OnApplicationPresent() {
 }
 
 // |flutter::FlutterApplication::RenderDelegate|
-uint32_t WaylandDisplay::OnApplicationGetOnscreenFBO() {
+bool WaylandDisplay::OnApplicationPresent(const FlutterRect* damage,
+                                          size_t damage_count) {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("WaylandDisplay::Present");
+  std::lock_guard<std::mutex> lock(present_mutex_);
+  BeginPresent();
+
+  FlutterRect frame_damage = {};
+
+  if (damage == nullptr || damage_count == 0) {
+    frame_damage = GetSurfaceRect();
+  } else {
+    frame_damage = damage[0];
+    for (size_t i = 1; i < damage_count; i++) {
+      frame_damage = UnionRects(frame_damage, damage[i]);
+    }
+  }
+
+  RecordFrameDamage(frame_damage);
+
+  PrepareSurfaceCommit();
+
+  if (dmabuf_presenter_) {
+    const bool presented = dmabuf_presenter_->Present(damage, damage_count);
+    RecordTimingEvent(TimingEvent::kPresentEnd, surface_);
+    return presented;
+  }
+
+  if (!swap_buffers_with_damage_ || damage == nullptr || damage_count == 0) {
+    FLWAY_TRACE_SCOPE("WaylandDisplay::SwapBuffers");
+    if (eglSwapBuffers(egl_display_, egl_surface_) != EGL_TRUE) {
+      LogLastEGLError();
+      FLWAY_ERROR << "Could not swap the EGL buffer." << std::endl;
+      return false;
+    }
+    RecordTimingEvent(TimingEvent::kPresentEnd, surface_);
+    return true;
+  }
+
+  // EGL rects are x, y, width, height with the origin at the bottom left.
+  auto& rects = swap_damage_rects_;
+  rects.clear();
+  for (size_t i = 0; i < damage_count; i++) {
+    const auto& rect = damage[i];
+    rects.push_back(static_cast<EGLint>(rect.left));
+    rects.push_back(static_cast<EGLint>(surface_height_ - rect.bottom));
+    rects.push_back(static_cast<EGLint>(rect.right - rect.left));
+    rects.push_back(static_cast<EGLint>(rect.bottom - rect.top));
+  }
+
+  {
+    FLWAY_TRACE_SCOPE("WaylandDisplay::SwapBuffersWithDamage");
+    if (swap_buffers_with_damage_(egl_display_, egl_surface_, rects.data(),
+                                  damage_count) != EGL_TRUE) {
+      LogLastEGLError();
+      FLWAY_ERROR << "Could not swap the EGL buffer with damage." << std::endl;
+      return false;
+    }
+  }
+
+  RecordTimingEvent(TimingEvent::kPresentEnd, surface_);
+  return true;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+void WaylandDisplay::OnApplicationPopulateExistingDamage(
+    FlutterDamage* existing_damage) {
+  existing_damage->num_rects = 1;
+  existing_damage->damage = &existing_damage_;
+
+  EGLint age = 0;
+  if (dmabuf_presenter_) {
+    age = dmabuf_presenter_->GetBufferAge();
+  } else if (has_buffer_age_ && valid_ &&
+             eglQuerySurface(egl_display_, egl_surface_, EGL_BUFFER_AGE_EXT,
+                             &age) != EGL_TRUE) {
+    age = 0;
+  }
+
+  // An age of zero means the contents are undefined. An age of N means the
+  // buffer holds the frame presented N swaps ago and is missing the damage of
+  // every frame since.
+  if (age <= 0 || static_cast<size_t>(age) > damage_history_count_ + 1) {
+    existing_damage_ = GetSurfaceRect();
+    return;
+  }
+
+  existing_damage_ = {};
+  for (EGLint i = 0; i < age - 1; i++) {
+    existing_damage_ =
+        i == 0 ? damage_history_[i]
+               : UnionRects(existing_damage_, damage_history_[i]);
+  }
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+uint32_t WaylandDisplay::OnApplicationGetOnscreenFBO(size_t frame_width,
+                                                     size_t frame_height) {
   if (!valid_) {
     FLWAY_ERROR << "Invalid display." << std::endl;
     return 999;
   }
 
+  // Resizing here keeps the window and the frame the engine is about to render
+  // in lockstep. The driver allocates buffers of the new size on the next
+  // draw, so neither the EGL surface nor the context are recreated.
+  if (frame_width != 0 && frame_height != 0 &&
+      (static_cast<int>(frame_width) != surface_width_ ||
+       static_cast<int>(frame_height) != surface_height_)) {
+    FLWAY_TRACE_SCOPE("WaylandDisplay::ResizeWindow");
+    surface_width_ = frame_width;
+    surface_height_ = frame_height;
+    if (window_) {
+      wl_egl_window_resize(window_, surface_width_, surface_height_, 0, 0);
+    }
+    // The previous contents are of no use at the new size.
+    damage_history_count_ = 0;
+  }
+
+  if (dmabuf_presenter_) {
+    return dmabuf_presenter_->AcquireFramebuffer(surface_width_,
+                                                 surface_height_);
+  }
+
   return 0;  // FBO0
 }
 
+// |flutter::FlutterApplication::RenderDelegate|
+void WaylandDisplay::OnApplicationRequestVsync(VsyncCallback callback) {
+  if (!valid_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return;
+  }
+
+  if (!pointer_coalescer_) {
+    vsync_waiter_->AsyncWaitForVsync(std::move(callback));
+  } else {
+    // Held input must reach the engine before the frame it belongs to starts.
+    vsync_waiter_->AsyncWaitForVsync(
+        [this, callback](uint64_t frame_start_nanos,
+                         uint64_t frame_target_nanos) {
+          pointer_coalescer_->Flush(frame_target_nanos);
+          callback(frame_start_nanos, frame_target_nanos);
+        });
+  }
+
+  if (visibility_monitor_ && vsync_waiter_->HasPendingVsync()) {
+    visibility_monitor_->OnFrameRequested();
+  }
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationRotatesFBOs() const {
+  return options_.presenter == EmbedderOptions::Presenter::kDmabuf;
+}
+
+wl_surface* WaylandDisplay::CreatePlatformViewSurface(int64_t view_id) {
+  if (!subsurface_compositor_) {
+    return nullptr;
+  }
+
+  return subsurface_compositor_->CreatePlatformViewSurface(view_id);
+}
+
+void WaylandDisplay::DestroyPlatformViewSurface(int64_t view_id) {
+  if (subsurface_compositor_) {
+    subsurface_compositor_->DestroyPlatformViewSurface(view_id);
+  }
+}
+
+// |flutter::SubsurfaceCompositor::Delegate|
+int32_t WaylandDisplay::OnCompositorWillCommitRoot(int width, int height) {
+  surface_width_ = width;
+  surface_height_ = height;
+  PrepareSurfaceCommit();
+  return applied_buffer_scale_;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationComposesLayers() const {
+  return options_.subsurfaces;
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationCreateBackingStore(
+    const FlutterBackingStoreConfig* config,
+    FlutterBackingStore* backing_store) {
+  if (!valid_ || !subsurface_compositor_) {
+    return false;
+  }
+
+  return subsurface_compositor_->CreateBackingStore(*config, *backing_store);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationCollectBackingStore(
+    const FlutterBackingStore* backing_store) {
+  if (!subsurface_compositor_) {
+    return false;
+  }
+
+  return subsurface_compositor_->CollectBackingStore(*backing_store);
+}
+
+// |flutter::FlutterApplication::RenderDelegate|
+bool WaylandDisplay::OnApplicationPresentLayers(const FlutterLayer** layers,
+                                                size_t layers_count) {
+  if (!valid_ || !subsurface_compositor_) {
+    FLWAY_ERROR << "Invalid display." << std::endl;
+    return false;
+  }
+
+  FLWAY_TRACE_SCOPE("WaylandDisplay::PresentLayers");
+  std::lock_guard<std::mutex> lock(present_mutex_);
+  BeginPresent();
+
+  const bool presented =
+      subsurface_compositor_->PresentLayers(layers, layers_count);
+  RecordTimingEvent(TimingEvent::kPresentEnd, surface_);
+  return presented;
+}
+
 }  // namespace flutter
@@ -5,55 +5,246 @@
 #pragma once
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <wayland-client.h>
 #include <wayland-egl.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 
+#include "dmabuf_presenter.h"
+#include "embedder_options.h"
+#include "event_loop.h"
 #include "flutter_application.h"
+#include "instrumentation.h"
 #include "macros.h"
+#include "pointer_coalescer.h"
+#include "shell_surface.h"
+#include "subsurface_compositor.h"
+#include "visibility_monitor.h"
+#include "vsync_waiter.h"
+#include "wayland_connection.h"
+#include "wayland_output.h"
+#include "wayland_seat.h"
 
 namespace flutter {
 
-class WaylandDisplay : public FlutterApplication::RenderDelegate {
+// A window showing the frames of one engine. Any number of them may share a
+// connection, each with an engine of its own.
+class WaylandDisplay : public FlutterApplication::RenderDelegate,
+                       public ShellSurface::Delegate,
+                       public SubsurfaceCompositor::Delegate,
+                       public WaylandConnection::Window {
  public:
-  WaylandDisplay(size_t width, size_t height);
+  // |connection| must outlive the display.
+  WaylandDisplay(WaylandConnection& connection,
+                 size_t width,
+                 size_t height,
+                 const EmbedderOptions& options);
 
   ~WaylandDisplay();
 
+  // Connects |connection| unless another window already did, waits for the
+  // initial shell configure, and sets up the window's EGL contexts. Touches
+  // neither the event loop nor the application, so it may run on another
+  // thread while the engine starts up. Must return before any other method is
+  // called on the event loop thread.
+  bool Connect();
+
+  // Called on the event loop thread after |Connect|. Starts dispatching the
+  // connection and input on the event loop.
+  bool AttachToEventLoop();
+
   bool IsValid() const;
 
-  bool Run();
+  // Window metrics changes are forwarded to |application|. Sends the current
+  // metrics right away.
+  bool SetApplication(FlutterApplication* application);
+
+  // The surface to show the platform view |view_id| in. See
+  // |SubsurfaceCompositor::CreatePlatformViewSurface|. Returns null unless
+  // layers are presented as subsurfaces. For programs that link the embedder
+  // library and render native content of their own. flutter_wayland itself
+  // has no platform views.
+  wl_surface* CreatePlatformViewSurface(int64_t view_id);
+
+  void DestroyPlatformViewSurface(int64_t view_id);
 
  private:
-  static const wl_registry_listener kRegistryListener;
-  static const wl_shell_surface_listener kShellSurfaceListener;
+  static const wl_surface_listener kSurfaceListener;
+
+  // Size in physical pixels and scale of the frames the engine was last asked
+  // to render.
+  struct BufferGeometry {
+    int width = 0;
+    int height = 0;
+    int32_t scale = 1;
+  };
+
+  WaylandConnection& connection_;
+  EventLoop& event_loop_;
+  const EmbedderOptions options_;
   bool valid_ = false;
-  const int screen_width_;
-  const int screen_height_;
-  wl_display* display_ = nullptr;
-  wl_registry* registry_ = nullptr;
-  wl_compositor* compositor_ = nullptr;
-  wl_shell* shell_ = nullptr;
-  wl_shell_surface* shell_surface_ = nullptr;
+  // Signaled once |Connect| is done, successful or not. The engine may ask for
+  // its resource context from the IO thread before that.
+  std::mutex egl_setup_mutex_;
+  std::condition_variable egl_setup_cv_;
+  bool egl_setup_done_ = false;
+  bool egl_ready_ = false;
+  FlutterApplication* application_ = nullptr;
+  // Window size requested by the shell in surface coordinates. Only accessed
+  // on the platform thread.
+  int screen_width_;
+  int screen_height_;
+  int pending_width_ = 0;
+  int pending_height_ = 0;
+  bool metrics_sent_this_frame_ = false;
+  // Outputs the surface is on. Only accessed on the platform thread.
+  std::set<wl_output*> entered_outputs_;
+  int32_t buffer_scale_ = 1;
+  double refresh_rate_ = 0.0;
+  std::mutex geometry_mutex_;
+  BufferGeometry sent_geometry_;
+  // Size of the EGL window in physical pixels and the buffer scale last set on
+  // the surface. Only accessed on the raster thread.
+  int surface_width_;
+  int surface_height_;
+  int32_t applied_buffer_scale_ = 1;
+  // Held by the raster thread while it stages a frame on |surface_| and
+  // commits it, and by commits of |surface_| from other threads.
+  std::mutex present_mutex_;
+  std::unique_ptr<ShellSurface> shell_surface_;
+  std::vector<FlutterPointerEvent> scaled_pointer_events_;
+  std::unique_ptr<PointerCoalescer> pointer_coalescer_;
+  std::unique_ptr<DmabufPresenter> dmabuf_presenter_;
+  std::unique_ptr<SubsurfaceCompositor> subsurface_compositor_;
   wl_surface* surface_ = nullptr;
   wl_egl_window* window_ = nullptr;
   EGLDisplay egl_display_ = EGL_NO_DISPLAY;
   EGLSurface egl_surface_ = nullptr;
   EGLContext egl_context_ = EGL_NO_CONTEXT;
+  EGLContext resource_context_ = EGL_NO_CONTEXT;
+  EGLSurface resource_surface_ = EGL_NO_SURFACE;
+  std::unique_ptr<VsyncWaiter> vsync_waiter_;
+  // Only with |EmbedderOptions::power_saving|.
+  std::unique_ptr<VisibilityMonitor> visibility_monitor_;
+  std::atomic_bool swap_interval_configured_;
+  PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swap_buffers_with_damage_ = nullptr;
+  bool has_buffer_age_ = false;
+
+  // Frame damage of the most recent presents, newest first. Only accessed on
+  // the raster thread.
+  static const size_t kDamageHistorySize = 4;
+  std::array<FlutterRect, kDamageHistorySize> damage_history_;
+  size_t damage_history_count_ = 0;
+  bool first_frame_presented_ = false;
+  FlutterRect existing_damage_ = {};
+  // Size of the opaque region last set on the surface in surface coordinates.
+  // Raster thread only.
+  int opaque_region_width_ = 0;
+  int opaque_region_height_ = 0;
+  std::vector<EGLint> swap_damage_rects_;
+
+  bool SetupWindow();
+
+  bool WaitForEGLSetup();
+
+  bool SetupShellSurface();
 
   bool SetupEGL();
 
-  void AnnounceRegistryInterface(struct wl_registry* wl_registry,
-                                 uint32_t name,
-                                 const char* interface,
-                                 uint32_t version);
+  void OnFrameDone();
+
+  void ProbeFrameCallback();
+
+  void OnVisibilityChanged(bool visible);
+
+  bool SendLifecycleState();
+
+  void FlushPendingWindowSize();
+
+  bool SendWindowMetrics();
+
+  void SendPointerEvents(const FlutterPointerEvent* events, size_t count);
+
+  void OnSurfaceEnter(wl_output* output);
+
+  void OnSurfaceLeave(wl_output* output);
+
+  void UpdateOutputState();
+
+  bool SendDisplays();
+
+  WaylandOutput* GetPrimaryOutput() const;
+
+  bool ChooseOnscreenConfig(EGLConfig& config);
+
+  uint32_t GetDmabufFormat() const;
+
+  std::unique_ptr<DmabufPresenter> CreateDmabufPresenter(wl_surface* surface,
+                                                         uint32_t format);
+
+  bool SetupDmabufPresenter();
+
+  bool SetupSubsurfaceCompositor();
+
+  bool SetupWindowSurface(EGLConfig config);
+
+  bool SetupResourceContext(EGLConfig onscreen_config);
+
+  void UpdateBufferScale();
+
+  void UpdateOpaqueRegion();
 
-  void UnannounceRegistryInterface(struct wl_registry* wl_registry,
-                                   uint32_t name);
+  void BeginPresent();
 
-  bool StopRunning();
+  // Adds the state that goes with a new frame to the commit of |surface_|.
+  void PrepareSurfaceCommit();
+
+  bool ConfigureSwapInterval();
+
+  void SetupDamageExtensions();
+
+  FlutterRect GetSurfaceRect() const;
+
+  void RecordFrameDamage(const FlutterRect& damage);
+
+  // |flutter::ShellSurface::Delegate|
+  void OnShellSurfaceConfigure(int32_t width, int32_t height) override;
+
+  // |flutter::ShellSurface::Delegate|
+  void OnShellSurfaceClose() override;
+
+  // |flutter::ShellSurface::Delegate|
+  void OnShellSurfaceSuspended(bool suspended) override;
+
+  // |flutter::ShellSurface::Delegate|
+  void OnShellSurfaceNeedsCommit() override;
+
+  // |flutter::SubsurfaceCompositor::Delegate|
+  int32_t OnCompositorWillCommitRoot(int width, int height) override;
+
+  // |flutter::WaylandConnection::Window|
+  void OnConnectionOutputsChanged() override;
+
+  // |flutter::WaylandConnection::Window|
+  void OnConnectionOutputRemoved(wl_output* output) override;
+
+  // |flutter::WaylandConnection::Window|
+  void OnConnectionPointerEvents(const FlutterPointerEvent* events,
+                                 size_t count) override;
+
+  // |flutter::WaylandConnection::Window|
+  void OnConnectionKeyEvent(const WaylandSeat::KeyEvent& event) override;
+
+  // |flutter::WaylandConnection::Window|
+  uint64_t GetRefreshPeriodNanos() const override;
 
   // |flutter::FlutterApplication::RenderDelegate|
   bool OnApplicationContextMakeCurrent() override;
@@ -62,10 +253,41 @@ class WaylandDisplay : public FlutterApplication::RenderDelegate {
   bool OnApplicationContextClearCurrent() override;
 
   // |flutter::FlutterApplication::RenderDelegate|
-  bool OnApplicationPresent() override;
+  bool OnApplicationResourceContextMakeCurrent() override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationPresent(const FlutterRect* damage,
+                            size_t damage_count) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationPopulateExistingDamage(
+      FlutterDamage* existing_damage) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  uint32_t OnApplicationGetOnscreenFBO(size_t frame_width,
+                                       size_t frame_height) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  void OnApplicationRequestVsync(VsyncCallback callback) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationRotatesFBOs() const override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationComposesLayers() const override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCreateBackingStore(
+      const FlutterBackingStoreConfig* config,
+      FlutterBackingStore* backing_store) override;
+
+  // |flutter::FlutterApplication::RenderDelegate|
+  bool OnApplicationCollectBackingStore(
+      const FlutterBackingStore* backing_store) override;
 
   // |flutter::FlutterApplication::RenderDelegate|
-  uint32_t OnApplicationGetOnscreenFBO() override;
+  bool OnApplicationPresentLayers(const FlutterLayer** layers,
+                                  size_t layers_count) override;
 
   FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandDisplay);
 };
@@ -0,0 +1,110 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "wayland_output.h"
+
+#include <algorithm>
+
+namespace flutter {
+
+#define OUTPUT reinterpret_cast<WaylandOutput*>(data)
+
+const wl_output_listener WaylandOutput::kOutputListener = {
+    .geometry = [](void* data,
+                   struct wl_output* wl_output,
+                   int32_t x,
+                   int32_t y,
+                   int32_t physical_width,
+                   int32_t physical_height,
+                   int32_t subpixel,
+                   const char* make,
+                   const char* model,
+                   int32_t transform) -> void {
+      // Nothing to do.
+    },
+
+    .mode = [](void* data,
+               struct wl_output* wl_output,
+               uint32_t flags,
+               int32_t width,
+               int32_t height,
+               int32_t refresh) -> void {
+      if ((flags & WL_OUTPUT_MODE_CURRENT) == 0) {
+        return;
+      }
+
+      OUTPUT->mode_width_ = width;
+      OUTPUT->mode_height_ = height;
+      OUTPUT->refresh_millihertz_ = refresh;
+
+      // Version 1 outputs never send done. Each mode is final.
+      if (OUTPUT->version_ < WL_OUTPUT_DONE_SINCE_VERSION) {
+        OUTPUT->on_change_(*OUTPUT);
+      }
+    },
+
+    .done = [](void* data, struct wl_output* wl_output) -> void {
+      OUTPUT->on_change_(*OUTPUT);
+    },
+
+    .scale = [](void* data, struct wl_output* wl_output, int32_t factor)
+        -> void { OUTPUT->scale_ = std::max(factor, 1); },
+};
+
+#undef OUTPUT
+
+WaylandOutput::WaylandOutput(wl_registry* registry,
+                             uint32_t name,
+                             uint32_t version,
+                             ChangeCallback on_change)
+    : name_(name),
+      version_(std::min(version, 2u)),
+      on_change_(std::move(on_change)) {
+  output_ = static_cast<decltype(output_)>(
+      wl_registry_bind(registry, name, &wl_output_interface, version_));
+
+  if (!output_) {
+    FLWAY_ERROR << "Could not bind the output." << std::endl;
+    return;
+  }
+
+  wl_output_add_listener(output_, &kOutputListener, this);
+}
+
+WaylandOutput::~WaylandOutput() {
+  if (output_) {
+    wl_output_destroy(output_);
+    output_ = nullptr;
+  }
+}
+
+bool WaylandOutput::IsValid() const {
+  return output_ != nullptr;
+}
+
+uint32_t WaylandOutput::GetName() const {
+  return name_;
+}
+
+wl_output* WaylandOutput::GetOutput() const {
+  return output_;
+}
+
+int32_t WaylandOutput::GetScale() const {
+  return scale_;
+}
+
+int32_t WaylandOutput::GetModeWidth() const {
+  return mode_width_;
+}
+
+int32_t WaylandOutput::GetModeHeight() const {
+  return mode_height_;
+}
+
+double WaylandOutput::GetRefreshRate() const {
+  return refresh_millihertz_ / 1000.0;
+}
+
+}  // namespace flutter
@@ -0,0 +1,62 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <wayland-client.h>
+
+#include <functional>
+
+#include "macros.h"
+
+namespace flutter {
+
+// Tracks the geometry, current mode and scale of a single wl_output global.
+// All callbacks happen on the thread that dispatches the Wayland connection.
+class WaylandOutput {
+ public:
+  // Invoked once the compositor has sent a consistent set of properties,
+  // initially and after every change.
+  using ChangeCallback = std::function<void(WaylandOutput& output)>;
+
+  WaylandOutput(wl_registry* registry,
+                uint32_t name,
+                uint32_t version,
+                ChangeCallback on_change);
+
+  ~WaylandOutput();
+
+  bool IsValid() const;
+
+  // The registry name of the global. Used as the engine display ID.
+  uint32_t GetName() const;
+
+  wl_output* GetOutput() const;
+
+  int32_t GetScale() const;
+
+  // Size of the current mode in hardware pixels.
+  int32_t GetModeWidth() const;
+
+  int32_t GetModeHeight() const;
+
+  // Zero if the compositor did not report a refresh rate.
+  double GetRefreshRate() const;
+
+ private:
+  static const wl_output_listener kOutputListener;
+
+  const uint32_t name_;
+  const uint32_t version_;
+  ChangeCallback on_change_;
+  wl_output* output_ = nullptr;
+  int32_t scale_ = 1;
+  int32_t mode_width_ = 0;
+  int32_t mode_height_ = 0;
+  int32_t refresh_millihertz_ = 0;
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandOutput);
+};
+
+}  // namespace flutter
@@ -0,0 +1,789 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "wayland_seat.h"
+
+#include <linux/input-event-codes.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "instrumentation.h"
+#include "time_base.h"
+
+namespace flutter {
+
+// Touch points are reported as devices of their own next to the mouse.
+static const int32_t kMouseDevice = 0;
+static const int32_t kTouchDeviceBase = 1;
+
+#define SEAT reinterpret_cast<WaylandSeat*>(data)
+
+const wl_seat_listener WaylandSeat::kSeatListener = {
+    .capabilities = [](void* data,
+                       struct wl_seat* wl_seat,
+                       uint32_t capabilities) -> void {
+      SEAT->OnCapabilities(capabilities);
+    },
+
+    .name = [](void* data, struct wl_seat* wl_seat, const char* name) -> void {
+      // Nothing to do.
+    },
+};
+
+const wl_pointer_listener WaylandSeat::kPointerListener = {
+    .enter = [](void* data,
+                struct wl_pointer* wl_pointer,
+                uint32_t serial,
+                struct wl_surface* surface,
+                wl_fixed_t x,
+                wl_fixed_t y) -> void {
+      SEAT->OnPointerEnter(surface, x, y);
+    },
+
+    .leave = [](void* data,
+                struct wl_pointer* wl_pointer,
+                uint32_t serial,
+                struct wl_surface* surface) -> void {
+      SEAT->OnPointerLeave();
+    },
+
+    .motion = [](void* data,
+                 struct wl_pointer* wl_pointer,
+                 uint32_t time,
+                 wl_fixed_t x,
+                 wl_fixed_t y) -> void { SEAT->OnPointerMotion(time, x, y); },
+
+    .button = [](void* data,
+                 struct wl_pointer* wl_pointer,
+                 uint32_t serial,
+                 uint32_t time,
+                 uint32_t button,
+                 uint32_t state) -> void {
+      SEAT->OnPointerButton(time, button, state);
+    },
+
+    .axis = [](void* data,
+               struct wl_pointer* wl_pointer,
+               uint32_t time,
+               uint32_t axis,
+               wl_fixed_t value) -> void {
+      SEAT->OnPointerAxis(time, axis, value);
+    },
+
+    .frame = [](void* data, struct wl_pointer* wl_pointer) -> void {
+      SEAT->OnPointerFrame();
+    },
+
+    .axis_source = [](void* data,
+                      struct wl_pointer* wl_pointer,
+                      uint32_t axis_source) -> void {
+      // Nothing to do.
+    },
+
+    .axis_stop = [](void* data,
+                    struct wl_pointer* wl_pointer,
+                    uint32_t time,
+                    uint32_t axis) -> void {
+      // Nothing to do.
+    },
+
+    .axis_discrete = [](void* data,
+                        struct wl_pointer* wl_pointer,
+                        uint32_t axis,
+                        int32_t discrete) -> void {
+      // Nothing to do. The continuous axis event that accompanies this one is
+      // used instead.
+    },
+};
+
+const wl_touch_listener WaylandSeat::kTouchListener = {
+    .down = [](void* data,
+               struct wl_touch* wl_touch,
+               uint32_t serial,
+               uint32_t time,
+               struct wl_surface* surface,
+               int32_t id,
+               wl_fixed_t x,
+               wl_fixed_t y) -> void {
+      SEAT->OnTouchDown(time, surface, id, x, y);
+    },
+
+    .up = [](void* data,
+             struct wl_touch* wl_touch,
+             uint32_t serial,
+             uint32_t time,
+             int32_t id) -> void { SEAT->OnTouchUp(time, id); },
+
+    .motion = [](void* data,
+                 struct wl_touch* wl_touch,
+                 uint32_t time,
+                 int32_t id,
+                 wl_fixed_t x,
+                 wl_fixed_t y) -> void { SEAT->OnTouchMotion(time, id, x, y); },
+
+    .frame = [](void* data, struct wl_touch* wl_touch) -> void {
+      SEAT->OnTouchFrame();
+    },
+
+    .cancel = [](void* data, struct wl_touch* wl_touch) -> void {
+      SEAT->OnTouchCancel();
+    },
+};
+
+const wl_keyboard_listener WaylandSeat::kKeyboardListener = {
+    .keymap = [](void* data,
+                 struct wl_keyboard* wl_keyboard,
+                 uint32_t format,
+                 int32_t fd,
+                 uint32_t size) -> void { SEAT->OnKeymap(format, fd, size); },
+
+    .enter = [](void* data,
+                struct wl_keyboard* wl_keyboard,
+                uint32_t serial,
+                struct wl_surface* surface,
+                struct wl_array* keys) -> void {
+      // Keys already held down are not reported as presses.
+      SEAT->keyboard_surface_ = surface;
+    },
+
+    .leave = [](void* data,
+                struct wl_keyboard* wl_keyboard,
+                uint32_t serial,
+                struct wl_surface* surface) -> void {
+      SEAT->keyboard_surface_ = nullptr;
+      SEAT->repeat_key_ = 0;
+      SEAT->repeat_timer_.Disarm();
+    },
+
+    .key = [](void* data,
+              struct wl_keyboard* wl_keyboard,
+              uint32_t serial,
+              uint32_t time,
+              uint32_t key,
+              uint32_t state) -> void { SEAT->OnKey(key, state); },
+
+    .modifiers = [](void* data,
+                    struct wl_keyboard* wl_keyboard,
+                    uint32_t serial,
+                    uint32_t depressed,
+                    uint32_t latched,
+                    uint32_t locked,
+                    uint32_t group) -> void {
+      SEAT->OnModifiers(depressed, latched, locked, group);
+    },
+
+    .repeat_info = [](void* data,
+                      struct wl_keyboard* wl_keyboard,
+                      int32_t rate,
+                      int32_t delay) -> void {
+      SEAT->OnRepeatInfo(rate, delay);
+    },
+};
+
+const zwp_input_timestamps_v1_listener WaylandSeat::kTimestampsListener = {
+    .timestamp = [](void* data,
+                    struct zwp_input_timestamps_v1* timestamps,
+                    uint32_t tv_sec_hi,
+                    uint32_t tv_sec_lo,
+                    uint32_t tv_nsec) -> void {
+      const uint64_t seconds =
+          (static_cast<uint64_t>(tv_sec_hi) << 32) | tv_sec_lo;
+      SEAT->OnTimestamp(timestamps, seconds * kNanosPerSecond + tv_nsec);
+    },
+};
+
+#undef SEAT
+
+WaylandSeat::WaylandSeat(EventLoop& loop,
+                         wl_registry* registry,
+                         uint32_t name,
+                         uint32_t version,
+                         Delegate& delegate)
+    : delegate_(delegate),
+      version_(std::min(version, 5u)),
+      repeat_timer_(loop, [this]() { OnRepeatTimer(); }) {
+  seat_ = static_cast<decltype(seat_)>(
+      wl_registry_bind(registry, name, &wl_seat_interface, version_));
+
+  if (!seat_) {
+    FLWAY_ERROR << "Could not bind the seat." << std::endl;
+    return;
+  }
+
+  xkb_context_ = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
+  if (!xkb_context_) {
+    FLWAY_ERROR << "Could not create the keyboard context." << std::endl;
+    return;
+  }
+
+  wl_seat_add_listener(seat_, &kSeatListener, this);
+}
+
+WaylandSeat::~WaylandSeat() {
+  ReleasePointer();
+  ReleaseTouch();
+  ReleaseKeyboard();
+
+  if (xkb_context_) {
+    xkb_context_unref(xkb_context_);
+    xkb_context_ = nullptr;
+  }
+
+  if (seat_) {
+    if (version_ >= WL_SEAT_RELEASE_SINCE_VERSION) {
+      wl_seat_release(seat_);
+    } else {
+      wl_seat_destroy(seat_);
+    }
+    seat_ = nullptr;
+  }
+}
+
+bool WaylandSeat::IsValid() const {
+  return seat_ != nullptr && xkb_context_ != nullptr;
+}
+
+void WaylandSeat::SetInputTimestampsManager(
+    zwp_input_timestamps_manager_v1* manager) {
+  timestamps_manager_ = manager;
+  CreateTimestamps();
+}
+
+WaylandSeat::Stats WaylandSeat::GetStats() const {
+  return stats_;
+}
+
+void WaylandSeat::CreateTimestamps() {
+  if (!timestamps_manager_) {
+    return;
+  }
+
+  if (pointer_ && !pointer_timestamps_) {
+    pointer_timestamps_ =
+        zwp_input_timestamps_manager_v1_get_pointer_timestamps(
+            timestamps_manager_, pointer_);
+    zwp_input_timestamps_v1_add_listener(pointer_timestamps_,
+                                         &kTimestampsListener, this);
+  }
+
+  if (touch_ && !touch_timestamps_) {
+    touch_timestamps_ = zwp_input_timestamps_manager_v1_get_touch_timestamps(
+        timestamps_manager_, touch_);
+    zwp_input_timestamps_v1_add_listener(touch_timestamps_,
+                                         &kTimestampsListener, this);
+  }
+}
+
+// The timestamp applies to the input event that immediately follows it.
+void WaylandSeat::OnTimestamp(zwp_input_timestamps_v1* timestamps,
+                              uint64_t nanos) {
+  if (timestamps == pointer_timestamps_) {
+    pointer_precise_time_ = nanos;
+  } else if (timestamps == touch_timestamps_) {
+    touch_precise_time_ = nanos;
+  }
+}
+
+uint64_t WaylandSeat::ResolveEventTime(uint32_t time,
+                                       uint64_t& precise_time) {
+  if (precise_time == 0) {
+    return WaylandEventTimeToTimeBase(time);
+  }
+
+  const uint64_t resolved = std::min(precise_time, GetCurrentTimeNanos());
+  precise_time = 0;
+  return resolved;
+}
+
+void WaylandSeat::DeliverBatch(wl_surface* surface,
+                               const FlutterPointerEvent* events,
+                               size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  const uint64_t now = GetCurrentTimeNanos();
+  const uint64_t oldest = events[0].timestamp * kNanosPerMicro;
+  const uint64_t delay = now > oldest ? now - oldest : 0;
+  stats_.batches++;
+  stats_.events += count;
+  stats_.total_delay_nanos += delay;
+  stats_.max_delay_nanos = std::max(stats_.max_delay_nanos, delay);
+  RecordTimingEvent(TimingEvent::kInputReceived, oldest, surface);
+
+  delegate_.OnSeatPointerEvents(surface, events, count);
+}
+
+void WaylandSeat::OnCapabilities(uint32_t capabilities) {
+  const bool has_pointer = capabilities & WL_SEAT_CAPABILITY_POINTER;
+  const bool has_touch = capabilities & WL_SEAT_CAPABILITY_TOUCH;
+  const bool has_keyboard = capabilities & WL_SEAT_CAPABILITY_KEYBOARD;
+
+  if (has_pointer && !pointer_) {
+    pointer_ = wl_seat_get_pointer(seat_);
+    wl_pointer_add_listener(pointer_, &kPointerListener, this);
+  } else if (!has_pointer && pointer_) {
+    ReleasePointer();
+  }
+
+  if (has_touch && !touch_) {
+    touch_ = wl_seat_get_touch(seat_);
+    wl_touch_add_listener(touch_, &kTouchListener, this);
+  } else if (!has_touch && touch_) {
+    ReleaseTouch();
+  }
+
+  if (has_keyboard && !keyboard_) {
+    keyboard_ = wl_seat_get_keyboard(seat_);
+    wl_keyboard_add_listener(keyboard_, &kKeyboardListener, this);
+  } else if (!has_keyboard && keyboard_) {
+    ReleaseKeyboard();
+  }
+
+  CreateTimestamps();
+}
+
+void WaylandSeat::ReleasePointer() {
+  if (pointer_timestamps_) {
+    zwp_input_timestamps_v1_destroy(pointer_timestamps_);
+    pointer_timestamps_ = nullptr;
+  }
+
+  if (!pointer_) {
+    return;
+  }
+
+  if (version_ >= WL_POINTER_RELEASE_SINCE_VERSION) {
+    wl_pointer_release(pointer_);
+  } else {
+    wl_pointer_destroy(pointer_);
+  }
+  pointer_ = nullptr;
+  pointer_events_.clear();
+  pointer_surface_ = nullptr;
+}
+
+void WaylandSeat::ReleaseTouch() {
+  if (touch_timestamps_) {
+    zwp_input_timestamps_v1_destroy(touch_timestamps_);
+    touch_timestamps_ = nullptr;
+  }
+
+  if (!touch_) {
+    return;
+  }
+
+  if (version_ >= WL_TOUCH_RELEASE_SINCE_VERSION) {
+    wl_touch_release(touch_);
+  } else {
+    wl_touch_destroy(touch_);
+  }
+  touch_ = nullptr;
+  touch_events_.clear();
+  touch_event_surfaces_.clear();
+}
+
+void WaylandSeat::ReleaseKeyboard() {
+  repeat_key_ = 0;
+  repeat_timer_.Disarm();
+
+  if (xkb_state_) {
+    xkb_state_unref(xkb_state_);
+    xkb_state_ = nullptr;
+  }
+
+  if (xkb_keymap_) {
+    xkb_keymap_unref(xkb_keymap_);
+    xkb_keymap_ = nullptr;
+  }
+
+  if (!keyboard_) {
+    return;
+  }
+
+  if (version_ >= WL_KEYBOARD_RELEASE_SINCE_VERSION) {
+    wl_keyboard_release(keyboard_);
+  } else {
+    wl_keyboard_destroy(keyboard_);
+  }
+  keyboard_ = nullptr;
+  keyboard_surface_ = nullptr;
+}
+
+void WaylandSeat::PushPointerEvent(FlutterPointerPhase phase, uint64_t time) {
+  FlutterPointerEvent event = {};
+  event.struct_size = sizeof(event);
+  event.phase = phase;
+  event.timestamp = time / kNanosPerMicro;
+  event.x = pointer_x_;
+  event.y = pointer_y_;
+  event.device = kMouseDevice;
+  event.signal_kind = kFlutterPointerSignalKindNone;
+  event.device_kind = kFlutterPointerDeviceKindMouse;
+  event.buttons = pointer_buttons_;
+  pointer_events_.push_back(event);
+}
+
+// Enter and leave carry no time of their own.
+void WaylandSeat::OnPointerEnter(wl_surface* surface,
+                                 wl_fixed_t x,
+                                 wl_fixed_t y) {
+  // The leave of the previous surface may be part of the same frame.
+  if (surface != pointer_surface_) {
+    DeliverBatch(pointer_surface_, pointer_events_.data(),
+                 pointer_events_.size());
+    pointer_events_.clear();
+    pointer_surface_ = surface;
+  }
+
+  pointer_time_ = GetCurrentTimeNanos();
+  pointer_x_ = wl_fixed_to_double(x);
+  pointer_y_ = wl_fixed_to_double(y);
+
+  if (!pointer_added_) {
+    pointer_added_ = true;
+    PushPointerEvent(kAdd, pointer_time_);
+  }
+
+  EmulatePointerFrameIfNecessary();
+}
+
+void WaylandSeat::OnPointerLeave() {
+  pointer_time_ = GetCurrentTimeNanos();
+
+  if (pointer_added_) {
+    pointer_added_ = false;
+    pointer_buttons_ = 0;
+    PushPointerEvent(kRemove, pointer_time_);
+  }
+
+  EmulatePointerFrameIfNecessary();
+}
+
+void WaylandSeat::OnPointerMotion(uint32_t time, wl_fixed_t x, wl_fixed_t y) {
+  pointer_time_ = ResolveEventTime(time, pointer_precise_time_);
+  pointer_x_ = wl_fixed_to_double(x);
+  pointer_y_ = wl_fixed_to_double(y);
+  PushPointerEvent(pointer_buttons_ == 0 ? kHover : kMove, pointer_time_);
+  EmulatePointerFrameIfNecessary();
+}
+
+static int64_t ButtonToFlutterButton(uint32_t button) {
+  switch (button) {
+    case BTN_LEFT:
+      return kFlutterPointerButtonMousePrimary;
+    case BTN_RIGHT:
+      return kFlutterPointerButtonMouseSecondary;
+    case BTN_MIDDLE:
+      return kFlutterPointerButtonMouseMiddle;
+    case BTN_SIDE:
+      return kFlutterPointerButtonMouseBack;
+    case BTN_EXTRA:
+      return kFlutterPointerButtonMouseForward;
+  }
+  return 0;
+}
+
+void WaylandSeat::OnPointerButton(uint32_t time,
+                                  uint32_t button,
+                                  uint32_t state) {
+  const int64_t flutter_button = ButtonToFlutterButton(button);
+  const uint64_t event_time = ResolveEventTime(time, pointer_precise_time_);
+
+  if (flutter_button == 0) {
+    return;
+  }
+
+  const int64_t previous_buttons = pointer_buttons_;
+
+  if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
+    pointer_buttons_ |= flutter_button;
+  } else {
+    pointer_buttons_ &= ~flutter_button;
+  }
+
+  if (pointer_buttons_ == previous_buttons) {
+    return;
+  }
+
+  FlutterPointerPhase phase = kMove;
+  if (previous_buttons == 0) {
+    phase = kDown;
+  } else if (pointer_buttons_ == 0) {
+    phase = kUp;
+  }
+
+  pointer_time_ = event_time;
+  PushPointerEvent(phase, pointer_time_);
+  EmulatePointerFrameIfNecessary();
+}
+
+// Scrolls are summed over the frame and reported as a single signal.
+void WaylandSeat::OnPointerAxis(uint32_t time,
+                                uint32_t axis,
+                                wl_fixed_t value) {
+  pointer_time_ = ResolveEventTime(time, pointer_precise_time_);
+  scroll_pending_ = true;
+
+  if (axis == WL_POINTER_AXIS_VERTICAL_SCROLL) {
+    scroll_delta_y_ += wl_fixed_to_double(value);
+  } else if (axis == WL_POINTER_AXIS_HORIZONTAL_SCROLL) {
+    scroll_delta_x_ += wl_fixed_to_double(value);
+  }
+
+  EmulatePointerFrameIfNecessary();
+}
+
+void WaylandSeat::OnPointerFrame() {
+  if (scroll_pending_) {
+    PushPointerEvent(pointer_buttons_ == 0 ? kHover : kMove, pointer_time_);
+    auto& event = pointer_events_.back();
+    event.signal_kind = kFlutterPointerSignalKindScroll;
+    event.scroll_delta_x = scroll_delta_x_;
+    event.scroll_delta_y = scroll_delta_y_;
+
+    scroll_pending_ = false;
+    scroll_delta_x_ = 0.0;
+    scroll_delta_y_ = 0.0;
+  }
+
+  DeliverBatch(pointer_surface_, pointer_events_.data(),
+               pointer_events_.size());
+  pointer_events_.clear();
+}
+
+void WaylandSeat::EmulatePointerFrameIfNecessary() {
+  if (version_ < WL_POINTER_FRAME_SINCE_VERSION) {
+    OnPointerFrame();
+  }
+}
+
+void WaylandSeat::PushTouchEvent(FlutterPointerPhase phase,
+                                 uint64_t time,
+                                 int32_t id,
+                                 const TouchPoint& point) {
+  FlutterPointerEvent event = {};
+  event.struct_size = sizeof(event);
+  event.phase = phase;
+  event.timestamp = time / kNanosPerMicro;
+  event.x = point.x;
+  event.y = point.y;
+  event.device = kTouchDeviceBase + id;
+  event.signal_kind = kFlutterPointerSignalKindNone;
+  event.device_kind = kFlutterPointerDeviceKindTouch;
+  event.buttons = phase == kUp || phase == kRemove || phase == kCancel
+                      ? 0
+                      : kFlutterPointerButtonMousePrimary;
+  touch_events_.push_back(event);
+  touch_event_surfaces_.push_back(point.surface);
+}
+
+// Every touch point is its own pointer that lives from down to up.
+void WaylandSeat::OnTouchDown(uint32_t time,
+                              wl_surface* surface,
+                              int32_t id,
+                              wl_fixed_t x,
+                              wl_fixed_t y) {
+  touch_time_ = ResolveEventTime(time, touch_precise_time_);
+  TouchPoint& point = touch_points_[id];
+  point.surface = surface;
+  point.x = wl_fixed_to_double(x);
+  point.y = wl_fixed_to_double(y);
+  PushTouchEvent(kAdd, touch_time_, id, point);
+  PushTouchEvent(kDown, touch_time_, id, point);
+}
+
+void WaylandSeat::OnTouchUp(uint32_t time, int32_t id) {
+  touch_time_ = ResolveEventTime(time, touch_precise_time_);
+  auto found = touch_points_.find(id);
+
+  if (found == touch_points_.end()) {
+    return;
+  }
+
+  PushTouchEvent(kUp, touch_time_, id, found->second);
+  PushTouchEvent(kRemove, touch_time_, id, found->second);
+  touch_points_.erase(found);
+}
+
+void WaylandSeat::OnTouchMotion(uint32_t time,
+                                int32_t id,
+                                wl_fixed_t x,
+                                wl_fixed_t y) {
+  touch_time_ = ResolveEventTime(time, touch_precise_time_);
+  auto found = touch_points_.find(id);
+
+  if (found == touch_points_.end()) {
+    return;
+  }
+
+  found->second.x = wl_fixed_to_double(x);
+  found->second.y = wl_fixed_to_double(y);
+  PushTouchEvent(kMove, touch_time_, id, found->second);
+}
+
+// Points on different surfaces are split into one batch per run of events on
+// the same surface.
+void WaylandSeat::OnTouchFrame() {
+  size_t begin = 0;
+  for (size_t i = 1; i <= touch_events_.size(); i++) {
+    if (i == touch_events_.size() ||
+        touch_event_surfaces_[i] != touch_event_surfaces_[begin]) {
+      DeliverBatch(touch_event_surfaces_[begin], &touch_events_[begin],
+                   i - begin);
+      begin = i;
+    }
+  }
+
+  touch_events_.clear();
+  touch_event_surfaces_.clear();
+}
+
+// The compositor took over the touch sequence, for example for a gesture of
+// its own. Events of this frame are discarded and every active point is
+// cancelled.
+void WaylandSeat::OnTouchCancel() {
+  touch_events_.clear();
+  touch_event_surfaces_.clear();
+  touch_time_ = GetCurrentTimeNanos();
+
+  for (const auto& point : touch_points_) {
+    PushTouchEvent(kCancel, touch_time_, point.first, point.second);
+    PushTouchEvent(kRemove, touch_time_, point.first, point.second);
+  }
+  touch_points_.clear();
+
+  OnTouchFrame();
+}
+
+void WaylandSeat::OnKeymap(uint32_t format, int32_t fd, uint32_t size) {
+  if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) {
+    FLWAY_ERROR << "Unsupported keymap format." << std::endl;
+    ::close(fd);
+    return;
+  }
+
+  void* map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (map == MAP_FAILED) {
+    FLWAY_ERROR << "Could not map the keymap." << std::endl;
+    return;
+  }
+
+  xkb_keymap* keymap =
+      xkb_keymap_new_from_string(xkb_context_, static_cast<const char*>(map),
+                                 XKB_KEYMAP_FORMAT_TEXT_V1,
+                                 XKB_KEYMAP_COMPILE_NO_FLAGS);
+  ::munmap(map, size);
+
+  if (!keymap) {
+    FLWAY_ERROR << "Could not compile the keymap." << std::endl;
+    return;
+  }
+
+  xkb_state* state = xkb_state_new(keymap);
+
+  if (!state) {
+    FLWAY_ERROR << "Could not create the keyboard state." << std::endl;
+    xkb_keymap_unref(keymap);
+    return;
+  }
+
+  if (xkb_state_) {
+    xkb_state_unref(xkb_state_);
+  }
+
+  if (xkb_keymap_) {
+    xkb_keymap_unref(xkb_keymap_);
+  }
+
+  xkb_keymap_ = keymap;
+  xkb_state_ = state;
+}
+
+void WaylandSeat::OnKey(uint32_t key, uint32_t state) {
+  if (!xkb_state_) {
+    return;
+  }
+
+  const bool pressed = state == WL_KEYBOARD_KEY_STATE_PRESSED;
+  SendKeyEvent(key, pressed);
+
+  if (pressed && repeat_rate_ > 0 &&
+      xkb_keymap_key_repeats(xkb_keymap_, key + 8)) {
+    repeat_key_ = key;
+    repeat_timer_.ArmAt(GetCurrentTimeNanos() +
+                        repeat_delay_ * kNanosPerMilli);
+  } else if (key == repeat_key_) {
+    repeat_key_ = 0;
+    repeat_timer_.Disarm();
+  }
+}
+
+void WaylandSeat::OnModifiers(uint32_t depressed,
+                              uint32_t latched,
+                              uint32_t locked,
+                              uint32_t group) {
+  if (!xkb_state_) {
+    return;
+  }
+
+  xkb_state_update_mask(xkb_state_, depressed, latched, locked, 0, 0, group);
+}
+
+void WaylandSeat::OnRepeatInfo(int32_t rate, int32_t delay) {
+  repeat_rate_ = rate;
+  repeat_delay_ = delay;
+}
+
+void WaylandSeat::OnRepeatTimer() {
+  if (repeat_key_ == 0 || repeat_rate_ <= 0) {
+    return;
+  }
+
+  SendKeyEvent(repeat_key_, true);
+  repeat_timer_.ArmAt(GetCurrentTimeNanos() + kNanosPerSecond / repeat_rate_);
+}
+
+static uint32_t GetModifiers(xkb_state* state) {
+  struct ModifierMask {
+    const char* name;
+    uint32_t mask;
+  };
+
+  // The GDK modifier masks the framework expects from the "gtk" toolkit.
+  static const ModifierMask kModifiers[] = {
+      {XKB_MOD_NAME_SHIFT, 1 << 0}, {XKB_MOD_NAME_CAPS, 1 << 1},
+      {XKB_MOD_NAME_CTRL, 1 << 2},  {XKB_MOD_NAME_ALT, 1 << 3},
+      {XKB_MOD_NAME_NUM, 1 << 4},   {XKB_MOD_NAME_LOGO, 1 << 28},
+  };
+
+  uint32_t modifiers = 0;
+  for (const auto& modifier : kModifiers) {
+    if (xkb_state_mod_name_is_active(state, modifier.name,
+                                     XKB_STATE_MODS_EFFECTIVE) > 0) {
+      modifiers |= modifier.mask;
+    }
+  }
+  return modifiers;
+}
+
+void WaylandSeat::SendKeyEvent(uint32_t key, bool pressed) {
+  // Wayland sends evdev codes. XKB keycodes are offset by 8.
+  const xkb_keycode_t keycode = key + 8;
+
+  KeyEvent event;
+  event.pressed = pressed;
+  event.keysym = xkb_state_key_get_one_sym(xkb_state_, keycode);
+  event.scan_code = keycode;
+  event.modifiers = GetModifiers(xkb_state_);
+  event.unicode = xkb_state_key_get_utf32(xkb_state_, keycode);
+  delegate_.OnSeatKeyEvent(keyboard_surface_, event);
+}
+
+}  // namespace flutter
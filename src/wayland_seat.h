@@ -0,0 +1,208 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <flutter_embedder.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include <map>
+#include <vector>
+
+#include "event_loop.h"
+#include "input-timestamps-unstable-v1-client-protocol.h"
+#include "macros.h"
+
+namespace flutter {
+
+// Translates the pointer, touch and keyboard devices of a wl_seat into engine
+// events. Pointer and touch events are accumulated until the compositor marks
+// the end of a logical frame of input so the engine receives each frame as a
+// single batch. Events go to the surface that has the focus of their device,
+// or that a touch point went down on. Event timestamps are in the time base
+// of |time_base.h|. All callbacks happen on the thread that dispatches the
+// Wayland connection.
+class WaylandSeat {
+ public:
+  // How long input batches wait between the compositor generating the first
+  // event of the batch and the batch being handed to the delegate.
+  struct Stats {
+    size_t batches = 0;
+    size_t events = 0;
+    uint64_t total_delay_nanos = 0;
+    uint64_t max_delay_nanos = 0;
+  };
+
+  struct KeyEvent {
+    bool pressed = false;
+    // X11 keysym, which is also the GDK keyval.
+    uint32_t keysym = 0;
+    // X11 hardware keycode, the evdev code offset by 8.
+    uint32_t scan_code = 0;
+    // GDK modifier mask.
+    uint32_t modifiers = 0;
+    // Zero if the key does not produce a character.
+    uint32_t unicode = 0;
+  };
+
+  class Delegate {
+   public:
+    // Coordinates are in the coordinates of |surface|.
+    virtual void OnSeatPointerEvents(wl_surface* surface,
+                                     const FlutterPointerEvent* events,
+                                     size_t count) = 0;
+
+    virtual void OnSeatKeyEvent(wl_surface* surface, const KeyEvent& event) = 0;
+  };
+
+  WaylandSeat(EventLoop& loop,
+              wl_registry* registry,
+              uint32_t name,
+              uint32_t version,
+              Delegate& delegate);
+
+  ~WaylandSeat();
+
+  bool IsValid() const;
+
+  // Use the nanosecond timestamps of zwp_input_timestamps_v1 instead of the
+  // millisecond event times. May be called at any time.
+  void SetInputTimestampsManager(zwp_input_timestamps_manager_v1* manager);
+
+  Stats GetStats() const;
+
+ private:
+  static const wl_seat_listener kSeatListener;
+  static const wl_pointer_listener kPointerListener;
+  static const wl_touch_listener kTouchListener;
+  static const wl_keyboard_listener kKeyboardListener;
+  static const zwp_input_timestamps_v1_listener kTimestampsListener;
+
+  struct TouchPoint {
+    wl_surface* surface = nullptr;
+    double x = 0.0;
+    double y = 0.0;
+  };
+
+  Delegate& delegate_;
+  const uint32_t version_;
+  wl_seat* seat_ = nullptr;
+  wl_pointer* pointer_ = nullptr;
+  wl_touch* touch_ = nullptr;
+  wl_keyboard* keyboard_ = nullptr;
+  zwp_input_timestamps_manager_v1* timestamps_manager_ = nullptr;
+  zwp_input_timestamps_v1* pointer_timestamps_ = nullptr;
+  zwp_input_timestamps_v1* touch_timestamps_ = nullptr;
+  Stats stats_;
+
+  // Pointer state.
+  std::vector<FlutterPointerEvent> pointer_events_;
+  // The surface the pointer last entered. Kept after it leaves so the events
+  // of the leave are delivered there.
+  wl_surface* pointer_surface_ = nullptr;
+  bool pointer_added_ = false;
+  double pointer_x_ = 0.0;
+  double pointer_y_ = 0.0;
+  int64_t pointer_buttons_ = 0;
+  uint64_t pointer_time_ = 0;
+  uint64_t pointer_precise_time_ = 0;
+  double scroll_delta_x_ = 0.0;
+  double scroll_delta_y_ = 0.0;
+  bool scroll_pending_ = false;
+
+  // Touch state.
+  std::vector<FlutterPointerEvent> touch_events_;
+  // The surface of each event in |touch_events_|.
+  std::vector<wl_surface*> touch_event_surfaces_;
+  std::map<int32_t, TouchPoint> touch_points_;
+  uint64_t touch_time_ = 0;
+  uint64_t touch_precise_time_ = 0;
+
+  // Keyboard state.
+  wl_surface* keyboard_surface_ = nullptr;
+  xkb_context* xkb_context_ = nullptr;
+  xkb_keymap* xkb_keymap_ = nullptr;
+  xkb_state* xkb_state_ = nullptr;
+  int32_t repeat_rate_ = 0;
+  int32_t repeat_delay_ = 0;
+  uint32_t repeat_key_ = 0;
+  Timer repeat_timer_;
+
+  void OnCapabilities(uint32_t capabilities);
+
+  void ReleasePointer();
+
+  void ReleaseTouch();
+
+  void ReleaseKeyboard();
+
+  void CreateTimestamps();
+
+  void OnTimestamp(zwp_input_timestamps_v1* timestamps, uint64_t nanos);
+
+  // The precise timestamp of the event if one was sent, the millisecond event
+  // time otherwise.
+  uint64_t ResolveEventTime(uint32_t time, uint64_t& precise_time);
+
+  void DeliverBatch(wl_surface* surface,
+                    const FlutterPointerEvent* events,
+                    size_t count);
+
+  void PushPointerEvent(FlutterPointerPhase phase, uint64_t time);
+
+  void OnPointerEnter(wl_surface* surface, wl_fixed_t x, wl_fixed_t y);
+
+  void OnPointerLeave();
+
+  void OnPointerMotion(uint32_t time, wl_fixed_t x, wl_fixed_t y);
+
+  void OnPointerButton(uint32_t time, uint32_t button, uint32_t state);
+
+  void OnPointerAxis(uint32_t time, uint32_t axis, wl_fixed_t value);
+
+  void OnPointerFrame();
+
+  // Seats older than version 5 have no pointer frame event. Every event is a
+  // frame of its own.
+  void EmulatePointerFrameIfNecessary();
+
+  void PushTouchEvent(FlutterPointerPhase phase,
+                      uint64_t time,
+                      int32_t id,
+                      const TouchPoint& point);
+
+  void OnTouchDown(uint32_t time,
+                   wl_surface* surface,
+                   int32_t id,
+                   wl_fixed_t x,
+                   wl_fixed_t y);
+
+  void OnTouchUp(uint32_t time, int32_t id);
+
+  void OnTouchMotion(uint32_t time, int32_t id, wl_fixed_t x, wl_fixed_t y);
+
+  void OnTouchFrame();
+
+  void OnTouchCancel();
+
+  void OnKeymap(uint32_t format, int32_t fd, uint32_t size);
+
+  void OnKey(uint32_t key, uint32_t state);
+
+  void OnModifiers(uint32_t depressed,
+                   uint32_t latched,
+                   uint32_t locked,
+                   uint32_t group);
+
+  void OnRepeatInfo(int32_t rate, int32_t delay);
+
+  void OnRepeatTimer();
+
+  void SendKeyEvent(uint32_t key, bool pressed);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(WaylandSeat);
+};
+
+}  // namespace flutter
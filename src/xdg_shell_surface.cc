@@ -0,0 +1,184 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "xdg_shell_surface.h"
+
+namespace flutter {
+
+#define SHELL_SURFACE reinterpret_cast<XdgShellSurface*>(data)
+
+const xdg_surface_listener XdgShellSurface::kXdgSurfaceListener = {
+    .configure = [](void* data,
+                    struct xdg_surface* xdg_surface,
+                    uint32_t serial) -> void {
+      SHELL_SURFACE->OnSurfaceConfigure(serial);
+    },
+};
+
+const xdg_toplevel_listener XdgShellSurface::kXdgToplevelListener = {
+    .configure = [](void* data,
+                    struct xdg_toplevel* xdg_toplevel,
+                    int32_t width,
+                    int32_t height,
+                    struct wl_array* states) -> void {
+      SHELL_SURFACE->OnToplevelConfigure(width, height, states);
+    },
+
+    .close = [](void* data, struct xdg_toplevel* xdg_toplevel) -> void {
+      SHELL_SURFACE->delegate_.OnShellSurfaceClose();
+    },
+
+    .configure_bounds = [](void* data,
+                           struct xdg_toplevel* xdg_toplevel,
+                           int32_t width,
+                           int32_t height) -> void {
+      // Nothing to do.
+    },
+
+    .wm_capabilities = [](void* data,
+                          struct xdg_toplevel* xdg_toplevel,
+                          struct wl_array* capabilities) -> void {
+      // Nothing to do.
+    },
+};
+
+#undef SHELL_SURFACE
+
+XdgShellSurface::XdgShellSurface(xdg_wm_base* wm_base,
+                                 wl_surface* surface,
+                                 const char* title,
+                                 bool fullscreen,
+                                 wl_output* output,
+                                 Delegate& delegate)
+    : delegate_(delegate) {
+  xdg_surface_ = xdg_wm_base_get_xdg_surface(wm_base, surface);
+
+  if (!xdg_surface_) {
+    FLWAY_ERROR << "Could not create the xdg surface." << std::endl;
+    return;
+  }
+
+  xdg_surface_add_listener(xdg_surface_, &kXdgSurfaceListener, this);
+
+  xdg_toplevel_ = xdg_surface_get_toplevel(xdg_surface_);
+
+  if (!xdg_toplevel_) {
+    FLWAY_ERROR << "Could not create the xdg toplevel." << std::endl;
+    return;
+  }
+
+  xdg_toplevel_add_listener(xdg_toplevel_, &kXdgToplevelListener, this);
+
+  xdg_toplevel_set_title(xdg_toplevel_, title);
+
+  xdg_toplevel_set_app_id(xdg_toplevel_, "flutter");
+
+  if (fullscreen) {
+    xdg_toplevel_set_fullscreen(xdg_toplevel_, output);
+  }
+
+  // Commit without a buffer so the compositor sends the initial configure.
+  wl_surface_commit(surface);
+}
+
+XdgShellSurface::~XdgShellSurface() {
+  if (xdg_toplevel_) {
+    xdg_toplevel_destroy(xdg_toplevel_);
+    xdg_toplevel_ = nullptr;
+  }
+
+  if (xdg_surface_) {
+    xdg_surface_destroy(xdg_surface_);
+    xdg_surface_ = nullptr;
+  }
+}
+
+// |flutter::ShellSurface|
+bool XdgShellSurface::IsValid() const {
+  return xdg_toplevel_ != nullptr;
+}
+
+// |flutter::ShellSurface|
+void XdgShellSurface::OnSurfaceWillCommit(int32_t width, int32_t height) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  committed_width_ = width;
+  committed_height_ = height;
+
+  if (!has_pending_serial_) {
+    return;
+  }
+
+  // Acknowledge with the first frame that honors the configured size so the
+  // compositor never sees an acked state paired with a stale buffer. Newer
+  // configures replace older ones, so intermediate sizes of an interactive
+  // resize are never acked individually.
+  const bool client_sized = pending_width_ <= 0 || pending_height_ <= 0;
+  if (!client_sized && (width != pending_width_ || height != pending_height_)) {
+    return;
+  }
+
+  xdg_surface_ack_configure(xdg_surface_, pending_serial_);
+  has_pending_serial_ = false;
+}
+
+void XdgShellSurface::OnToplevelConfigure(int32_t width,
+                                          int32_t height,
+                                          wl_array* states) {
+  batched_width_ = width;
+  batched_height_ = height;
+  batched_suspended_ = false;
+
+  const uint32_t* state = static_cast<const uint32_t*>(states->data);
+  for (size_t i = 0; i < states->size / sizeof(*state); i++) {
+    if (state[i] == XDG_TOPLEVEL_STATE_SUSPENDED) {
+      batched_suspended_ = true;
+    }
+  }
+}
+
+void XdgShellSurface::OnSurfaceConfigure(uint32_t serial) {
+  const int32_t width = batched_width_;
+  const int32_t height = batched_height_;
+  bool needs_commit = false;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const bool client_sized = width <= 0 || height <= 0;
+    const bool size_kept = committed_width_ > 0 &&
+                           (client_sized || (width == committed_width_ &&
+                                             height == committed_height_));
+
+    if (!initial_configure_acked_) {
+      // Nothing has been attached yet. The initial configure must be acked
+      // before the first buffer is.
+      xdg_surface_ack_configure(xdg_surface_, serial);
+      initial_configure_acked_ = true;
+    } else if (size_kept) {
+      // Replaces any configure still waiting for a frame at another size.
+      xdg_surface_ack_configure(xdg_surface_, serial);
+      has_pending_serial_ = false;
+      needs_commit = true;
+    } else {
+      has_pending_serial_ = true;
+      pending_serial_ = serial;
+      pending_width_ = width;
+      pending_height_ = height;
+    }
+  }
+
+  delegate_.OnShellSurfaceConfigure(width, height);
+
+  if (needs_commit) {
+    delegate_.OnShellSurfaceNeedsCommit();
+  }
+
+  if (batched_suspended_ != suspended_) {
+    suspended_ = batched_suspended_;
+    delegate_.OnShellSurfaceSuspended(suspended_);
+  }
+}
+
+}  // namespace flutter
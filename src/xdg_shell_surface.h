@@ -0,0 +1,71 @@
+// Copyright 2018 The Flutter Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <wayland-client.h>
+
+#include <mutex>
+
+#include "macros.h"
+#include "shell_surface.h"
+#include "xdg-shell-client-protocol.h"
+
+namespace flutter {
+
+// Shell surface backed by an xdg_toplevel. Configure events are batched until
+// the terminating xdg_surface.configure and acknowledged with the commit of the
+// first frame rendered at the configured size. Configures the last frame
+// already satisfies, such as those that only change states, are acknowledged
+// right away since an idle app may never render another frame.
+class XdgShellSurface : public ShellSurface {
+ public:
+  XdgShellSurface(xdg_wm_base* wm_base,
+                  wl_surface* surface,
+                  const char* title,
+                  bool fullscreen,
+                  wl_output* output,
+                  Delegate& delegate);
+
+  ~XdgShellSurface() override;
+
+  // |flutter::ShellSurface|
+  bool IsValid() const override;
+
+  // |flutter::ShellSurface|
+  void OnSurfaceWillCommit(int32_t width, int32_t height) override;
+
+ private:
+  static const xdg_surface_listener kXdgSurfaceListener;
+  static const xdg_toplevel_listener kXdgToplevelListener;
+
+  Delegate& delegate_;
+  xdg_surface* xdg_surface_ = nullptr;
+  xdg_toplevel* xdg_toplevel_ = nullptr;
+
+  // Accumulated from xdg_toplevel.configure until xdg_surface.configure.
+  int32_t batched_width_ = 0;
+  int32_t batched_height_ = 0;
+  bool batched_suspended_ = false;
+  bool suspended_ = false;
+
+  // Guards the configure waiting to be acknowledged by the raster thread.
+  std::mutex mutex_;
+  bool initial_configure_acked_ = false;
+  bool has_pending_serial_ = false;
+  uint32_t pending_serial_ = 0;
+  int32_t pending_width_ = 0;
+  int32_t pending_height_ = 0;
+  // Size of the last frame committed, in surface coordinates.
+  int32_t committed_width_ = 0;
+  int32_t committed_height_ = 0;
+
+  void OnToplevelConfigure(int32_t width, int32_t height, wl_array* states);
+
+  void OnSurfaceConfigure(uint32_t serial);
+
+  FLWAY_DISALLOW_COPY_AND_ASSIGN(XdgShellSurface);
+};
+
+}  // namespace flutter